@@ -3,6 +3,18 @@
 #include "functionality\GraphImplementation.h"
 #include "functionality\MeshImplementation.h"
 #include "functionality\fieldOperatorImplementation.h"
+#include "functionality\OutOfCoreOperatorImplementation.h"
+#include "functionality\NumaOperatorImplementation.h"
+#include "functionality\CompressedOperatorImplementation.h"
+#include "functionality\SharedOperatorImplementation.h"
+#include "functionality\CondensedOperatorImplementation.h"
+#include "functionality\DirectSolverImplementation.h"
+#include "functionality\TransportImplementation.h"
+#include "functionality\DistributedFieldImplementation.h"
+#include "functionality\FieldWriterImplementation.h"
+#include "functionality\ExecutorImplementation.h"
+#include "functionality\ProbeImplementation.h"
+#include "mesh_math\profiler.h"
 
 Graph * Graph::create()
 {
@@ -14,13 +26,59 @@ void Graph::free(Graph * g)
 	delete g;
 }
 
-Mesh * Mesh::create(const Graph * g, const std::vector<V3D>& nodePositions)
+Executor * Executor::createWorkStealing(size_t nThreads)
+{
+	return new WorkStealingExecutor(nThreads);
+}
+
+Executor * Executor::createSerial()
+{
+	return new SerialExecutor;
+}
+
+Executor * Executor::shared()
+{
+	//The pool is never deleted, joining its threads while the library is unloaded could deadlock
+	static Executor* pShared = new WorkStealingExecutor(0);
+	return pShared;
+}
+
+void Executor::free(Executor * e)
+{
+	if (e != shared()) delete e;
+}
+
+Mesh * Mesh::create(const Graph * g, const std::vector<V3D>& nodePositions, Mesh::NodeOrdering ordering, Executor* executor)
 {
 	const GraphImplementation& g_p = dynamic_cast<const GraphImplementation&>(*g);
 	std::vector<vector3f> np(nodePositions.size());
 	std::transform(nodePositions.begin(), nodePositions.end(), np.begin(),
 		[](V3D x)->vector3f { return vector3f{ x.x, x.y, x.z }; });
-	return new MeshImplementation(g_p, np);
+	graph connectivity = g_p.connectivity(np.size(), runnerOf(executor));
+	const surface::volume_elements elements = g_p.volumeElements();
+	return new MeshImplementation(std::move(connectivity), std::move(np), ordering, executor, &elements);
+}
+
+Mesh * Mesh::createByMove(Graph * g, std::vector<V3D>&& nodePositions, Mesh::NodeOrdering ordering, Executor* executor)
+{
+	GraphImplementation& g_p = dynamic_cast<GraphImplementation&>(*g);
+	std::vector<vector3f> np(nodePositions.size());
+	std::transform(nodePositions.begin(), nodePositions.end(), np.begin(),
+		[](V3D x)->vector3f { return vector3f{ x.x, x.y, x.z }; });
+	std::vector<V3D>().swap(nodePositions);
+	graph connectivity = g_p.connectivity(np.size(), runnerOf(executor));
+	const surface::volume_elements elements = g_p.volumeElements();
+	Mesh* m = new MeshImplementation(std::move(connectivity), std::move(np), ordering, executor, &elements);
+	g_p.clear();
+	return m;
+}
+
+Mesh * Mesh::createOutOfCore(Graph * g, std::vector<V3D>&& nodePositions, const std::string & fileBase,
+	Mesh::NodeOrdering ordering, Executor * executor)
+{
+	std::unique_ptr<Mesh> m(createByMove(g, std::move(nodePositions), ordering, executor));
+	dynamic_cast<MeshImplementation*>(m.get())->mapPositions(fileBase + ".nodes");
+	return m.release();
 }
 
 void Mesh::free(Mesh * m)
@@ -28,22 +86,210 @@ void Mesh::free(Mesh * m)
 	delete m;
 }
 
+void SolveHandle::free(SolveHandle * h)
+{
+	delete h;
+}
+
 PotentialField * PotentialField::createZeros(Mesh * m)
 {
 	return new PotentialFieldImplementation(m);
 }
 
+PotentialField * PotentialField::createCopy(const PotentialField * f)
+{
+	return new PotentialFieldImplementation(dynamic_cast<const PotentialFieldImplementation&>(*f));
+}
+
 void PotentialField::free(PotentialField * f)
 {
 	delete f;
 }
 
-ScalarFieldOperator * ScalarFieldOperator::create(const PotentialField* pF, ScalarFieldOperator::OperatorType type)
+ScalarFieldOperator * ScalarFieldOperator::create(const PotentialField* pF, ScalarFieldOperator::OperatorType type,
+	Executor* executor)
+{
+	const PotentialFieldImplementation& f = dynamic_cast<const PotentialFieldImplementation&>(*pF);
+	return new FieldOperatorImplementation(f, type, executor ? executor : f.executor());
+}
+
+ScalarFieldOperator * ScalarFieldOperator::createOutOfCore(const PotentialField * pF, const std::string & fileBase)
+{
+	return new OutOfCoreOperatorImplementation(*dynamic_cast<const field<double>*>(pF), fileBase);
+}
+
+ScalarFieldOperator * ScalarFieldOperator::createNuma(const PotentialField * pF, OperatorType type, bool largePages)
+{
+	return new NumaOperatorImplementation(*dynamic_cast<const field<double>*>(pF), type, largePages);
+}
+
+ScalarFieldOperator * ScalarFieldOperator::createCompressed(const PotentialField * pF, OperatorType type,
+	bool floatCoefs, Executor * executor)
+{
+	const PotentialFieldImplementation& f = dynamic_cast<const PotentialFieldImplementation&>(*pF);
+	return new CompressedOperatorImplementation(f, type, floatCoefs, executor ? executor : f.executor());
+}
+
+ScalarFieldOperator * ScalarFieldOperator::createShared(const PotentialField * pF, OperatorType type, Executor * executor,
+	bool * pAssembled)
 {
-	return new FieldOperatorImplementation(*dynamic_cast<const field<double>*>(pF), type);
+	const PotentialFieldImplementation& f = dynamic_cast<const PotentialFieldImplementation&>(*pF);
+	bool assembled;
+	ScalarFieldOperator* op = new SharedOperatorImplementation(f, type, executor ? executor : f.executor(), assembled);
+	if (pAssembled) *pAssembled = assembled;
+	return op;
+}
+
+size_t ScalarFieldOperator::sharedOperators()
+{
+	return SharedOperatorImplementation::cachedOperators();
+}
+
+ScalarFieldOperator * ScalarFieldOperator::createCondensed(const PotentialField * pF, OperatorType type, Executor * executor)
+{
+	const PotentialFieldImplementation& f = dynamic_cast<const PotentialFieldImplementation&>(*pF);
+	return new CondensedOperatorImplementation(f, type, executor ? executor : f.executor());
 }
 
 void ScalarFieldOperator::free(ScalarFieldOperator* f)
 {
 	delete f;
+}
+
+void ScalarFieldOperator::applyToFields(PotentialField * const * pFields, size_t nFields, size_t nIterations) const
+{
+	for (size_t i = 0; i < nFields; ++i)
+		for (size_t it = 0; it < nIterations; ++it) applyToField(pFields[i]);
+}
+
+void ScalarFieldOperator::flush(PotentialField *) const
+{}
+
+Probe * Probe::create(const Mesh * m, const std::vector<V3D>& points, Executor * executor)
+{
+	return new ProbeImplementation(m, points, executor);
+}
+
+void Probe::free(Probe * p)
+{
+	delete p;
+}
+
+DirectSolver * DirectSolver::create(const PotentialField * pF, Executor * executor)
+{
+	const PotentialFieldImplementation& f = dynamic_cast<const PotentialFieldImplementation&>(*pF);
+	return new DirectSolverImplementation(f, executor ? executor : f.executor());
+}
+
+void DirectSolver::free(DirectSolver * s)
+{
+	delete s;
+}
+
+FieldWriter * FieldWriter::create(const Mesh * m, const std::string & fileName, FieldWriter::Format format, bool compress)
+{
+	return new FieldWriterImplementation(m, fileName, format, compress);
+}
+
+void FieldWriter::free(FieldWriter * w)
+{
+	delete w;
+}
+
+std::vector<Transport*> Transport::createLocal(int nRanks)
+{
+	std::shared_ptr<LocalTransportHub> pHub = std::make_shared<LocalTransportHub>(nRanks);
+	std::vector<Transport*> result;
+	for (int i = 0; i < nRanks; ++i) result.push_back(new LocalTransport(pHub, i));
+	return result;
+}
+
+Transport * Transport::createMPI()
+{
+#ifdef LS_USE_MPI
+	return new MPITransport;
+#else
+	return NULL;
+#endif // LS_USE_MPI
+}
+
+void Transport::free(Transport * t)
+{
+	delete t;
+}
+
+DistributedField * DistributedField::createFromPart(const Part & part, Transport * t, UINT ghostLayers)
+{
+	return new DistributedFieldImplementation(part, t, ghostLayers);
+}
+
+DistributedField * DistributedField::create(const PotentialField * f, Transport * t, UINT ghostLayers)
+{
+	const Part part = DistributedFieldImplementation::split(*dynamic_cast<const field<double>*>(f), t->rank(), t->size());
+	return new DistributedFieldImplementation(part, t, ghostLayers);
+}
+
+void DistributedField::free(DistributedField * f)
+{
+	delete f;
+}
+
+bool Profiler::enabled()
+{
+#ifdef LS_PROFILING
+	return true;
+#else
+	return false;
+#endif // LS_PROFILING
+}
+
+void Profiler::reset()
+{
+#ifdef LS_PROFILING
+	profiler::instance().reset();
+#endif // LS_PROFILING
+}
+
+std::vector<Profiler::PhaseStats> Profiler::phases()
+{
+	std::vector<PhaseStats> result;
+#ifdef LS_PROFILING
+	profiler::instance().visit([&](const profiler::phase& p)
+	{
+		if (p.calls == 0) return;
+		result.push_back(PhaseStats{ p.name, p.calls, p.totalNs * 1e-6, p.minNs * 1e-6, p.maxNs * 1e-6 });
+	}, [](const std::string&, unsigned long long) {});
+#endif // LS_PROFILING
+	return result;
+}
+
+std::vector<Profiler::CounterStats> Profiler::counters()
+{
+	std::vector<CounterStats> result;
+#ifdef LS_PROFILING
+	profiler::instance().visit([](const profiler::phase&) {}, [&](const std::string& sName, unsigned long long value)
+	{
+		result.push_back(CounterStats{ sName, value });
+	});
+#endif // LS_PROFILING
+	return result;
+}
+
+void Profiler::enableTrace(bool bEnable)
+{
+#ifdef LS_PROFILING
+	profiler::instance().trace(bEnable);
+#else
+	(void)bEnable;
+#endif // LS_PROFILING
+}
+
+bool Profiler::exportChromeTrace(const std::string& fileName)
+{
+#ifdef LS_PROFILING
+	return profiler::instance().exportChromeTrace(fileName);
+#else
+	(void)fileName;
+	return false;
+#endif // LS_PROFILING
 }
\ No newline at end of file
@@ -4,12 +4,19 @@
 
 #include "ls_main.h"
 
+#include <functional>
+#include <memory>
 #include <set>
 #include <vector>
 
 class LAPLACIAN_SOLVER_EXPORT Graph 
 {
 public:
+	//Element types of addElements
+	enum ElementType { EDGE, TRI, SQR, TET, PYR, WEDGE, HEXA };
+
+	virtual ~Graph() {}
+
 	//Adds edge
 	virtual void addEdge(UINT n0, UINT n1) = 0;
 
@@ -31,6 +38,15 @@ public:
 	//Adds hexahedral
 	virtual void addHexa(UINT n0, UINT n1, UINT n2, UINT n3, UINT n4, UINT n5, UINT n6, UINT n7) = 0;
 
+	/**
+	 * Adds nElements elements of one type, nodes holds the nodes of the elements one after another.
+	 * Faces go around: base nodes of pyramids go around it and the apex is the last one, the second triangle of wedges
+	 * lies over the first one, the nodes 4-7 of hexahedra lie over the nodes 0-3 going around the bottom face.
+	 * The nodes are only copied here, edges of the elements are generated, sorted and merged in parallel
+	 * when a mesh is created, volume elements give the mesh its exterior surface
+	 */
+	virtual void addElements(ElementType type, const UINT* nodes, size_t nElements) = 0;
+
 	//Creates new graph
 	static Graph* create();
 
@@ -38,22 +54,123 @@ public:
 	static void free(Graph* g);
 };
 
+/**
+ * Runs parallel loops of the library. A host application with its own scheduler can implement it
+ * to share the processors with the library instead of running the library threads next to its own
+ */
+class LAPLACIAN_SOLVER_EXPORT Executor
+{
+public:
+	//body(begin, end) processes indices [begin, end)
+	using RangeBody = std::function<void(size_t, size_t)>;
+
+	virtual ~Executor() {}
+
+	/**
+	 * Calls body for chunks covering [begin, end) and returns when all of them are done.
+	 * grain is the preferred number of indices in a chunk, 0 leaves it to the executor.
+	 * Chunks can be run by any threads including the calling one, an exception of the body should be rethrown
+	 */
+	virtual void parallelFor(size_t begin, size_t end, size_t grain, const RangeBody& body) = 0;
+
+	//Number of threads running the chunks
+	virtual size_t concurrency() const = 0;
+
+	//Creates work stealing pool, nThreads includes the thread calling parallelFor, 0 means all hardware threads
+	static Executor* createWorkStealing(size_t nThreads = 0);
+
+	//Creates executor running the loops in the calling thread
+	static Executor* createSerial();
+
+	//Work stealing pool with all hardware threads used when no executor is given, it should not be freed
+	static Executor* shared();
+
+	static void free(Executor* e);
+};
+
 //Dummy struct that can be changed to a Vector3D
 struct V3D { double x, y, z; };
 
 class LAPLACIAN_SOLVER_EXPORT Mesh
 {
 public:
+	//Node numbering used inside of the mesh. Graph labels are still used at the API boundary
+	enum NodeOrdering 
+	{ 
+		NATURAL, //labels of the graph are kept
+		RCM,     //reverse Cuthill-McKee ordering of the graph
+		MORTON   //Z-curve ordering of node positions
+	};
+
+	virtual ~Mesh() {}
+
+	/**
+	 * Creates new mesh. The executor runs parallel loops of the mesh and of the fields and operators created on it,
+	 * NULL means Executor::shared(). It should live longer than all of them
+	 */
+	static Mesh* create(const Graph* g, const std::vector<V3D>& nodePositions, NodeOrdering ordering = NATURAL, 
+		Executor* executor = NULL);
+
 	/**
-	 * Creates new mesh
+	 * Creates new mesh taking over the graph connectivity and node positions without copying them.
+	 * The graph is left empty and still should be freed
 	 */
-	static Mesh* create(const Graph* g, const std::vector<V3D>& nodePositions);
+	static Mesh* createByMove(Graph* g, std::vector<V3D>&& nodePositions, NodeOrdering ordering = NATURAL,
+		Executor* executor = NULL);
+
+	/**
+	 * Creates mesh as createByMove and keeps its node positions in the memory mapped file <fileBase>.nodes,
+	 * so they are paged by the system as the matrix of ScalarFieldOperator::createOutOfCore. The graph stays in memory.
+	 * The file is removed when the mesh and all fields and operators created on it are freed
+	 */
+	static Mesh* createOutOfCore(Graph* g, std::vector<V3D>&& nodePositions, const std::string& fileBase,
+		NodeOrdering ordering = NATURAL, Executor* executor = NULL);
 
 	//Deletes mesh instance
 	static void free(Mesh* m);
 
 	//Returns box defined by two points containing all mesh vertices
 	virtual std::pair<V3D, V3D> getBox() const = 0;
+
+	/**
+	 * Gets faces of the volume elements (tetrahedra, pyramids, wedges and hexahedra) which belong to one element only.
+	 * Every face takes four node labels, triangles repeat their last node. Only the elements added by Graph::addElements
+	 * have faces, elements added one by one keep the node order of the graph library and give only edges
+	 */
+	virtual void getExteriorFaces(std::vector<UINT>& faceNodes) const = 0;
+
+	/**
+	 * Gets unit normals of the nodes of the exterior faces pointing inside the mesh, they are area weighted sums
+	 * of the normals of the faces around a node. Other nodes get zero normals
+	 */
+	virtual void getExteriorNormals(std::vector<V3D>& normals) const = 0;
+};
+
+class ScalarFieldOperator;
+
+//Solve running in a background thread
+class LAPLACIAN_SOLVER_EXPORT SolveHandle
+{
+public:
+	virtual ~SolveHandle() {}
+
+	//Asks the solve to stop after the current iteration
+	virtual void cancel() = 0;
+
+	//Number of iterations done
+	virtual size_t progress() const = 0;
+
+	//Number of requested iterations
+	virtual size_t total() const = 0;
+
+	//Checks if the solve has stopped
+	virtual bool finished() const = 0;
+
+	//Waits for the solve to stop and rethrows its exception if any
+	virtual void wait() = 0;
+
+	//Cancels the solve, waits for it and deletes the handle
+	static void free(SolveHandle* h);
 };
 
 class LAPLACIAN_SOLVER_EXPORT PotentialField
@@ -62,13 +179,25 @@ public:
 	//Acceptable types of boundaries
 	enum BOUNDARY_TYPE { FIXED_VAL, ZERO_GRAD };
 
+	//Field is even about a symmetric plane and odd about an antisymmetric one
+	enum SYMMETRY_TYPE { SYMMETRIC, ANTISYMMETRIC };
+
+	virtual ~PotentialField() {}
+
 	//Creates potential field filled with zeros
 	static PotentialField* createZeros(Mesh* m);
+
+	//Creates a copy of a field. Boundaries are shared with the original field until one of them changes
+	static PotentialField* createCopy(const PotentialField* f);
 	static void free(PotentialField* f);
 
 	//Get current field values. The indices of the values correspond to the number of labels in a graph
+	//It should not be called while a background solve runs, use getPotentialSnapshot instead
 	virtual const std::vector<double>& getPotentialVals() const = 0;
 
+	//Get a copy of field values which is not changed by a running background solve
+	virtual std::shared_ptr<const std::vector<double>> getPotentialSnapshot() const = 0;
+
 	//Set boundary field values
 	virtual void setBoundaryVal(const std::string& name, double val) = 0;
 
@@ -78,17 +207,58 @@ public:
 	//Adds new boundary node labels should be listed
 	virtual void addBoundary(const std::string& sName, const std::vector<UINT>& vLabels, const std::vector<V3D>& vNormals) = 0;
 
+	//Adds new boundary, node normals are taken from the exterior surface of the mesh elements. Labels may repeat
+	virtual void addBoundary(const std::string& sName, const std::vector<UINT>& vLabels) = 0;
+
+	/**
+	 * Adds new boundary of nodes of nFaces faces with nodesPerFace (3 or 4) labels each, e.g. face lists of .rgn files.
+	 * Node normals are taken from the exterior surface of the mesh elements
+	 */
+	virtual void addBoundaryFaces(const std::string& sName, const UINT* faceNodes, size_t nFaces, UINT nodesPerFace) = 0;
+
+	/**
+	 * Adds a boundary for every distinct tag of exterior faces, faceTags[i] tags the face i of Mesh::getExteriorFaces.
+	 * Boundaries are named prefix + tag
+	 */
+	virtual void addBoundariesByTag(const std::vector<UINT>& faceTags, const std::string& prefix) = 0;
+
 	//Sets boundary type
 	virtual void setBoundaryType(const std::string& name, BOUNDARY_TYPE type) = 0;
 
+	/**
+	 * Declares a mirror plane x[axis] = position of the full domain, axis is 0, 1 or 2 for x, y or z.
+	 * The mesh should cover only one side of the plane. Mesh nodes on the plane get the boundary patch "symmetry_x",
+	 * "symmetry_y" or "symmetry_z" with zero gradient for symmetric and zero value for antisymmetric planes.
+	 * interpolate and resample take points of the full domain, points on the other side are reflected
+	 * and antisymmetric planes change the sign of the value. It should be called before operators are created
+	 */
+	virtual void addSymmetryPlane(UINT axis, double position, SYMMETRY_TYPE type) = 0;
+
 	//Changes field array values accordingly to boundary conditions
 	virtual void applyBoundaryConditions() = 0;
 
-	//Make one step of laplacian solver
+	//Make one step of laplacian solver, it runs on the executor of the mesh
 	virtual void diffuse() = 0;
 
 	//Interpolate field value at a current point
+	//While a background solve runs it uses the last published snapshot and can be called from other threads
 	virtual double interpolate(double x, double y, double z, UINT* track_label = NULL) const = 0;
+
+	/**
+	 * Interpolates the field onto a regular lattice of nx*ny*nz points covering a box, the mesh box by default.
+	 * values should hold nx*ny*nz elements, the value at point (i, j, k) is put to values[i + nx*(j + ny*k)].
+	 * A 2D slice is obtained with nz = 1 and equal z coordinates of the box corners.
+	 * The lattice is shared between the threads of the executor, NULL means the executor of the mesh
+	 */
+	virtual void resample(double* values, UINT nx, UINT ny, UINT nz, 
+		const std::pair<V3D, V3D>* box = NULL, Executor* executor = NULL) const = 0;
+
+	/**
+	 * Applies the operator nIterations times in a background thread, matrix products run on the executor of the operator.
+	 * Field values are published for readers every publishEvery iterations and after the last one.
+	 * The field should not be changed until the solve has finished
+	 */
+	virtual SolveHandle* solveAsync(const ScalarFieldOperator* op, size_t nIterations, size_t publishEvery = 10) = 0;
 };
 
 //Field linear transformations
@@ -100,11 +270,313 @@ public:
 		Identity,
 		LaplacianSolver
 	};
-	//Field operator factory
-	static ScalarFieldOperator* create(const PotentialField* pF, OperatorType type = Identity);
+
+	virtual ~ScalarFieldOperator() {}
+
+	//Field operator factory, the executor runs assembly and matrix products, NULL means the executor of the mesh
+	static ScalarFieldOperator* create(const PotentialField* pF, OperatorType type = Identity, Executor* executor = NULL);
+
+	/**
+	 * Creates laplacian solver which keeps its matrix in memory mapped files <fileBase>.rows, .cols and .coefs
+	 * and streams through them, so the matrix can be larger than the memory. Node positions are paged out
+	 * by meshes created with Mesh::createOutOfCore, the graph, boundaries and values of the field stay in memory.
+	 * The files are removed with the operator.
+	 * Such operator does not support update and relax
+	 */
+	static ScalarFieldOperator* createOutOfCore(const PotentialField* pF, const std::string& fileBase);
+
+	/**
+	 * Creates operator with rows split between NUMA nodes of the machine. Rows of every node are placed in its memory,
+	 * optionally in large pages, and are multiplied only by worker threads pinned to its processors.
+	 * Such operator does not support update and relax
+	 */
+	static ScalarFieldOperator* createNuma(const PotentialField* pF, OperatorType type = LaplacianSolver, bool largePages = false);
+
+	/**
+	 * Creates operator keeping column labels of its matrix as variable length differences, after a locality ordering
+	 * of the mesh they take about one byte instead of four. floatCoefs also stores coefficients in floats, it halves
+	 * the memory again but moves the converged field by the float rounding of the coefficients, about 1e-7 relative.
+	 * Matrix products run on the executor, NULL means the executor of the mesh. Such operator does not support update and relax
+	 */
+	static ScalarFieldOperator* createCompressed(const PotentialField* pF, OperatorType type = LaplacianSolver,
+		bool floatCoefs = false, Executor* executor = NULL);
+
+	/**
+	 * Returns operator shared by all fields of the mesh with the same boundary nodes, types and normals, e.g. fields
+	 * of a parameter sweep differing only in boundary values. The matrix is assembled once and kept while any of
+	 * the returned operators is not freed. Shared operators are immutable and do not support update.
+	 * pAssembled, if given, is set when this call assembled the matrix, i.e. no other handle of the operator was alive
+	 */
+	static ScalarFieldOperator* createShared(const PotentialField* pF, OperatorType type = LaplacianSolver, Executor* executor = NULL,
+		bool* pAssembled = NULL);
+
+	//Number of operators kept for createShared, an operator is released with the last of its handles
+	static size_t sharedOperators();
+
+	/**
+	 * Creates operator which drops the rows of fixed value nodes and iterates only on the other nodes with compact labels.
+	 * The values of these nodes and the contributions of fixed values of every field it is applied to stay in the operator
+	 * between calls. Boundary values can change between calls, only the contributions of changed values are recomputed.
+	 * The field gets the iterated values only by flush. If other operators, diffusion or solvers write the field values
+	 * before it, the unflushed values are dropped and the operator starts again from the values of the field.
+	 * Such operator does not support update, relax and applyTiled
+	 */
+	static ScalarFieldOperator* createCondensed(const PotentialField* pF, OperatorType type = LaplacianSolver, Executor* executor = NULL);
 	static void free(ScalarFieldOperator* pFO);
 
 	//Applies operator to a field
 	virtual void applyToField(PotentialField* pF) const = 0;
+
+	/**
+	 * Rebuilds only the rows of nodes which joined, left or retyped boundary patches after the operator was created or updated.
+	 * pF should be the field the operator was created for or its copy. Returns the number of rebuilt rows
+	 */
+	virtual size_t update(const PotentialField* pF) = 0;
+
+	/**
+	 * Updates only the nodes affected by boundary values applied since the last relaxation
+	 * until their residuals are below tolerance. Other applications of an operator to the field take the changes too,
+	 * so relaxation continues from the field they leave. Returns the number of node updates,
+	 * maxUpdates = 0 means no limit, the remaining work is continued by the next call
+	 */
+	virtual size_t relax(PotentialField* pF, double tolerance, size_t maxUpdates = 0) const = 0;
+
+	/**
+	 * Makes nIterations steps of the Chebyshev accelerated iteration. It converges to the same solution
+	 * as repeated applyToField calls in several times fewer steps and needs one more copy of the field
+	 */
+	virtual void applyChebyshev(PotentialField* pF, size_t nIterations) const = 0;
+
+	//Spectral radius estimate used by the Chebyshev iteration, it is computed on the first call
+	virtual double spectralRadius() const = 0;
+
+	/**
+	 * Applies the operator nIterations times with exactly the same result as repeated applyToField calls.
+	 * The mesh is split into blocks of about cacheBytes extended by depth layers of the nodes they depend on,
+	 * every block makes depth iterations while it stays in the cache. The blocks are built on the first call.
+	 * Operators without the matrix in memory make separate sweeps
+	 */
+	virtual void applyTiled(PotentialField* pF, size_t nIterations, size_t depth = 4, size_t cacheBytes = 1 << 19) const = 0;
+
+	/**
+	 * Applies the operator nIterations times to nFields fields of its mesh, every field gets exactly the same result
+	 * as repeated applyToField calls. Operators with the matrix in memory keep the fields interleaved by nodes
+	 * during the call and read the matrix once per iteration for all of them, the others make separate sweeps
+	 */
+	virtual void applyToFields(PotentialField* const* pFields, size_t nFields, size_t nIterations = 1) const;
+
+	/**
+	 * Writes the values the operator keeps for the field back to it and releases them. Operators keeping the iterated
+	 * values between calls write the field only here, the others write it on every call and do nothing
+	 */
+	virtual void flush(PotentialField* pF) const;
+};
+
+//Fixed set of points compiled to interpolation weights, sampling a field at them is one sparse matrix product
+class LAPLACIAN_SOLVER_EXPORT Probe
+{
+public:
+	virtual ~Probe() {}
+
+	/**
+	 * Locates the points on the mesh once and keeps their interpolation weights.
+	 * The executor compiles and samples the points, NULL means the executor of the mesh
+	 */
+	static Probe* create(const Mesh* m, const std::vector<V3D>& points, Executor* executor = NULL);
+	static void free(Probe* p);
+
+	//Number of points
+	virtual size_t size() const = 0;
+
+	/**
+	 * Puts field values interpolated at the points to values, it should hold size() elements.
+	 * The field should be created on the mesh of the probe, while a background solve runs its last snapshot is sampled.
+	 * Points of fields with symmetry planes are reflected as by interpolate, their stencils are located on the first sample
+	 */
+	virtual void sample(const PotentialField* f, double* values) const = 0;
+};
+
+//Direct solver of the laplacian problem reusing one factorization for many sets of boundary values
+class LAPLACIAN_SOLVER_EXPORT DirectSolver
+{
+public:
+	virtual ~DirectSolver() {}
+
+	/**
+	 * Assembles the laplacian solver of the field and factorizes its equations for the nodes which are not fixed.
+	 * The factorization uses nested dissection ordering and dense supernodes, its memory grows faster than the mesh, so it is meant
+	 * for meshes up to a few hundred thousand nodes. The field should have fixed value nodes, a singular system throws.
+	 * The executor runs assembly, NULL means the executor of the mesh, the factorization and solves are single-threaded
+	 */
+	static DirectSolver* create(const PotentialField* pF, Executor* executor = NULL);
+	static void free(DirectSolver* s);
+
+	/**
+	 * Puts the solution for the current fixed values of the field to its nodes by two triangular solves.
+	 * The field should have the boundary nodes and types of the field the solver was created for, values may differ
+	 */
+	virtual void solve(PotentialField* pF) const = 0;
+
+	//Number of stored elements of the triangular factors
+	virtual size_t factorNonZeros() const = 0;
+};
+
+//Writes a mesh and fields on its nodes to binary files, nodes are written in the order of user labels
+class LAPLACIAN_SOLVER_EXPORT FieldWriter
+{
+public:
+	enum Format
+	{
+		RAW, //Arrays of node positions, edges and fields in the file and their description in the file <fileName>.json
+		VTK  //VTK XML unstructured grid (.vtu) with appended binary data, mesh edges are written as line cells
+	};
+
+	virtual ~FieldWriter() {}
+
+	//Creates writer of the mesh, compression requires the library built with LS_USE_ZLIB
+	static FieldWriter* create(const Mesh* m, const std::string& fileName, Format format, bool compress = false);
+
+	//Waits for the writing and deletes the writer
+	static void free(FieldWriter* w);
+
+	//Adds node values of a field, they are taken from a snapshot, so the field can be changed during writing
+	virtual void addField(const std::string& name, const PotentialField* f) = 0;
+
+	//Starts writing in a background thread, the file is streamed in blocks compressed in parallel
+	virtual void write() = 0;
+
+	//Checks if the writing has finished
+	virtual bool finished() const = 0;
+
+	//Waits for the writing to finish and rethrows its exception if any
+	virtual void wait() = 0;
+};
+
+//Point to point message passing between processes of a distributed solver
+class LAPLACIAN_SOLVER_EXPORT Transport
+{
+public:
+	virtual ~Transport() {}
+
+	//Number of this process
+	virtual int rank() const = 0;
+
+	//Total number of processes
+	virtual int size() const = 0;
+
+	//Sends bytes to the process dest, does not wait for the receiver
+	virtual void send(int dest, const void* data, size_t bytes) = 0;
+
+	//Receives bytes from the process src, waits for the message
+	virtual void receive(int src, void* data, size_t bytes) = 0;
+
+	//Waits until all sent messages are delivered
+	virtual void wait() = 0;
+
+	//Creates transports for nRanks processes emulated by threads of one process, every transport should be used by its own thread
+	static std::vector<Transport*> createLocal(int nRanks);
+
+	//Creates transport over MPI_COMM_WORLD, returns NULL if the library was built without LS_USE_MPI
+	static Transport* createMPI();
+
+	static void free(Transport* t);
+};
+
+//Part of a potential field owned by one process of a distributed solver
+class LAPLACIAN_SOLVER_EXPORT DistributedField
+{
+public:
+	//Boundary condition of a patch, mirror patches come from symmetry planes
+	enum PatchType { FIXED_VAL, ZERO_GRAD, MIRROR };
+
+	//Owned nodes of a boundary patch
+	struct Patch
+	{
+		std::string name;
+		PatchType type;
+		std::vector<UINT> nodes;  //Indices of the nodes in Part::labels
+		std::vector<V3D> normals; //Normals of the nodes pointing inside the mesh
+	};
+
+	//Nodes owned by a process, nodes are named by global labels unique among all processes
+	struct Part
+	{
+		std::vector<UINT> labels;
+		std::vector<V3D> positions;
+		std::vector<size_t> neighbourStart; //Neighbours of the node i are neighbours[neighbourStart[i]]...neighbours[neighbourStart[i + 1] - 1]
+		std::vector<UINT> neighbours;       //Global labels of the mesh neighbours, they can be owned by other processes
+		std::vector<double> values;
+		std::vector<Patch> patches;
+	};
+
+	virtual ~DistributedField() {}
+
+	/**
+	 * Creates the part of the field owned by the process t->rank(), all processes should call it together.
+	 * Every process knows only its own nodes, ghostLayers layers of neighbour nodes are requested
+	 * from the processes owning them, ghostLayers should be positive
+	 */
+	static DistributedField* createFromPart(const Part& part, Transport* t, UINT ghostLayers = 3);
+
+	/**
+	 * Splits the field between t->size() processes by recursive coordinate bisection and
+	 * creates the part of the process t->rank() from its own nodes by createFromPart.
+	 * Global labels are the user labels of the mesh
+	 */
+	static DistributedField* create(const PotentialField* f, Transport* t, UINT ghostLayers = 3);
+	static void free(DistributedField* f);
+
+	//Makes steps of the laplacian solver, ghost values are exchanged once per step
+	virtual void iterate(size_t nIterations) = 0;
+
+	//Makes steps of the Chebyshev accelerated solver, rho is ScalarFieldOperator::spectralRadius of the global laplacian solver
+	virtual void iterateChebyshev(size_t nIterations, double rho) = 0;
+
+	//Labels of the nodes owned by the process
+	virtual const std::vector<UINT>& ownedLabels() const = 0;
+
+	//Values of the owned nodes in the order of ownedLabels
+	virtual std::vector<double> ownedValues() const = 0;
+
+	//Copies values of the owned nodes to a field created on the global mesh
+	virtual void gather(PotentialField* f) const = 0;
+};
+
+//Statistics of solver phases. They are collected only if the library was built with LS_PROFILING defined
+class LAPLACIAN_SOLVER_EXPORT Profiler
+{
+public:
+	//Timings of an instrumented phase in milliseconds
+	struct PhaseStats
+	{
+		std::string name;
+		unsigned long long calls;
+		double totalMs, minMs, maxMs;
+	};
+
+	//Accumulated value of a counter
+	struct CounterStats
+	{
+		std::string name;
+		unsigned long long value;
+	};
+
+	//Checks if the library collects statistics
+	static bool enabled();
+
+	//Sets all statistics to zero
+	static void reset();
+
+	//Returns statistics of all phases executed since the last reset
+	static std::vector<PhaseStats> phases();
+
+	//Returns all counters, "allocations" and "allocated_bytes" count matrices and work vectors allocated by the solvers
+	static std::vector<CounterStats> counters();
+
+	//Switches recording of trace events, it is off by default
+	static void enableTrace(bool bEnable);
+
+	//Writes recorded trace events to a file in chrome://tracing JSON format
+	static bool exportChromeTrace(const std::string& fileName);
 };
 #endif // !_LS_EXPORT_H_
@@ -0,0 +1,62 @@
+#include "CompressedOperatorImplementation.h"
+#include "ExecutorImplementation.h"
+
+CompressedLinearOp CompressedOperatorImplementation::compress(const Field & field,
+	ScalarFieldOperator::OperatorType type, bool floatCoefs, const ParallelRunner & run)
+{
+	checkOperatorType(type, "CompressedOperatorImplementation::compress");
+	const FieldLinearOp<double> assembler(field); //Zero operator only assembling rows
+	return CompressedLinearOp(field.size(),
+		[&](uint32_t i, CompressedLinearOp::matrix_row& row) { assembleOperatorRow(assembler, type, i, row); },
+		floatCoefs, run);
+}
+
+CompressedOperatorImplementation::CompressedOperatorImplementation(const Field & field,
+	ScalarFieldOperator::OperatorType type, bool floatCoefs, Executor * executor)
+	:
+	m_matrix(compress(field, type, floatCoefs, runnerOf(executor))),
+	m_rho(-1.0)
+{}
+
+void CompressedOperatorImplementation::applyToField(PotentialField * pField) const
+{
+	data_vector& x = operatorFieldData(pField, m_matrix.size(), "CompressedOperatorImplementation::applyToField");
+	data_vector result(x.size());
+	LS_PROFILE_ALLOC(result.size() * sizeof(double));
+	m_matrix.product(x, [&](size_t i, double val) { result[i] = val; });
+	x.swap(result);
+}
+
+size_t CompressedOperatorImplementation::update(const PotentialField *)
+{
+	throw std::runtime_error("CompressedOperatorImplementation::update: "
+		"Compressed operators are not updated, create a new one.");
+}
+
+size_t CompressedOperatorImplementation::relax(PotentialField *, double, size_t) const
+{
+	throw std::runtime_error("CompressedOperatorImplementation::relax: "
+		"Relaxation needs random access to rows and is not supported by compressed operators.");
+}
+
+void CompressedOperatorImplementation::applyChebyshev(PotentialField * pField, size_t nIterations) const
+{
+	data_vector& x = operatorFieldData(pField, m_matrix.size(), "CompressedOperatorImplementation::applyChebyshev");
+	chebyshevIteration(x, nIterations, spectralRadius(),
+		[this](const data_vector& v, auto V) { m_matrix.product(v, V); });
+}
+
+double CompressedOperatorImplementation::spectralRadius() const
+{
+	double rho = m_rho;
+	if (rho >= 0.0) return rho;
+	m_rho = rho = powerIteration(m_matrix.size(), 30,
+		[this](const std::vector<double>& v, auto V) { m_matrix.product(v, V); },
+		[this](size_t i)->bool { return m_matrix.isIdentityRow(i); });
+	return rho;
+}
+
+void CompressedOperatorImplementation::applyTiled(PotentialField * pField, size_t nIterations, size_t, size_t) const
+{
+	for (size_t i = 0; i < nIterations; ++i) applyToField(pField);
+}
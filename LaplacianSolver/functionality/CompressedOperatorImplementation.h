@@ -0,0 +1,39 @@
+#pragma once
+#ifndef _COMPRESSED_OPERATOR_IMPLEMENTATION_H_
+#define _COMPRESSED_OPERATOR_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+
+#include "..\LSExport.h"
+#include "..\mesh_math\compressedOperator.h"
+#include "fieldOperatorImplementation.h"
+
+//Field operator keeping its matrix with compressed column labels and optionally float coefficients
+class CompressedOperatorImplementation : public ScalarFieldOperator
+{
+	using Field = field<double>;
+	using data_vector = Field::data_vector;
+
+	CompressedLinearOp m_matrix;
+	mutable std::atomic<double> m_rho; //Negative until it is estimated
+
+	//Compresses rows of the operator type as they are assembled
+	static CompressedLinearOp compress(const Field& field, ScalarFieldOperator::OperatorType type, bool floatCoefs,
+		const ParallelRunner& run);
+public:
+	CompressedOperatorImplementation(const Field& field, ScalarFieldOperator::OperatorType type, bool floatCoefs, Executor* executor);
+
+	void applyToField(PotentialField* field) const;
+
+	size_t update(const PotentialField* field);
+
+	size_t relax(PotentialField* field, double tolerance, size_t maxUpdates) const;
+
+	void applyChebyshev(PotentialField* field, size_t nIterations) const;
+
+	double spectralRadius() const;
+
+	void applyTiled(PotentialField* field, size_t nIterations, size_t depth, size_t cacheBytes) const;
+};
+
+#endif // !_COMPRESSED_OPERATOR_IMPLEMENTATION_H_
@@ -0,0 +1,95 @@
+#include "CondensedOperatorImplementation.h"
+#include "ExecutorImplementation.h"
+
+FieldLinearOp<double> CondensedOperatorImplementation::assemble(const Field & field,
+	ScalarFieldOperator::OperatorType type, const ParallelRunner & run)
+{
+	FieldLinearOp<double> assembler(field);
+	assembler.setRunner(run);
+	assembleOperator(assembler, type, "CondensedOperatorImplementation::assemble");
+	return assembler;
+}
+
+CondensedOperatorImplementation::CondensedOperatorImplementation(const Field & field,
+	ScalarFieldOperator::OperatorType type, Executor * executor)
+	:
+	m_matrix(assemble(field, type, runnerOf(executor)), runnerOf(executor)),
+	m_rho(-1.0)
+{}
+
+void CondensedOperatorImplementation::evictStale() const
+{
+	for (auto it = m_states.begin(); it != m_states.end();)
+	{
+		if (it->second.tag.expired()) it = m_states.erase(it);
+		else ++it;
+	}
+}
+
+CondensedOperatorImplementation::FieldState & CondensedOperatorImplementation::state(PotentialField * pField,
+	const char * caller) const
+{
+	const Field& f = operatorField(pField, m_matrix.size(), caller);
+	const data_vector& x = f.data();
+	evictStale();
+	FieldState& s = m_states[pField];
+	if (s.tag.lock() != f.values_tag().lock())
+	{
+		s.tag = f.values_tag();
+		s.xI = m_matrix.gather(x);
+		s.b = m_matrix.rhs(x);
+		s.fixedVals = m_matrix.coupledValues(x);
+	}
+	else m_matrix.updateRhs(x, s.fixedVals, s.b);
+	return s;
+}
+
+void CondensedOperatorImplementation::applyToField(PotentialField * pField) const
+{
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+	FieldState& s = state(pField, "CondensedOperatorImplementation::applyToField");
+	m_matrix.apply(s.xI, s.b, 1, s.next);
+}
+
+size_t CondensedOperatorImplementation::update(const PotentialField *)
+{
+	throw std::runtime_error("CondensedOperatorImplementation::update: "
+		"Condensed operators are not updated, create a new one.");
+}
+
+size_t CondensedOperatorImplementation::relax(PotentialField *, double, size_t) const
+{
+	throw std::runtime_error("CondensedOperatorImplementation::relax: "
+		"Relaxation is not supported by condensed operators.");
+}
+
+void CondensedOperatorImplementation::applyChebyshev(PotentialField * pField, size_t nIterations) const
+{
+	const double rho = spectralRadius();
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+	FieldState& s = state(pField, "CondensedOperatorImplementation::applyChebyshev");
+	m_matrix.chebyshev(s.xI, s.b, nIterations, rho);
+}
+
+double CondensedOperatorImplementation::spectralRadius() const
+{
+	double rho = m_rho;
+	if (rho < 0.0) m_rho = rho = m_matrix.spectralRadius();
+	return rho;
+}
+
+void CondensedOperatorImplementation::applyTiled(PotentialField *, size_t, size_t, size_t) const
+{
+	throw std::runtime_error("CondensedOperatorImplementation::applyTiled: "
+		"Condensed operators are not tiled, depth and cache size have no meaning for them, use applyToField.");
+}
+
+void CondensedOperatorImplementation::flush(PotentialField * pField) const
+{
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+	evictStale();
+	auto it = m_states.find(pField);
+	if (it == m_states.end()) return;
+	m_matrix.scatter(it->second.xI, operatorFieldData(pField, m_matrix.size(), "CondensedOperatorImplementation::flush"));
+	m_states.erase(it);
+}
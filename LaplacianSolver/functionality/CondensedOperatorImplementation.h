@@ -0,0 +1,60 @@
+#pragma once
+#ifndef _CONDENSED_OPERATOR_IMPLEMENTATION_H_
+#define _CONDENSED_OPERATOR_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "..\LSExport.h"
+#include "..\mesh_math\condensedOperator.h"
+#include "fieldOperatorImplementation.h"
+
+/**
+ * Field operator iterating on the nodes which are not fixed. Values of unknowns of every field it is applied to
+ * stay in the operator between calls and are written to the field by flush
+ */
+class CondensedOperatorImplementation : public ScalarFieldOperator
+{
+	using Field = field<double>;
+	using data_vector = Field::data_vector;
+
+	//Unknowns of a field with the right hand side of its fixed values
+	struct FieldState
+	{
+		std::weak_ptr<const void> tag; //Values tag of the field the state was gathered from
+		data_vector xI, b, fixedVals, next;
+	};
+
+	CondensedLinearOp m_matrix;
+	mutable std::atomic<double> m_rho; //Negative until it is estimated
+	mutable std::map<const PotentialField*, FieldState> m_states;
+	mutable std::mutex m_stateMutex; //Guards m_states, it is held during iterations
+
+	//Assembles the operator matrix, it is dropped after condensation
+	static FieldLinearOp<double> assemble(const Field& field, ScalarFieldOperator::OperatorType type, const ParallelRunner& run);
+
+	//Drops states of the fields destroyed or written since, m_stateMutex must be held
+	void evictStale() const;
+
+	//State of the field with the right hand side brought up to date with its fixed values, m_stateMutex must be held
+	FieldState& state(PotentialField* field, const char* caller) const;
+public:
+	CondensedOperatorImplementation(const Field& field, ScalarFieldOperator::OperatorType type, Executor* executor);
+
+	void applyToField(PotentialField* field) const;
+
+	size_t update(const PotentialField* field);
+
+	size_t relax(PotentialField* field, double tolerance, size_t maxUpdates) const;
+
+	void applyChebyshev(PotentialField* field, size_t nIterations) const;
+
+	double spectralRadius() const;
+
+	void applyTiled(PotentialField* field, size_t nIterations, size_t depth, size_t cacheBytes) const;
+
+	void flush(PotentialField* field) const;
+};
+
+#endif // !_CONDENSED_OPERATOR_IMPLEMENTATION_H_
@@ -0,0 +1,57 @@
+#include "DirectSolverImplementation.h"
+#include "ExecutorImplementation.h"
+
+namespace
+{
+	//Matrix I - A of the condensed operator
+	struct SystemMatrix
+	{
+		const CondensedLinearOp& A;
+
+		size_t size() const { return A.unknowns(); }
+
+		template<typename visitor>
+		void visitRow(uint32_t k, visitor V) const
+		{
+			V(k, 1.0);
+			A.visitRow(k, [&](uint32_t col, double coef) { V(col, -coef); });
+		}
+	};
+}
+
+FieldLinearOp<double> DirectSolverImplementation::assemble(const Field & field, const ParallelRunner & run)
+{
+	FieldLinearOp<double> assembler(field);
+	assembler.setRunner(run);
+	assembler.laplacianSolver();
+	return assembler;
+}
+
+DirectSolverImplementation::DirectSolverImplementation(const Field & field, Executor * executor)
+	:
+	m_system(assemble(field, runnerOf(executor)), runnerOf(executor)),
+	m_factors(factorize(m_system))
+{}
+
+SparseLU DirectSolverImplementation::factorize(const CondensedLinearOp & system)
+{
+	//Without fixed values the solution is defined up to a constant
+	if (system.unknowns() == system.size())
+		throw std::runtime_error("DirectSolverImplementation::factorize: The field has no fixed value nodes.");
+	return SparseLU(SystemMatrix{ system });
+}
+
+void DirectSolverImplementation::solve(PotentialField * pField) const
+{
+	Field& f = *dynamic_cast<Field*>(pField);
+	data_vector& x = f.data();
+	data_vector xI = m_system.rhs(x);
+	m_factors.solve(xI);
+	m_system.scatter(xI, x);
+	f.touch_values();
+}
+
+size_t DirectSolverImplementation::factorNonZeros() const
+{
+	return m_factors.nonZeros();
+}
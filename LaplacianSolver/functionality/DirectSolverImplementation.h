@@ -0,0 +1,31 @@
+#pragma once
+#ifndef _DIRECT_SOLVER_IMPLEMENTATION_H_
+#define _DIRECT_SOLVER_IMPLEMENTATION_H_ 1
+
+#include "..\LSExport.h"
+#include "..\mesh_math\condensedOperator.h"
+#include "..\mesh_math\sparseLU.h"
+
+//Solves (I - A) x = b for the unknowns of the condensed laplacian solver x = Ax + b
+class DirectSolverImplementation : public DirectSolver
+{
+	using Field = field<double>;
+	using data_vector = Field::data_vector;
+
+	CondensedLinearOp m_system;
+	SparseLU m_factors;
+
+	//Assembles the laplacian solver, it is dropped after condensation
+	static FieldLinearOp<double> assemble(const Field& field, const ParallelRunner& run);
+
+	//Factorizes I - A, the system should have fixed value nodes
+	static SparseLU factorize(const CondensedLinearOp& system);
+public:
+	DirectSolverImplementation(const Field& field, Executor* executor);
+
+	void solve(PotentialField* field) const;
+
+	size_t factorNonZeros() const;
+};
+
+#endif // !_DIRECT_SOLVER_IMPLEMENTATION_H_
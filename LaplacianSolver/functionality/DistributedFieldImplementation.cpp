@@ -0,0 +1,121 @@
+#include "DistributedFieldImplementation.h"
+#include "PotentialFieldImplementation.h"
+
+DistributedFieldImplementation::DistributedFieldImplementation(
+	const Part& part, 
+	Transport* t, 
+	UINT ghostLayers)
+	:
+	m_ownedLabels(part.labels)
+{
+	if (ghostLayers < 1)
+		throw std::runtime_error("DistributedFieldImplementation::DistributedFieldImplementation: Number of ghost layers should be positive.");
+	//Data of the part are checked on all processes together, a process throwing alone would leave the others waiting
+	std::string error;
+	if (part.values.size() != part.labels.size())
+		error = "DistributedFieldImplementation::DistributedFieldImplementation: Sizes of node data mismatch.";
+	for (const Patch& patch : part.patches)
+		if (patch.nodes.size() != patch.normals.size())
+			error = "DistributedFieldImplementation::DistributedFieldImplementation: Patch nodes and normals sizes mismatch.";
+		else if (std::find_if(patch.nodes.begin(), patch.nodes.end(), [&](UINT l) { return l >= part.labels.size(); }) != patch.nodes.end())
+			error = "DistributedFieldImplementation::DistributedFieldImplementation: Patch node is not in the part.";
+	throwIfAnyFailed(*t, error, "DistributedFieldImplementation::DistributedFieldImplementation");
+	mesh_geometry<double, UINT>::node_positions positions;
+	positions.reserve(part.positions.size());
+	for (const V3D& r : part.positions) positions.push_back(field<double>::vector3f{ r.x, r.y, r.z });
+	m_localMesh = assembleLocalMesh<double>(*t, part.labels, positions, part.neighbourStart, part.neighbours, ghostLayers);
+
+	//Owned nodes go first in the local mesh in the order of the part
+	field<double> localField(m_localMesh.mesh);
+	for (const Patch& patch : part.patches)
+	{
+		std::vector<field<double>::vector3f> normals;
+		for (const V3D& n : patch.normals) normals.push_back(field<double>::vector3f{ n.x, n.y, n.z });
+		localField.add_boundary(patch.name, patch.nodes, normals);
+		localField.set_boundary_type(patch.name,
+			patch.type == FIXED_VAL ? field<double>::BoundaryMesh::FIXED_VAL :
+			patch.type == MIRROR ? field<double>::BoundaryMesh::MIRROR : field<double>::BoundaryMesh::ZERO_GRAD);
+	}
+
+	m_pOperator.reset(new distributed_operator(*t, m_localMesh, localField));
+
+	//Ghost values are received before they are used
+	m_data.assign(m_localMesh.globalLabels.size(), 0.0);
+	std::copy(part.values.begin(), part.values.end(), m_data.begin());
+}
+
+DistributedField::Part DistributedFieldImplementation::split(const field<double>& globalField, int rank, int nRanks)
+{
+	const mesh_geometry<double, UINT>& globalMesh = globalField.mesh();
+	const std::vector<uint32_t> parts = coordinateBisection(globalMesh.positions(), static_cast<uint32_t>(nRanks));
+
+	Part result;
+	result.neighbourStart.push_back(0);
+	std::vector<UINT> index(globalMesh.size(), static_cast<UINT>(-1));
+	for (UINT l = 0; l < globalMesh.size(); ++l)
+	{
+		if (parts[l] != static_cast<uint32_t>(rank)) continue;
+		index[l] = static_cast<UINT>(result.labels.size());
+		result.labels.push_back(globalMesh.outerLabel(l));
+		const field<double>::vector3f& r = globalMesh.spacePositionOf(l);
+		result.positions.push_back(V3D{ r[0], r[1], r[2] });
+		globalMesh.visit_neigbour(l, [&](UINT n) { result.neighbours.push_back(globalMesh.outerLabel(n)); });
+		result.neighbourStart.push_back(result.neighbours.size());
+		result.values.push_back(globalField.data()[l]);
+	}
+
+	const field<double>::BoundaryMesh& globalBoundary = globalField.boundary();
+	globalBoundary.visitBoundaries([&](const std::string& name)
+	{
+		Patch patch;
+		patch.name = name;
+		switch (globalBoundary.boundaryType(name))
+		{
+		case field<double>::BoundaryMesh::FIXED_VAL: patch.type = FIXED_VAL; break;
+		case field<double>::BoundaryMesh::MIRROR: patch.type = MIRROR; break;
+		default: patch.type = ZERO_GRAD;
+		}
+		for (UINT l : globalBoundary.boundaryLabels(name))
+		{
+			if (index[l] == static_cast<UINT>(-1)) continue;
+			patch.nodes.push_back(index[l]);
+			const field<double>::vector3f n = globalBoundary.normal(l);
+			patch.normals.push_back(V3D{ n[0], n[1], n[2] });
+		}
+		if (!patch.nodes.empty()) result.patches.push_back(std::move(patch));
+	});
+	return result;
+}
+
+void DistributedFieldImplementation::iterate(size_t nIterations)
+{
+	for (size_t i = 0; i < nIterations; ++i) m_pOperator->applyToField(m_data);
+}
+
+void DistributedFieldImplementation::iterateChebyshev(size_t nIterations, double rho)
+{
+	m_pOperator->chebyshev(m_data, nIterations, rho);
+}
+
+const std::vector<UINT>& DistributedFieldImplementation::ownedLabels() const
+{
+	return m_ownedLabels;
+}
+
+std::vector<double> DistributedFieldImplementation::ownedValues() const
+{
+	return std::vector<double>(m_data.begin(), m_data.begin() + m_localMesh.nOwned);
+}
+
+void DistributedFieldImplementation::gather(PotentialField * f) const
+{
+	field<double>& target = *dynamic_cast<PotentialFieldImplementation*>(f);
+	std::vector<double>& values = target.data();
+	for (size_t i = 0; i < m_localMesh.nOwned; ++i)
+	{
+		if (m_localMesh.globalLabels[i] >= target.size())
+			throw std::runtime_error("DistributedFieldImplementation::gather: Node label is out of the field.");
+		values[target.mesh().innerLabel(m_localMesh.globalLabels[i])] = m_data[i];
+	}
+	target.touch_values();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef _DISTRIBUTED_FIELD_IMPLEMENTATION_H_
+#define _DISTRIBUTED_FIELD_IMPLEMENTATION_H_ 1
+
+#include <memory>
+
+#include "..\LSExport.h"
+#include "..\mesh_math\distributedOperator.h"
+
+class DistributedFieldImplementation : public DistributedField
+{
+	using local_mesh_type = local_mesh<double, UINT>;
+	using distributed_operator = DistributedOperator<double, Transport>;
+
+	local_mesh_type m_localMesh;
+	std::unique_ptr<distributed_operator> m_pOperator;
+	std::vector<double> m_data; //Values of owned and ghost nodes
+	std::vector<UINT> m_ownedLabels; //Global labels of owned nodes
+public:
+	DistributedFieldImplementation(const Part& part, Transport* t, UINT ghostLayers);
+
+	//Nodes of the part of a field owned by the process rank
+	static Part split(const field<double>& globalField, int rank, int nRanks);
+
+	void iterate(size_t nIterations);
+
+	void iterateChebyshev(size_t nIterations, double rho);
+
+	const std::vector<UINT>& ownedLabels() const;
+
+	std::vector<double> ownedValues() const;
+
+	void gather(PotentialField* f) const;
+};
+
+#endif // !_DISTRIBUTED_FIELD_IMPLEMENTATION_H_
@@ -0,0 +1,171 @@
+#include "ExecutorImplementation.h"
+
+#include <algorithm>
+
+namespace
+{
+	//Pool and queue of the current thread if it is a worker
+	thread_local const WorkStealingExecutor* t_pPool = nullptr;
+	thread_local size_t t_queue = 0;
+}
+
+WorkStealingExecutor::WorkStealingExecutor(size_t nThreads)
+	:
+	m_nTasks(0),
+	m_bStop(false)
+{
+	if (nThreads == 0) nThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < nThreads; ++i) m_queues.emplace_back(new Queue);
+	for (size_t i = 0; i + 1 < nThreads; ++i) m_threads.emplace_back(&WorkStealingExecutor::work, this, i);
+}
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bStop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& t : m_threads) t.join();
+}
+
+void WorkStealingExecutor::push(size_t queue, const Task & task)
+{
+	++m_nTasks;
+	{
+		std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+		m_queues[queue]->tasks.push_back(task);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+bool WorkStealingExecutor::pop(size_t queue, Task & task)
+{
+	std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+	if (m_queues[queue]->tasks.empty()) return false;
+	task = m_queues[queue]->tasks.back();
+	m_queues[queue]->tasks.pop_back();
+	--m_nTasks;
+	return true;
+}
+
+bool WorkStealingExecutor::steal(size_t thief, Task & task)
+{
+	for (size_t k = 1; k < m_queues.size(); ++k)
+	{
+		Queue& victim = *m_queues[(thief + k) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) continue;
+		task = victim.tasks.front();
+		victim.tasks.pop_front();
+		--m_nTasks;
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingExecutor::execute(size_t queue, Task task)
+{
+	Job& job = *task.pJob;
+	//The second half is left for the owner of the queue or for thieves
+	while (task.end - task.begin > job.grain)
+	{
+		const size_t middle = task.begin + (task.end - task.begin) / 2;
+		push(queue, Task{ task.pJob, middle, task.end });
+		task.end = middle;
+	}
+	try
+	{
+		(*job.pBody)(task.begin, task.end);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(job.errorMutex);
+		if (!job.error) job.error = std::current_exception();
+	}
+	//The job can be destroyed by its caller as soon as nothing remains
+	if (job.remaining.fetch_sub(task.end - task.begin) == task.end - task.begin)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wake.notify_all();
+	}
+}
+
+void WorkStealingExecutor::work(size_t queue)
+{
+	t_pPool = this;
+	t_queue = queue;
+	for (;;)
+	{
+		Task task;
+		if (pop(queue, task) || steal(queue, task))
+		{
+			execute(queue, task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this]() { return m_bStop || m_nTasks != 0; });
+		if (m_bStop) return;
+	}
+}
+
+void WorkStealingExecutor::parallelFor(size_t begin, size_t end, size_t grain, const RangeBody & body)
+{
+	if (begin >= end) return;
+	if (grain == 0) grain = std::max<size_t>(1, (end - begin) / (8 * m_queues.size()));
+	if (m_threads.empty() || end - begin <= grain)
+	{
+		body(begin, end);
+		return;
+	}
+
+	Job job;
+	job.pBody = &body;
+	job.grain = grain;
+	job.remaining = end - begin;
+	const size_t queue = t_pPool == this ? t_queue : m_queues.size() - 1;
+	push(queue, Task{ &job, begin, end });
+
+	//The waiting thread helps with any tasks of the pool
+	while (job.remaining != 0)
+	{
+		Task task;
+		if (pop(queue, task) || steal(queue, task))
+		{
+			execute(queue, task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [&]() { return job.remaining == 0 || m_nTasks != 0; });
+	}
+	if (job.error) std::rethrow_exception(job.error);
+}
+
+size_t WorkStealingExecutor::concurrency() const
+{
+	return m_queues.size();
+}
+
+void SerialExecutor::parallelFor(size_t begin, size_t end, size_t, const RangeBody & body)
+{
+	if (begin < end) body(begin, end);
+}
+
+size_t SerialExecutor::concurrency() const
+{
+	return 1;
+}
+
+ParallelRunner runnerOf(Executor * executor)
+{
+	if (!executor) executor = Executor::shared();
+	return [executor](size_t begin, size_t end, size_t grain, const RangeBody& body)
+	{
+		executor->parallelFor(begin, end, grain, body);
+	};
+}
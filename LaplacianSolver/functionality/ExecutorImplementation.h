@@ -0,0 +1,86 @@
+#pragma once
+#ifndef _EXECUTOR_IMPLEMENTATION_H_
+#define _EXECUTOR_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "..\LSExport.h"
+#include "..\mesh_math\parallel.h"
+
+/**
+ * Pool of threads with a task queue for every thread. A loop is split in halves until the chunks reach the grain size,
+ * one half is kept in the own queue and idle threads steal the oldest (largest) halves from the other queues.
+ * The thread waiting for a loop runs its tasks too, so nested loops do not block the pool
+ */
+class WorkStealingExecutor : public Executor
+{
+	struct Job
+	{
+		const RangeBody* pBody;
+		size_t grain;
+		std::atomic<size_t> remaining; //Number of indices not processed yet
+		std::mutex errorMutex;
+		std::exception_ptr error;
+	};
+
+	struct Task
+	{
+		Job* pJob;
+		size_t begin, end;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	//Queues of the workers, the last one is shared by threads outside of the pool
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<size_t> m_nTasks;
+	bool m_bStop;
+
+	void push(size_t queue, const Task& task);
+
+	//Takes the newest task of the queue
+	bool pop(size_t queue, Task& task);
+
+	//Takes the oldest task of another queue
+	bool steal(size_t thief, Task& task);
+
+	void execute(size_t queue, Task task);
+
+	void work(size_t queue);
+public:
+	//nThreads counts the thread calling parallelFor, 0 means all hardware threads
+	WorkStealingExecutor(size_t nThreads);
+	~WorkStealingExecutor();
+
+	void parallelFor(size_t begin, size_t end, size_t grain, const RangeBody& body);
+
+	size_t concurrency() const;
+};
+
+//Runs loops in the calling thread
+class SerialExecutor : public Executor
+{
+public:
+	void parallelFor(size_t begin, size_t end, size_t grain, const RangeBody& body);
+
+	size_t concurrency() const;
+};
+
+//Runner of the math library loops using the executor, NULL means the shared pool
+ParallelRunner runnerOf(Executor* executor);
+
+#endif // !_EXECUTOR_IMPLEMENTATION_H_
@@ -0,0 +1,353 @@
+#include "FieldWriterImplementation.h"
+
+#include <cstring>
+#include <iomanip>
+
+#ifdef LS_USE_ZLIB
+#include <zlib.h>
+#endif // LS_USE_ZLIB
+
+//Arrays are written in the native byte order, which is little-endian on all supported platforms
+
+namespace
+{
+	//Makes a byte stream of nTuples tuples of tupleBytes bytes, tuple(i, out) writes the tuple i.
+	//Tuples are requested in ascending order, a tuple split between blocks is kept until the next call
+	template<typename tuple_writer>
+	std::function<size_t(char*, size_t)> tupleStream(size_t tupleBytes, size_t nTuples, tuple_writer tuple)
+	{
+		struct State
+		{
+			size_t next = 0;
+			std::vector<char> tail;
+			size_t tailPos = 0;
+		};
+		std::shared_ptr<State> s = std::make_shared<State>();
+		return [=](char* out, size_t maxBytes) mutable ->size_t
+		{
+			size_t done = 0;
+			while (done < maxBytes && s->tailPos < s->tail.size()) out[done++] = s->tail[s->tailPos++];
+			for (; done + tupleBytes <= maxBytes && s->next < nTuples; done += tupleBytes) tuple(s->next++, out + done);
+			if (done < maxBytes && s->next < nTuples)
+			{
+				s->tail.resize(tupleBytes);
+				tuple(s->next++, s->tail.data());
+				for (s->tailPos = 0; done < maxBytes; ) out[done++] = s->tail[s->tailPos++];
+			}
+			return done;
+		};
+	}
+
+	template<typename T>
+	void put(char* out, T val) { std::memcpy(out, &val, sizeof(T)); }
+
+	//Writes a number of fixed width, so it can be rewritten later
+	void putOffset(std::ostream& out, uint64_t val)
+	{
+		out << std::setw(20) << std::setfill('0') << val;
+	}
+}
+
+FieldWriterImplementation::FieldWriterImplementation(
+	const Mesh * m,
+	const std::string & fileName,
+	Format format,
+	bool compress)
+	:
+	m_pMesh(dynamic_cast<const MeshImplementation*>(m)->geometryPtr()),
+	m_pExecutor(dynamic_cast<const MeshImplementation*>(m)->executor()),
+	m_fileName(fileName),
+	m_format(format),
+	m_bCompress(compress),
+	m_bFinished(false)
+{
+	if (format != RAW && format != VTK)
+		throw std::runtime_error("FieldWriterImplementation::FieldWriterImplementation: Unsupported format.");
+#ifndef LS_USE_ZLIB
+	if (compress)
+		throw std::runtime_error("FieldWriterImplementation::FieldWriterImplementation: "
+			"Compression requires the library built with LS_USE_ZLIB.");
+#endif // !LS_USE_ZLIB
+}
+
+FieldWriterImplementation::~FieldWriterImplementation()
+{
+	if (m_thread.joinable()) m_thread.join();
+}
+
+void FieldWriterImplementation::addField(const std::string & name, const PotentialField * f)
+{
+	if (m_thread.joinable())
+		throw std::runtime_error("FieldWriterImplementation::addField: Writing has already started.");
+	std::shared_ptr<const Values> pValues = f->getPotentialSnapshot();
+	if (pValues->size() != m_pMesh->size())
+		throw std::runtime_error("FieldWriterImplementation::addField: Field and mesh sizes mismatch.");
+	m_fields.push_back(std::make_pair(name, pValues));
+}
+
+void FieldWriterImplementation::write()
+{
+	if (m_thread.joinable())
+		throw std::runtime_error("FieldWriterImplementation::write: Writing has already started.");
+	m_thread = std::thread(&FieldWriterImplementation::run, this);
+}
+
+bool FieldWriterImplementation::finished() const
+{
+	return m_bFinished;
+}
+
+void FieldWriterImplementation::wait()
+{
+	if (m_thread.joinable()) m_thread.join();
+	if (m_error) std::rethrow_exception(m_error);
+}
+
+void FieldWriterImplementation::run()
+{
+	try
+	{
+		if (m_format == RAW) writeRaw();
+		else writeVTK();
+	}
+	catch (...)
+	{
+		m_error = std::current_exception();
+	}
+	m_bFinished = true;
+}
+
+size_t FieldWriterImplementation::edgesNum() const
+{
+	size_t n = 0;
+	for (UINT l = 0; l < m_pMesh->size(); ++l)
+		m_pMesh->visit_neigbour(l, [&](UINT ll) { if (ll > l) ++n; });
+	return n;
+}
+
+FieldWriterImplementation::Array FieldWriterImplementation::positions() const
+{
+	std::shared_ptr<const mesh_geom> pMesh = m_pMesh;
+	return Array{ "positions", "Float64", 3, uint64_t(pMesh->size()) * 3 * sizeof(double),
+		tupleStream(3 * sizeof(double), pMesh->size(), [pMesh](size_t i, char* out)
+	{
+		const vector3f& r = pMesh->spacePositionOf(pMesh->innerLabel(static_cast<UINT>(i)));
+		for (int k = 0; k < 3; ++k) put<double>(out + k * sizeof(double), r[k]);
+	}) };
+}
+
+FieldWriterImplementation::Array FieldWriterImplementation::edges() const
+{
+	//Edges are listed in ascending order of mesh labels, tuples come one after another
+	struct Cursor
+	{
+		UINT l = 0;
+		std::vector<UINT> neighbours;
+		size_t pos = 0;
+	};
+	std::shared_ptr<const mesh_geom> pMesh = m_pMesh;
+	std::shared_ptr<Cursor> c = std::make_shared<Cursor>();
+	const size_t nEdges = edgesNum();
+	return Array{ "edges", "Int32", 2, uint64_t(nEdges) * 2 * sizeof(UINT),
+		tupleStream(2 * sizeof(UINT), nEdges, [pMesh, c](size_t, char* out)
+	{
+		while (c->pos == c->neighbours.size())
+		{
+			c->neighbours.clear();
+			c->pos = 0;
+			pMesh->visit_neigbour(c->l, [&](UINT ll) { if (ll > c->l) c->neighbours.push_back(ll); });
+			if (c->neighbours.empty()) ++c->l;
+		}
+		put<UINT>(out, pMesh->outerLabel(c->l));
+		put<UINT>(out + sizeof(UINT), pMesh->outerLabel(c->neighbours[c->pos++]));
+		if (c->pos == c->neighbours.size())
+		{
+			c->neighbours.clear();
+			c->pos = 0;
+			++c->l;
+		}
+	}) };
+}
+
+FieldWriterImplementation::Array FieldWriterImplementation::field(size_t i) const
+{
+	std::shared_ptr<const Values> pValues = m_fields[i].second;
+	return Array{ m_fields[i].first, "Float64", 1, uint64_t(pValues->size()) * sizeof(double),
+		tupleStream(sizeof(double), pValues->size(), [pValues](size_t i, char* out)
+	{
+		put<double>(out, (*pValues)[i]);
+	}) };
+}
+
+uint64_t FieldWriterImplementation::writeArray(std::ofstream & out, Array & a, bool sizePrefix) const
+{
+	uint64_t written = 0;
+	if (!m_bCompress)
+	{
+		if (sizePrefix)
+		{
+			out.write(reinterpret_cast<const char*>(&a.bytes), sizeof(a.bytes));
+			written += sizeof(a.bytes);
+		}
+		std::vector<char> block(s_blockSize);
+		for (size_t n; (n = a.next(block.data(), block.size())) != 0; written += n) out.write(block.data(), n);
+		return written;
+	}
+#ifdef LS_USE_ZLIB
+	//Layout of vtkZLibDataCompressor: number of blocks, block size, size of the last partial block (0 if it is full),
+	//compressed sizes of the blocks and then the compressed blocks
+	const uint64_t nBlocks = (a.bytes + s_blockSize - 1) / s_blockSize;
+	std::vector<uint64_t> header(3 + nBlocks, 0);
+	header[0] = nBlocks;
+	header[1] = s_blockSize;
+	header[2] = a.bytes % s_blockSize;
+	const std::streampos headerPos = out.tellp();
+	out.write(reinterpret_cast<const char*>(header.data()), header.size() * sizeof(uint64_t));
+	written += header.size() * sizeof(uint64_t);
+
+	//Blocks are compressed in parallel by batches and written in their order
+	const size_t nBatch = 2 * m_pExecutor->concurrency();
+	std::vector<std::vector<char>> raw(nBatch, std::vector<char>(s_blockSize));
+	std::vector<std::vector<char>> packed(nBatch, std::vector<char>(compressBound(s_blockSize)));
+	std::vector<size_t> rawSize(nBatch);
+	std::vector<uLongf> packedSize(nBatch);
+	for (uint64_t block = 0; block < nBlocks; block += nBatch)
+	{
+		const size_t n = static_cast<size_t>(std::min<uint64_t>(nBatch, nBlocks - block));
+		for (size_t i = 0; i < n; ++i) rawSize[i] = a.next(raw[i].data(), s_blockSize);
+		m_pExecutor->parallelFor(0, n, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				packedSize[i] = static_cast<uLongf>(packed[i].size());
+				if (compress2(reinterpret_cast<Bytef*>(packed[i].data()), &packedSize[i],
+					reinterpret_cast<const Bytef*>(raw[i].data()), static_cast<uLong>(rawSize[i]), Z_DEFAULT_COMPRESSION) != Z_OK)
+					throw std::runtime_error("FieldWriterImplementation::writeArray: Compression failed.");
+			}
+		});
+		for (size_t i = 0; i < n; ++i)
+		{
+			out.write(packed[i].data(), packedSize[i]);
+			header[3 + block + i] = packedSize[i];
+			written += packedSize[i];
+		}
+	}
+
+	const std::streampos endPos = out.tellp();
+	out.seekp(headerPos);
+	out.write(reinterpret_cast<const char*>(header.data()), header.size() * sizeof(uint64_t));
+	out.seekp(endPos);
+	return written;
+#else
+	throw std::runtime_error("FieldWriterImplementation::writeArray: "
+		"Compression requires the library built with LS_USE_ZLIB.");
+#endif // LS_USE_ZLIB
+}
+
+void FieldWriterImplementation::writeRaw() const
+{
+	std::ofstream out(m_fileName, std::ios::binary);
+	if (!out) throw std::runtime_error("FieldWriterImplementation::writeRaw: Cannot open file " + m_fileName + ".");
+
+	std::vector<Array> arrays{ positions(), edges() };
+	for (size_t i = 0; i < m_fields.size(); ++i) arrays.push_back(field(i));
+
+	std::vector<std::pair<uint64_t, uint64_t>> stored; //offsets and sizes of the arrays in the file
+	uint64_t offset = 0;
+	for (Array& a : arrays)
+	{
+		uint64_t bytes = writeArray(out, a, false);
+		stored.push_back(std::make_pair(offset, bytes));
+		offset += bytes;
+	}
+	out.close();
+	if (!out) throw std::runtime_error("FieldWriterImplementation::writeRaw: Cannot write file " + m_fileName + ".");
+
+	//Header describing the arrays
+	std::ofstream header(m_fileName + ".json");
+	header << "{\n"
+		<< "  \"byteOrder\": \"LittleEndian\",\n"
+		<< "  \"compression\": \"" << (m_bCompress ? "vtkZLibDataCompressor" : "none") << "\",\n"
+		<< "  \"nodes\": " << m_pMesh->size() << ",\n"
+		<< "  \"arrays\": [";
+	for (size_t i = 0; i < arrays.size(); ++i)
+	{
+		header << (i ? ",\n" : "\n")
+			<< "    { \"name\": \"" << arrays[i].name << "\", \"type\": \"" << arrays[i].type
+			<< "\", \"components\": " << arrays[i].components
+			<< ", \"bytes\": " << arrays[i].bytes
+			<< ", \"offset\": " << stored[i].first
+			<< ", \"storedBytes\": " << stored[i].second << " }";
+	}
+	header << "\n  ]\n}\n";
+	if (!header) throw std::runtime_error("FieldWriterImplementation::writeRaw: Cannot write file " + m_fileName + ".json.");
+}
+
+void FieldWriterImplementation::writeVTK() const
+{
+	std::ofstream out(m_fileName, std::ios::binary);
+	if (!out) throw std::runtime_error("FieldWriterImplementation::writeVTK: Cannot open file " + m_fileName + ".");
+
+	//Mesh edges are written as line cells
+	const size_t nNodes = m_pMesh->size(), nEdges = edgesNum();
+	std::vector<Array> arrays;
+	for (size_t i = 0; i < m_fields.size(); ++i) arrays.push_back(field(i));
+	arrays.push_back(positions());
+	arrays.push_back(edges());
+	arrays.back().name = "connectivity";
+	arrays.push_back(Array{ "offsets", "Int64", 1, uint64_t(nEdges) * sizeof(int64_t),
+		tupleStream(sizeof(int64_t), nEdges, [](size_t i, char* out) { put<int64_t>(out, 2 * int64_t(i) + 2); }) });
+	arrays.push_back(Array{ "types", "UInt8", 1, uint64_t(nEdges),
+		tupleStream(1, nEdges, [](size_t, char* out) { put<uint8_t>(out, 3); }) }); //VTK_LINE
+
+	//Offsets of the arrays in the appended data are written when they are known
+	std::vector<std::streampos> offsetPos;
+	auto dataArray = [&](const Array& a, const std::string& indent, bool bName)
+	{
+		out << indent << "<DataArray type=\"" << a.type << "\"";
+		if (bName) out << " Name=\"" << a.name << "\"";
+		if (a.components != 1 && a.name != "connectivity") out << " NumberOfComponents=\"" << a.components << "\"";
+		out << " format=\"appended\" offset=\"";
+		offsetPos.push_back(out.tellp());
+		putOffset(out, 0);
+		out << "\"/>\n";
+	};
+
+	out << "<?xml version=\"1.0\"?>\n"
+		<< "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\""
+		<< (m_bCompress ? " compressor=\"vtkZLibDataCompressor\"" : "") << ">\n"
+		<< "  <UnstructuredGrid>\n"
+		<< "    <Piece NumberOfPoints=\"" << nNodes << "\" NumberOfCells=\"" << nEdges << "\">\n"
+		<< "      <PointData>\n";
+	size_t i = 0;
+	for (; i < m_fields.size(); ++i) dataArray(arrays[i], "        ", true);
+	out << "      </PointData>\n"
+		<< "      <Points>\n";
+	dataArray(arrays[i++], "        ", false);
+	out << "      </Points>\n"
+		<< "      <Cells>\n";
+	for (; i < arrays.size(); ++i) dataArray(arrays[i], "        ", true);
+	out << "      </Cells>\n"
+		<< "    </Piece>\n"
+		<< "  </UnstructuredGrid>\n"
+		<< "  <AppendedData encoding=\"raw\">\n"
+		<< "   _";
+
+	std::vector<uint64_t> offsets;
+	uint64_t offset = 0;
+	for (Array& a : arrays)
+	{
+		offsets.push_back(offset);
+		offset += writeArray(out, a, true);
+	}
+	out << "\n  </AppendedData>\n"
+		<< "</VTKFile>\n";
+
+	for (size_t k = 0; k < offsets.size(); ++k)
+	{
+		out.seekp(offsetPos[k]);
+		putOffset(out, offsets[k]);
+	}
+	out.close();
+	if (!out) throw std::runtime_error("FieldWriterImplementation::writeVTK: Cannot write file " + m_fileName + ".");
+}
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef _FIELD_WRITER_IMPLEMENTATION_H_
+#define _FIELD_WRITER_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "..\LSExport.h"
+#include "MeshImplementation.h"
+
+//Writes mesh and node fields in binary formats, arrays are streamed to a file block by block
+class FieldWriterImplementation : public FieldWriter
+{
+	using Values = std::vector<double>;
+
+	//Array produced block by block, next(out, maxBytes) puts the following bytes to out and returns their number
+	struct Array
+	{
+		std::string name;
+		std::string type; //VTK type name
+		size_t components;
+		uint64_t bytes;
+		std::function<size_t(char*, size_t)> next;
+	};
+
+	//Size of uncompressed blocks
+	static const size_t s_blockSize = 1 << 20;
+
+	std::shared_ptr<const mesh_geom> m_pMesh;
+	Executor* m_pExecutor; //Compresses blocks
+	std::string m_fileName;
+	Format m_format;
+	bool m_bCompress;
+	std::vector<std::pair<std::string, std::shared_ptr<const Values>>> m_fields;
+
+	std::thread m_thread;
+	std::atomic<bool> m_bFinished;
+	std::exception_ptr m_error;
+
+	//Number of mesh edges
+	size_t edgesNum() const;
+
+	Array positions() const;
+	Array edges() const;
+	Array field(size_t i) const;
+
+	//Writes an array and returns the number of written bytes
+	//sizePrefix puts the data size before uncompressed data as VTK appended data requires
+	uint64_t writeArray(std::ofstream& out, Array& a, bool sizePrefix) const;
+
+	void writeRaw() const;
+	void writeVTK() const;
+	void run();
+public:
+	FieldWriterImplementation(const Mesh* m, const std::string& fileName, Format format, bool compress);
+
+	//Waits for the writing thread
+	~FieldWriterImplementation();
+
+	void addField(const std::string& name, const PotentialField* f);
+
+	void write();
+
+	bool finished() const;
+
+	void wait();
+};
+
+#endif // !_FIELD_WRITER_IMPLEMENTATION_H_
@@ -34,3 +34,78 @@ void GraphImplementation::addHexa(UINT n0, UINT n1, UINT n2, UINT n3, UINT n4, U
 {
 	base_graph::addHexa({ n0, n1, n2, n3, n4, n5, n6, n7 });
 }
+
+namespace
+{
+	//Nodes and edges of the element types in the order of Graph::ElementType
+	const size_t s_elementNodes[] = { 2, 3, 4, 4, 5, 6, 8 };
+	const size_t s_elementEdges[] = { 1, 3, 4, 6, 8, 9, 12 };
+	const unsigned char s_edgeNodes[][12][2] =
+	{
+		{ { 0, 1 } },
+		{ { 0, 1 }, { 1, 2 }, { 2, 0 } },
+		{ { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 } },
+		{ { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } },
+		{ { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 0, 4 }, { 1, 4 }, { 2, 4 }, { 3, 4 } },
+		{ { 0, 1 }, { 1, 2 }, { 2, 0 }, { 3, 4 }, { 4, 5 }, { 5, 3 }, { 0, 3 }, { 1, 4 }, { 2, 5 } },
+		{ { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } }
+	};
+}
+
+void GraphImplementation::addElements(ElementType type, const UINT * nodes, size_t nElements)
+{
+	if (type < EDGE || type > HEXA)
+		throw std::runtime_error("GraphImplementation::addElements: Unsupported element type.");
+	m_elements[type].insert(m_elements[type].end(), nodes, nodes + nElements * s_elementNodes[type]);
+}
+
+boundary_surface<UINT>::volume_elements GraphImplementation::volumeElements() const
+{
+	using surface = boundary_surface<UINT>;
+	surface::volume_elements elements;
+	elements.lists[surface::TET] = &m_elements[TET];
+	elements.lists[surface::PYR] = &m_elements[PYR];
+	elements.lists[surface::WEDGE] = &m_elements[WEDGE];
+	elements.lists[surface::HEXA] = &m_elements[HEXA];
+	return elements;
+}
+
+adjacency<UINT> GraphImplementation::connectivity(size_t nNodes, const ParallelRunner& run) const
+{
+	LS_PROFILE_SCOPE("GraphImplementation::connectivity");
+	using graph = adjacency<UINT>;
+
+	//Every element writes its edges to its own place, so they are generated without synchronization
+	size_t offsets[HEXA + 2] = { 0 };
+	for (int type = EDGE; type <= HEXA; ++type)
+		offsets[type + 1] = offsets[type] + m_elements[type].size() / s_elementNodes[type] * s_elementEdges[type];
+	std::vector<graph::edge_key> edges(offsets[HEXA + 1]);
+	for (int type = EDGE; type <= HEXA; ++type)
+	{
+		const UINT* nodes = m_elements[type].data();
+		graph::edge_key* out = edges.data() + offsets[type];
+		parallelFor(run, 0, m_elements[type].size() / s_elementNodes[type], [&](size_t begin, size_t end)
+		{
+			for (size_t e = begin; e < end; ++e)
+			{
+				const UINT* element = nodes + e * s_elementNodes[type];
+				for (size_t k = 0; k < s_elementEdges[type]; ++k)
+					out[e * s_elementEdges[type] + k] = graph::key(element[s_edgeNodes[type][k][0]], element[s_edgeNodes[type][k][1]]);
+			}
+		}, 1 << 14);
+	}
+
+	//Edges added one by one are already unique
+	edges.reserve(edges.size() + base_graph::connectionsNum());
+	base_graph::iterateOverUniqueConnections([&](size_t i, size_t j)
+	{
+		edges.push_back(graph::key(static_cast<UINT>(i), static_cast<UINT>(j)));
+	});
+	return graph::fromEdges(edges, nNodes, run);
+}
+
+void GraphImplementation::clear()
+{
+	static_cast<base_graph&>(*this) = base_graph();
+	for (std::vector<UINT>& elements : m_elements) std::vector<UINT>().swap(elements);
+}
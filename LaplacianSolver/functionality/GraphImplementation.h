@@ -4,10 +4,15 @@
 
 #include <data_structs\graph.h>
 #include "..\LSExport.h"
+#include "..\mesh_math\adjacency.h"
+#include "..\mesh_math\boundarySurface.h"
 
 class GraphImplementation : public Graph, public data_structs::graph<uint32_t>
 {
 	using base_graph = data_structs::graph<uint32_t>;
+
+	//Nodes of the elements added by addElements for every element type
+	std::vector<UINT> m_elements[HEXA + 1];
 public:
 	void addEdge(UINT n0, UINT n1);
 
@@ -22,6 +27,20 @@ public:
 	void addWedge(UINT n0, UINT n1, UINT n2, UINT n3, UINT n4, UINT n5);
 
 	void addHexa(UINT n0, UINT n1, UINT n2, UINT n3, UINT n4, UINT n5, UINT n6, UINT n7);
+
+	void addElements(ElementType type, const UINT* nodes, size_t nElements);
+
+	//Volume elements for the extraction of the exterior surface, they are valid until clear()
+	boundary_surface<UINT>::volume_elements volumeElements() const;
+
+	/**
+	 * Builds compact connectivity of nNodes nodes from all added edges and elements,
+	 * edges of the elements added by addElements are generated by the threads of the runner
+	 */
+	adjacency<UINT> connectivity(size_t nNodes, const ParallelRunner& run) const;
+
+	//Removes all edges and elements and frees their memory
+	void clear();
 };
 
 #endif // !_GRAPH_IMPLEMENTATION_H_
@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // !_WIN32
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string & fileName)
+	:
+	m_pData(nullptr),
+	m_size(0),
+	m_hMapping(NULL)
+{
+	m_hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("MappedFile::MappedFile: Cannot open file " + fileName + ".");
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_hFile, &size);
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0) return;
+
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping != NULL) m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		if (m_hMapping != NULL) CloseHandle(m_hMapping);
+		CloseHandle(m_hFile);
+		throw std::runtime_error("MappedFile::MappedFile: Cannot map file " + fileName + ".");
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_hMapping != NULL) CloseHandle(m_hMapping);
+	CloseHandle(m_hFile);
+}
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const
+{
+	offset = std::min(offset, m_size);
+	bytes = std::min(bytes, m_size - offset);
+	if (bytes == 0) return;
+#if _WIN32_WINNT >= 0x0602
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<char*>(m_pData + offset);
+	range.NumberOfBytes = bytes;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif // _WIN32_WINNT >= 0x0602
+}
+
+void MappedFile::release(size_t offset, size_t bytes) const
+{
+	offset = std::min(offset, m_size);
+	bytes = std::min(bytes, m_size - offset);
+	if (bytes == 0) return;
+	//Unlocking pages which are not locked removes them from the working set
+	VirtualUnlock(const_cast<char*>(m_pData + offset), bytes);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string & fileName)
+	:
+	m_pData(nullptr),
+	m_size(0)
+{
+	m_fd = open(fileName.c_str(), O_RDONLY);
+	if (m_fd < 0) throw std::runtime_error("MappedFile::MappedFile: Cannot open file " + fileName + ".");
+	struct stat st;
+	fstat(m_fd, &st);
+	m_size = static_cast<size_t>(st.st_size);
+	if (m_size == 0) return;
+
+	void* p = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (p == MAP_FAILED)
+	{
+		close(m_fd);
+		throw std::runtime_error("MappedFile::MappedFile: Cannot map file " + fileName + ".");
+	}
+	m_pData = static_cast<const char*>(p);
+	madvise(p, m_size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData) munmap(const_cast<char*>(m_pData), m_size);
+	close(m_fd);
+}
+
+namespace
+{
+	//Extends a range of a mapping to whole pages
+	void pageRange(size_t size, size_t& offset, size_t& bytes)
+	{
+		const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		size_t end = std::min(offset + bytes, size);
+		offset = std::min(offset, size) / page * page;
+		bytes = end > offset ? end - offset : 0;
+	}
+}
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const
+{
+	pageRange(m_size, offset, bytes);
+	if (bytes) madvise(const_cast<char*>(m_pData + offset), bytes, MADV_WILLNEED);
+}
+
+void MappedFile::release(size_t offset, size_t bytes) const
+{
+	pageRange(m_size, offset, bytes);
+	if (bytes) madvise(const_cast<char*>(m_pData + offset), bytes, MADV_DONTNEED);
+}
+
+#endif // _WIN32
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_ 1
+
+#include <string>
+
+#include "..\ls_main.h"
+
+//Read only view of a whole file in memory, pages are read by the system on the first access
+class MappedFile
+{
+	const char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#else
+	int m_fd;
+#endif // _WIN32
+public:
+	MappedFile(const std::string& fileName);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	size_t size() const { return m_size; }
+
+	template<typename T>
+	const T* data() const { return reinterpret_cast<const T*>(m_pData); }
+
+	//Asks the system to read a range of bytes ahead of its use
+	void prefetch(size_t offset, size_t bytes) const;
+
+	//Allows the system to drop a range of bytes from memory, it is read again on the next access
+	void release(size_t offset, size_t bytes) const;
+};
+
+#endif // !_MAPPED_FILE_H_
@@ -1,14 +1,94 @@
 #include "MeshImplementation.h"
+#include "..\mesh_math\nodeOrdering.h"
+#include "ExecutorImplementation.h"
+#include "MappedFile.h"
 
-MeshImplementation::MeshImplementation(const graph& g, const node_positions& np)
-	: Mesh(), _geometry(new mesh_geom(g, np))
-{}
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+	//Node positions in a memory mapped file, the file is removed with the last geometry using it
+	class MappedPositions
+	{
+		std::string m_fileName;
+		std::unique_ptr<MappedFile> m_pFile;
+	public:
+		MappedPositions(const std::string& fileName, const mesh_geom::position_array& positions)
+			: m_fileName(fileName)
+		{
+			{
+				std::ofstream out(fileName, std::ios::binary);
+				out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(vector3f));
+				out.close();
+				if (!out) throw std::runtime_error("MeshImplementation::mapPositions: Cannot write file " + fileName + ".");
+			}
+			m_pFile.reset(new MappedFile(fileName));
+		}
+
+		~MappedPositions()
+		{
+			m_pFile.reset();
+			std::remove(m_fileName.c_str());
+		}
+
+		const vector3f* data() const { return m_pFile->data<vector3f>(); }
+	};
+}
+
+MeshImplementation::MeshImplementation(graph g, node_positions np, NodeOrdering ordering, Executor* executor,
+	const surface::volume_elements* pElements)
+	: Mesh(), _geometry(new mesh_geom(std::move(g), std::move(np))), m_pExecutor(executor ? executor : Executor::shared()),
+	m_pSurface(new surface)
+{
+	std::vector<UINT> order;
+	switch (ordering)
+	{
+	case NATURAL: break;
+	case RCM: order = reverseCuthillMcKee(_geometry->connectivity()); break;
+	case MORTON: order = mortonOrder<UINT>(_geometry->positions(), runnerOf(m_pExecutor)); break;
+	default: throw std::runtime_error("MeshImplementation::MeshImplementation:"
+										 " Unsupported node ordering.");
+	}
+	if (!order.empty())
+	{
+		isolatedNodesFirst(order, _geometry->connectivity());
+		_geometry->renumber(order);
+	}
+	if (pElements)
+	{
+		const mesh_geom& geometry = *_geometry;
+		m_pSurface = std::make_shared<const surface>(surface::fromElements(*pElements, geometry.positions(),
+			[&geometry](UINT l) { return geometry.innerLabel(l); }, runnerOf(m_pExecutor)));
+	}
+}
+
+Executor * MeshImplementation::executor() const
+{
+	return m_pExecutor;
+}
+
+void MeshImplementation::mapPositions(const std::string & fileName)
+{
+	std::shared_ptr<const MappedPositions> pFile = std::make_shared<const MappedPositions>(fileName, _geometry->positions());
+	_geometry->set_positions(mesh_geom::position_array(pFile, pFile->data(), _geometry->size()));
+}
 
 std::shared_ptr<mesh_geom> MeshImplementation::geometryPtr()
 {
 	return _geometry;
 }
 
+std::shared_ptr<const mesh_geom> MeshImplementation::geometryPtr() const
+{
+	return _geometry;
+}
+
+std::shared_ptr<const surface> MeshImplementation::surfacePtr() const
+{
+	return m_pSurface;
+}
+
 std::pair<V3D, V3D> MeshImplementation::getBox() const
 {
 	mesh_geom::box3D box_ = _geometry->box();
@@ -18,3 +98,21 @@ std::pair<V3D, V3D> MeshImplementation::getBox() const
 	min.z = box_.first[2]; max.z = box_.second[2];
 	return std::make_pair(min, max);
 }
+
+void MeshImplementation::getExteriorFaces(std::vector<UINT>& faceNodes) const
+{
+	faceNodes.resize(4 * m_pSurface->size());
+	for (size_t i = 0; i < m_pSurface->size(); ++i)
+		for (size_t k = 0; k < 4; ++k) faceNodes[4 * i + k] = _geometry->outerLabel(m_pSurface->face(i)[k]);
+}
+
+void MeshImplementation::getExteriorNormals(std::vector<V3D>& normals) const
+{
+	normals.assign(_geometry->size(), V3D{ 0.0, 0.0, 0.0 });
+	if (m_pSurface->size() == 0) return;
+	for (UINT l = 0; l < normals.size(); ++l)
+	{
+		const vector3f& n = m_pSurface->normal(l);
+		normals[_geometry->outerLabel(l)] = V3D{ n[0], n[1], n[2] };
+	}
+}
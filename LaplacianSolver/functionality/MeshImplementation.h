@@ -6,22 +6,43 @@
 
 #include "..\LSExport.h"
 #include "..\mesh_math\mesh_geometry.h"
+#include "..\mesh_math\boundarySurface.h"
 
-using graph = data_structs::graph<UINT>;
+using mesh_geom = mesh_geometry<double, UINT>;
+using graph = mesh_geom::graph;
 using vector3f = math::vector_c<double, 3>;
 using node_positions = std::vector<vector3f>;
-using mesh_geom = mesh_geometry<double, UINT>;
+using surface = boundary_surface<UINT>;
 
 class MeshImplementation : public Mesh
 {
 	using basic_mesh_geometry = mesh_geom;
 	std::shared_ptr<mesh_geom> _geometry;
+	Executor* m_pExecutor;
+	std::shared_ptr<const surface> m_pSurface; //Exterior surface in mesh labels
 public:
-	MeshImplementation(const graph& g, const node_positions& np);
+	//Graph and node positions are moved into the mesh geometry, pass copies to keep them.
+	//NULL executor means the shared pool. The exterior surface is extracted from elements if they are given
+	MeshImplementation(graph g, node_positions np, NodeOrdering ordering = NATURAL, Executor* executor = NULL,
+		const surface::volume_elements* pElements = NULL);
+
+	//Executor of the mesh, fields and operators created on it use it by default
+	Executor* executor() const;
+
+	//Moves node positions to the memory mapped file, it is removed when the geometry is released by all its users
+	void mapPositions(const std::string& fileName);
 
 	std::shared_ptr<mesh_geom> geometryPtr();
+	std::shared_ptr<const mesh_geom> geometryPtr() const;
+
+	//Exterior surface of the volume elements, it is empty if the mesh was created without them
+	std::shared_ptr<const surface> surfacePtr() const;
 
 	std::pair<V3D, V3D> getBox() const;
+
+	void getExteriorFaces(std::vector<UINT>& faceNodes) const;
+
+	void getExteriorNormals(std::vector<V3D>& normals) const;
 };
 
 #endif // !_MESH_IMPLEMENTATION_H_
@@ -0,0 +1,144 @@
+#include "NumaOperatorImplementation.h"
+#include "fieldOperatorImplementation.h"
+
+#include <algorithm>
+
+NumaOperatorImplementation::NumaOperatorImplementation(const Field & field, 
+	ScalarFieldOperator::OperatorType type, bool largePages)
+	:
+	m_pPool(NumaPool::shared()),
+	m_size(field.size()),
+	m_result(field.size() * sizeof(double), largePages),
+	m_rho(-1.0)
+{
+	LS_PROFILE_SCOPE("NumaOperatorImplementation::assemble");
+	FieldLinearOp<double> assembler(field);
+	assembleOperator(assembler, type, "NumaOperatorImplementation::NumaOperatorImplementation");
+
+	//Every node gets rows with nearly the same number of matrix elements
+	const size_t nNodes = m_pPool->nodes();
+	m_parts.resize(nNodes);
+	size_t begin = 0;
+	for (size_t node = 0; node < nNodes; ++node)
+	{
+		Partition& part = m_parts[node];
+		const size_t target = assembler.nonZeros() * (node + 1) / nNodes;
+		size_t end = begin;
+		while (end < m_size && (node + 1 == nNodes || assembler.rowBegin(end) < target)) ++end;
+		part.begin = begin;
+		part.end = end;
+		part.nonZeros = assembler.rowBegin(end) - assembler.rowBegin(begin);
+		//Pages are only reserved here and placed by the first write from the threads of the node
+		part.rowStart = PageBuffer((end - begin + 1) * sizeof(size_t), largePages);
+		part.cols = PageBuffer(part.nonZeros * sizeof(uint32_t), largePages);
+		part.coefs = PageBuffer(part.nonZeros * sizeof(double), largePages);
+		begin = end;
+	}
+
+	m_pPool->run([&](size_t node, size_t thread, size_t nThreads)
+	{
+		const Partition& part = m_parts[node];
+		size_t rowsBegin, rowsEnd;
+		threadRows(part, thread, nThreads, rowsBegin, rowsEnd);
+		size_t* rowStart = part.rowStart.data<size_t>();
+		uint32_t* cols = part.cols.data<uint32_t>();
+		double* coefs = part.coefs.data<double>();
+		const size_t offset = assembler.rowBegin(part.begin);
+		for (size_t i = rowsBegin; i < rowsEnd; ++i)
+		{
+			size_t k = rowStart[i - part.begin] = assembler.rowBegin(i) - offset;
+			assembler.visitRow(static_cast<uint32_t>(i), [&](uint32_t col, double coef)
+			{
+				cols[k] = col;
+				coefs[k++] = coef;
+			});
+		}
+		if (thread + 1 == nThreads) rowStart[part.end - part.begin] = part.nonZeros;
+		std::fill(m_result.data<double>() + rowsBegin, m_result.data<double>() + rowsEnd, 0.0);
+	});
+}
+
+void NumaOperatorImplementation::threadRows(const Partition & part, size_t thread, size_t nThreads,
+	size_t & begin, size_t & end) const
+{
+	const size_t nRows = part.end - part.begin;
+	begin = part.begin + nRows * thread / nThreads;
+	end = part.begin + nRows * (thread + 1) / nThreads;
+}
+
+template<typename visitor>
+void NumaOperatorImplementation::product(const data_vector & x, visitor V) const
+{
+	LS_PROFILE_SCOPE("NumaOperatorImplementation::product");
+	m_pPool->run([&](size_t node, size_t thread, size_t nThreads)
+	{
+		const Partition& part = m_parts[node];
+		size_t begin, end;
+		threadRows(part, thread, nThreads, begin, end);
+		const size_t* rowStart = part.rowStart.data<size_t>() - part.begin;
+		const uint32_t* cols = part.cols.data<uint32_t>();
+		const double* coefs = part.coefs.data<double>();
+		for (size_t i = begin; i < end; ++i)
+		{
+			double val = 0.0;
+			for (size_t k = rowStart[i]; k < rowStart[i + 1]; ++k) val += x[cols[k]] * coefs[k];
+			V(i, val);
+		}
+	});
+}
+
+void NumaOperatorImplementation::applyToField(PotentialField * pField) const
+{
+	data_vector& x = operatorFieldData(pField, m_size, "NumaOperatorImplementation::applyToField");
+	//Node threads write their rows of the product to their own memory and then copy them to the field
+	std::lock_guard<std::mutex> lock(m_resultMutex);
+	double* result = m_result.data<double>();
+	product(x, [&](size_t i, double val) { result[i] = val; });
+	m_pPool->run([&](size_t node, size_t thread, size_t nThreads)
+	{
+		size_t begin, end;
+		threadRows(m_parts[node], thread, nThreads, begin, end);
+		std::copy(result + begin, result + end, x.begin() + begin);
+	});
+}
+
+size_t NumaOperatorImplementation::update(const PotentialField *)
+{
+	throw std::runtime_error("NumaOperatorImplementation::update: "
+		"NUMA operators are not updated, create a new one.");
+}
+
+size_t NumaOperatorImplementation::relax(PotentialField *, double, size_t) const
+{
+	throw std::runtime_error("NumaOperatorImplementation::relax: "
+		"Relaxation is serial and is not supported by NUMA operators.");
+}
+
+void NumaOperatorImplementation::applyChebyshev(PotentialField * pField, size_t nIterations) const
+{
+	data_vector& x = operatorFieldData(pField, m_size, "NumaOperatorImplementation::applyChebyshev");
+	chebyshevIteration(x, nIterations, spectralRadius(),
+		[this](const data_vector& x, auto V) { product(x, V); });
+}
+
+double NumaOperatorImplementation::spectralRadius() const
+{
+	double rho = m_rho;
+	if (rho >= 0.0) return rho;
+	m_rho = rho = powerIteration(m_size, 30,
+		[this](const std::vector<double>& v, auto V) { product(v, V); },
+		[this](size_t i)->bool
+	{
+		const Partition& part = *std::find_if(m_parts.begin(), m_parts.end(),
+			[i](const Partition& p) { return i < p.end; });
+		const size_t* rowStart = part.rowStart.data<size_t>() - part.begin;
+		const size_t k = rowStart[i];
+		return rowStart[i + 1] - k == 1 && part.cols.data<uint32_t>()[k] == i && part.coefs.data<double>()[k] == 1.0;
+	});
+	return rho;
+}
+
+void NumaOperatorImplementation::applyTiled(PotentialField * pField, size_t nIterations, size_t, size_t) const
+{
+	for (size_t i = 0; i < nIterations; ++i) applyToField(pField);
+}
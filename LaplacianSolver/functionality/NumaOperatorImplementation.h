@@ -0,0 +1,59 @@
+#pragma once
+#ifndef _NUMA_OPERATOR_IMPLEMENTATION_H_
+#define _NUMA_OPERATOR_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "..\LSExport.h"
+#include "..\mesh_math\fieldOperator.h"
+#include "NumaPool.h"
+
+/**
+ * Field operator with rows split between NUMA nodes
+ * Every node keeps its rows and its slice of the product in memory first touched by its own threads
+ * and only its threads multiply them. Operators share the pool of the process
+ */
+class NumaOperatorImplementation : public ScalarFieldOperator
+{
+	using Field = field<double>;
+	using data_vector = Field::data_vector;
+
+	//Rows [begin, end) of a node, rowStart is counted from the first element of the partition
+	struct Partition
+	{
+		size_t begin, end, nonZeros;
+		PageBuffer rowStart, cols, coefs;
+	};
+
+	std::shared_ptr<NumaPool> m_pPool;
+	std::vector<Partition> m_parts;
+	size_t m_size;
+	PageBuffer m_result; //Product of applyToField, rows of every node are placed in its memory
+	mutable std::mutex m_resultMutex;
+	mutable std::atomic<double> m_rho; //Negative until it is estimated
+
+	//Rows of the partition handled by one of its threads
+	void threadRows(const Partition& part, size_t thread, size_t nThreads, size_t& begin, size_t& end) const;
+
+	//Calls V(i, (Ax)_i) for every row i from the threads of the node owning the row
+	template<typename visitor>
+	void product(const data_vector& x, visitor V) const;
+public:
+	NumaOperatorImplementation(const Field& field, ScalarFieldOperator::OperatorType type, bool largePages);
+
+	void applyToField(PotentialField* field) const;
+
+	size_t update(const PotentialField* field);
+
+	size_t relax(PotentialField* field, double tolerance, size_t maxUpdates) const;
+
+	void applyChebyshev(PotentialField* field, size_t nIterations) const;
+
+	double spectralRadius() const;
+
+	void applyTiled(PotentialField* field, size_t nIterations, size_t depth, size_t cacheBytes) const;
+};
+
+#endif // !_NUMA_OPERATOR_IMPLEMENTATION_H_
@@ -0,0 +1,255 @@
+#include "NumaPool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif // !_WIN32
+
+#ifdef _WIN32
+
+std::vector<NumaNode> numaTopology()
+{
+	std::vector<NumaNode> nodes;
+	ULONG highest = 0;
+	if (GetNumaHighestNodeNumber(&highest))
+		for (ULONG id = 0; id <= highest; ++id)
+		{
+			NumaNode node{ static_cast<UINT>(id), 0, {} };
+#if _WIN32_WINNT >= 0x0601
+			GROUP_AFFINITY affinity;
+			if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(id), &affinity)) continue;
+			node.group = affinity.Group;
+			KAFFINITY mask = affinity.Mask;
+#else
+			ULONGLONG mask = 0;
+			if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(id), &mask)) continue;
+#endif // _WIN32_WINNT >= 0x0601
+			for (UINT p = 0; p < sizeof(mask) * 8; ++p)
+				if (mask >> p & 1) node.processors.push_back(p);
+			if (!node.processors.empty()) nodes.push_back(node);
+		}
+	if (nodes.empty())
+	{
+		nodes.push_back(NumaNode{ 0, 0, {} });
+		for (UINT p = 0; p < std::max(1u, std::thread::hardware_concurrency()); ++p) nodes[0].processors.push_back(p);
+	}
+	return nodes;
+}
+
+namespace
+{
+	void pinThread(std::thread& t, const NumaNode& node, UINT processor)
+	{
+#if _WIN32_WINNT >= 0x0601
+		GROUP_AFFINITY affinity = {};
+		affinity.Group = node.group;
+		affinity.Mask = KAFFINITY(1) << processor;
+		SetThreadGroupAffinity(t.native_handle(), &affinity, NULL);
+#else
+		SetThreadAffinityMask(t.native_handle(), DWORD_PTR(1) << processor);
+#endif // _WIN32_WINNT >= 0x0601
+	}
+}
+
+PageBuffer::PageBuffer(size_t bytes, bool largePages)
+	:
+	m_pData(nullptr),
+	m_bytes(bytes),
+	m_bLargePages(false)
+{
+	if (bytes == 0) return;
+	//Large pages need the "Lock pages in memory" privilege, ordinary pages are used without it
+	const SIZE_T largePage = largePages ? GetLargePageMinimum() : 0;
+	if (largePage != 0)
+	{
+		SIZE_T size = (bytes + largePage - 1) / largePage * largePage;
+		m_pData = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		m_bLargePages = m_pData != nullptr;
+	}
+	if (!m_pData) m_pData = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (!m_pData) throw std::bad_alloc();
+}
+
+PageBuffer::~PageBuffer()
+{
+	if (m_pData) VirtualFree(m_pData, 0, MEM_RELEASE);
+}
+
+#else
+
+std::vector<NumaNode> numaTopology()
+{
+	std::vector<NumaNode> nodes;
+	//Linux lists processors of every node in sysfs, for instance 0-7,16-23
+	for (UINT id = 0; ; ++id)
+	{
+		std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+		if (!in) break;
+		NumaNode node{ id, 0, {} };
+		std::string range;
+		while (std::getline(in, range, ','))
+		{
+			std::istringstream r(range);
+			UINT first = 0, last = 0;
+			char dash = 0;
+			if (!(r >> first)) continue;
+			if (!(r >> dash >> last)) last = first;
+			for (UINT p = first; p <= last; ++p) node.processors.push_back(p);
+		}
+		if (!node.processors.empty()) nodes.push_back(node);
+	}
+	if (nodes.empty())
+	{
+		nodes.push_back(NumaNode{ 0, 0, {} });
+		for (UINT p = 0; p < std::max(1u, std::thread::hardware_concurrency()); ++p) nodes[0].processors.push_back(p);
+	}
+	return nodes;
+}
+
+namespace
+{
+	void pinThread(std::thread& t, const NumaNode&, UINT processor)
+	{
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(processor, &set);
+		pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#endif // __linux__
+	}
+}
+
+PageBuffer::PageBuffer(size_t bytes, bool largePages)
+	:
+	m_pData(nullptr),
+	m_bytes(bytes),
+	m_bLargePages(false)
+{
+	if (bytes == 0) return;
+	void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) throw std::bad_alloc();
+	m_pData = p;
+#ifdef MADV_HUGEPAGE
+	if (largePages) m_bLargePages = madvise(p, bytes, MADV_HUGEPAGE) == 0;
+#endif // MADV_HUGEPAGE
+}
+
+PageBuffer::~PageBuffer()
+{
+	if (m_pData) munmap(m_pData, m_bytes);
+}
+
+#endif // _WIN32
+
+PageBuffer::PageBuffer(PageBuffer && other)
+	:
+	m_pData(other.m_pData),
+	m_bytes(other.m_bytes),
+	m_bLargePages(other.m_bLargePages)
+{
+	other.m_pData = nullptr;
+	other.m_bytes = 0;
+}
+
+PageBuffer & PageBuffer::operator=(PageBuffer && other)
+{
+	std::swap(m_pData, other.m_pData);
+	std::swap(m_bytes, other.m_bytes);
+	std::swap(m_bLargePages, other.m_bLargePages);
+	return *this;
+}
+
+NumaPool::NumaPool(size_t maxThreadsPerNode)
+	:
+	m_nodes(numaTopology()),
+	m_pTask(nullptr),
+	m_generation(0),
+	m_pending(0),
+	m_bStop(false)
+{
+	for (size_t node = 0; node < m_nodes.size(); ++node)
+	{
+		size_t nThreads = m_nodes[node].processors.size();
+		if (maxThreadsPerNode != 0) nThreads = std::min(nThreads, maxThreadsPerNode);
+		m_nodeThreads.push_back(nThreads);
+		for (size_t i = 0; i < nThreads; ++i) m_workers.push_back(Worker{ node, i, std::thread() });
+	}
+	for (size_t w = 0; w < m_workers.size(); ++w)
+	{
+		m_workers[w].thread = std::thread(&NumaPool::work, this, w);
+		pinThread(m_workers[w].thread, m_nodes[m_workers[w].node], m_nodes[m_workers[w].node].processors[m_workers[w].index]);
+	}
+}
+
+NumaPool::~NumaPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_start.notify_all();
+	for (Worker& w : m_workers) w.thread.join();
+}
+
+void NumaPool::work(size_t w)
+{
+	size_t generation = 0;
+	for (;;)
+	{
+		const Task* pTask;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&]() { return m_bStop || m_generation != generation; });
+			if (m_bStop) return;
+			generation = m_generation;
+			pTask = m_pTask;
+		}
+		const Worker& worker = m_workers[w];
+		try
+		{
+			(*pTask)(worker.node, worker.index, m_nodeThreads[worker.node]);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error) m_error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_pending == 0) m_done.notify_one();
+	}
+}
+
+void NumaPool::run(const Task & task)
+{
+	std::lock_guard<std::mutex> running(m_runMutex);
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_pTask = &task;
+	m_pending = m_workers.size();
+	m_error = nullptr;
+	++m_generation;
+	m_start.notify_all();
+	m_done.wait(lock, [&]() { return m_pending == 0; });
+	m_pTask = nullptr;
+	if (m_error) std::rethrow_exception(m_error);
+}
+
+std::shared_ptr<NumaPool> NumaPool::shared()
+{
+	static std::mutex mutex;
+	static std::weak_ptr<NumaPool> instance;
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<NumaPool> pool = instance.lock();
+	if (!pool)
+	{
+		pool = std::make_shared<NumaPool>();
+		instance = pool;
+	}
+	return pool;
+}
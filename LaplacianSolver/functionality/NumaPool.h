@@ -0,0 +1,99 @@
+#pragma once
+#ifndef _NUMA_POOL_H_
+#define _NUMA_POOL_H_ 1
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "..\ls_main.h"
+
+//Processors of one NUMA node
+struct NumaNode
+{
+	UINT id;
+	USHORT group; //processor group, it is used only on Windows
+	std::vector<UINT> processors;
+};
+
+//Lists NUMA nodes of the machine, a machine without NUMA information has one node with all processors
+std::vector<NumaNode> numaTopology();
+
+/**
+ * Memory pages allocated but not touched, so the pages are placed on the NUMA node of the thread writing them first
+ * Large pages are used if they are asked for and the system allows them
+ */
+class PageBuffer
+{
+	void* m_pData;
+	size_t m_bytes;
+	bool m_bLargePages;
+public:
+	PageBuffer() : m_pData(nullptr), m_bytes(0), m_bLargePages(false) {}
+	PageBuffer(size_t bytes, bool largePages);
+	~PageBuffer();
+
+	PageBuffer(const PageBuffer&) = delete;
+	PageBuffer& operator=(const PageBuffer&) = delete;
+	PageBuffer(PageBuffer&& other);
+	PageBuffer& operator=(PageBuffer&& other);
+
+	template<typename T>
+	T* data() const { return static_cast<T*>(m_pData); }
+
+	bool largePages() const { return m_bLargePages; }
+};
+
+/**
+ * Worker threads pinned to the processors of every NUMA node
+ */
+class NumaPool
+{
+public:
+	//task(node, thread, nThreads) runs on the thread of the node, nThreads is the number of threads of the node
+	using Task = std::function<void(size_t, size_t, size_t)>;
+
+private:
+	struct Worker
+	{
+		size_t node, index;
+		std::thread thread;
+	};
+
+	std::vector<NumaNode> m_nodes;
+	std::vector<size_t> m_nodeThreads;
+	std::vector<Worker> m_workers;
+
+	std::mutex m_mutex, m_runMutex;
+	std::condition_variable m_start, m_done;
+	const Task* m_pTask;
+	size_t m_generation, m_pending;
+	bool m_bStop;
+	std::exception_ptr m_error;
+
+	void work(size_t w);
+public:
+	//maxThreadsPerNode = 0 starts a thread for every processor
+	NumaPool(size_t maxThreadsPerNode = 0);
+	~NumaPool();
+
+	NumaPool(const NumaPool&) = delete;
+	NumaPool& operator=(const NumaPool&) = delete;
+
+	size_t nodes() const { return m_nodes.size(); }
+
+	size_t threads(size_t node) const { return m_nodeThreads[node]; }
+
+	//Runs the task on every worker and waits for all of them, the first exception of the task is rethrown.
+	//Tasks of several threads run one after another
+	void run(const Task& task);
+
+	//Pool of the process with a thread for every processor, it is created for the first user and stopped after the last one
+	static std::shared_ptr<NumaPool> shared();
+};
+
+#endif // !_NUMA_POOL_H_
@@ -0,0 +1,155 @@
+#include "OutOfCoreOperatorImplementation.h"
+#include "fieldOperatorImplementation.h"
+
+#include <cstdio>
+#include <fstream>
+
+OutOfCoreOperatorImplementation::OutOfCoreOperatorImplementation(const Field & field, const std::string & fileBase)
+	:
+	m_fileBase(fileBase),
+	m_size(field.size()),
+	m_rho(-1.0)
+{
+	LS_PROFILE_SCOPE("OutOfCoreOperatorImplementation::assemble");
+	{
+		//Rows are assembled one by one and appended to the files
+		std::ofstream rows(fileBase + ".rows", std::ios::binary), cols(fileBase + ".cols", std::ios::binary),
+			coefs(fileBase + ".coefs", std::ios::binary);
+		if (!rows || !cols || !coefs)
+			throw std::runtime_error("OutOfCoreOperatorImplementation::OutOfCoreOperatorImplementation: "
+				"Cannot create files " + fileBase + ".*");
+		FieldLinearOp<double> assembler(field);
+		FieldLinearOp<double>::MatrixRow row;
+		uint64_t nonZeros = 0;
+		rows.write(reinterpret_cast<const char*>(&nonZeros), sizeof(nonZeros));
+		for (uint32_t i = 0; i < m_size; ++i)
+		{
+			assembler.laplacianRow(i, row);
+			for (const FieldLinearOp<double>::MatrixElem& e : row)
+			{
+				cols.write(reinterpret_cast<const char*>(&e.first), sizeof(uint32_t));
+				coefs.write(reinterpret_cast<const char*>(&e.second), sizeof(double));
+			}
+			nonZeros += row.size();
+			rows.write(reinterpret_cast<const char*>(&nonZeros), sizeof(nonZeros));
+		}
+		rows.close();
+		cols.close();
+		coefs.close();
+		if (!rows || !cols || !coefs)
+			throw std::runtime_error("OutOfCoreOperatorImplementation::OutOfCoreOperatorImplementation: "
+				"Cannot write files " + fileBase + ".*");
+	}
+	m_pRows.reset(new MappedFile(fileBase + ".rows"));
+	m_pCols.reset(new MappedFile(fileBase + ".cols"));
+	m_pCoefs.reset(new MappedFile(fileBase + ".coefs"));
+}
+
+OutOfCoreOperatorImplementation::~OutOfCoreOperatorImplementation()
+{
+	m_pRows.reset();
+	m_pCols.reset();
+	m_pCoefs.reset();
+	std::remove((m_fileBase + ".rows").c_str());
+	std::remove((m_fileBase + ".cols").c_str());
+	std::remove((m_fileBase + ".coefs").c_str());
+}
+
+void OutOfCoreOperatorImplementation::prefetch(size_t begin, size_t end) const
+{
+	const uint64_t* rowStart = m_pRows->data<uint64_t>();
+	m_pRows->prefetch(begin * sizeof(uint64_t), (end - begin + 1) * sizeof(uint64_t));
+	m_pCols->prefetch(rowStart[begin] * sizeof(uint32_t), (rowStart[end] - rowStart[begin]) * sizeof(uint32_t));
+	m_pCoefs->prefetch(rowStart[begin] * sizeof(double), (rowStart[end] - rowStart[begin]) * sizeof(double));
+}
+
+void OutOfCoreOperatorImplementation::release(size_t begin, size_t end) const
+{
+	const uint64_t* rowStart = m_pRows->data<uint64_t>();
+	m_pCols->release(rowStart[begin] * sizeof(uint32_t), (rowStart[end] - rowStart[begin]) * sizeof(uint32_t));
+	m_pCoefs->release(rowStart[begin] * sizeof(double), (rowStart[end] - rowStart[begin]) * sizeof(double));
+	m_pRows->release(begin * sizeof(uint64_t), (end - begin) * sizeof(uint64_t));
+}
+
+template<typename visitor>
+void OutOfCoreOperatorImplementation::product(const data_vector & x, visitor V) const
+{
+	LS_PROFILE_SCOPE("OutOfCoreOperatorImplementation::product");
+	const uint64_t* rowStart = m_pRows->data<uint64_t>();
+	const uint32_t* cols = m_pCols->data<uint32_t>();
+	const double* coefs = m_pCoefs->data<double>();
+
+	//First row after the block starting at the row begin
+	auto blockEnd = [&](size_t begin)->size_t
+	{
+		size_t end = std::upper_bound(rowStart + begin + 1, rowStart + m_size + 1,
+			rowStart[begin] + s_blockNonZeros) - rowStart - 1;
+		return std::max(end, begin + 1);
+	};
+
+	size_t begin = 0, end = m_size ? blockEnd(0) : 0;
+	if (m_size) prefetch(begin, end);
+	while (begin < m_size)
+	{
+		//The next block is read by the system while the current one is computed
+		const size_t nextEnd = end < m_size ? blockEnd(end) : m_size;
+		if (end < m_size) prefetch(end, nextEnd);
+		for (size_t i = begin; i < end; ++i)
+		{
+			double val = 0.0;
+			for (uint64_t k = rowStart[i]; k < rowStart[i + 1]; ++k) val += x[cols[k]] * coefs[k];
+			V(i, val);
+		}
+		release(begin, end);
+		begin = end;
+		end = nextEnd;
+	}
+}
+
+void OutOfCoreOperatorImplementation::applyToField(PotentialField * pField) const
+{
+	data_vector& x = operatorFieldData(pField, m_size, "OutOfCoreOperatorImplementation::applyToField");
+	data_vector result(m_size);
+	product(x, [&](size_t i, double val) { result[i] = val; });
+	x.swap(result);
+}
+
+size_t OutOfCoreOperatorImplementation::update(const PotentialField *)
+{
+	throw std::runtime_error("OutOfCoreOperatorImplementation::update: "
+		"Out of core operators are not updated, create a new one.");
+}
+
+size_t OutOfCoreOperatorImplementation::relax(PotentialField *, double, size_t) const
+{
+	throw std::runtime_error("OutOfCoreOperatorImplementation::relax: "
+		"Relaxation needs random access to rows and is not supported by out of core operators.");
+}
+
+void OutOfCoreOperatorImplementation::applyChebyshev(PotentialField * pField, size_t nIterations) const
+{
+	data_vector& x = operatorFieldData(pField, m_size, "OutOfCoreOperatorImplementation::applyChebyshev");
+	chebyshevIteration(x, nIterations, spectralRadius(),
+		[this](const data_vector& x, auto V) { product(x, V); });
+}
+
+double OutOfCoreOperatorImplementation::spectralRadius() const
+{
+	double rho = m_rho;
+	if (rho >= 0.0) return rho;
+	const uint64_t* rowStart = m_pRows->data<uint64_t>();
+	const uint32_t* cols = m_pCols->data<uint32_t>();
+	const double* coefs = m_pCoefs->data<double>();
+	m_rho = rho = powerIteration(m_size, 30,
+		[this](const std::vector<double>& v, auto V) { product(v, V); },
+		[&](size_t i)->bool
+	{
+		return rowStart[i + 1] - rowStart[i] == 1 && cols[rowStart[i]] == i && coefs[rowStart[i]] == 1.0;
+	});
+	return rho;
+}
+
+void OutOfCoreOperatorImplementation::applyTiled(PotentialField * pField, size_t nIterations, size_t, size_t) const
+{
+	for (size_t i = 0; i < nIterations; ++i) applyToField(pField);
+}
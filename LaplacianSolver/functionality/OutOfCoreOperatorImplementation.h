@@ -0,0 +1,56 @@
+#pragma once
+#ifndef _OUT_OF_CORE_OPERATOR_IMPLEMENTATION_H_
+#define _OUT_OF_CORE_OPERATOR_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+#include <memory>
+
+#include "..\LSExport.h"
+#include "..\mesh_math\fieldOperator.h"
+#include "MappedFile.h"
+
+/**
+ * Laplacian solver operator kept in memory mapped files <fileBase>.rows, <fileBase>.cols and <fileBase>.coefs
+ * Matrix products stream through the files by large blocks reading the next block ahead.
+ * The operator keeps no mesh, node positions are mapped by the mesh (MeshImplementation::mapPositions),
+ * the mesh graph and boundaries of the field stay in memory with the field. The files are removed with the operator
+ */
+class OutOfCoreOperatorImplementation : public ScalarFieldOperator
+{
+	using Field = field<double>;
+	using data_vector = Field::data_vector;
+
+	std::string m_fileBase;
+	size_t m_size;
+	std::unique_ptr<MappedFile> m_pRows, m_pCols, m_pCoefs;
+	mutable std::atomic<double> m_rho; //Negative until it is estimated
+
+	//Number of matrix elements in a streamed block
+	static const size_t s_blockNonZeros = 1 << 22;
+
+	//Calls V(i, (Ax)_i) for every row i
+	template<typename visitor>
+	void product(const data_vector& x, visitor V) const;
+
+	//Moves rows [begin, end) into memory or allows the system to drop them
+	void prefetch(size_t begin, size_t end) const;
+	void release(size_t begin, size_t end) const;
+public:
+	OutOfCoreOperatorImplementation(const Field& field, const std::string& fileBase);
+
+	~OutOfCoreOperatorImplementation();
+
+	void applyToField(PotentialField* field) const;
+
+	size_t update(const PotentialField* field);
+
+	size_t relax(PotentialField* field, double tolerance, size_t maxUpdates) const;
+
+	void applyChebyshev(PotentialField* field, size_t nIterations) const;
+
+	double spectralRadius() const;
+
+	void applyTiled(PotentialField* field, size_t nIterations, size_t depth, size_t cacheBytes) const;
+};
+
+#endif // !_OUT_OF_CORE_OPERATOR_IMPLEMENTATION_H_
@@ -1,14 +1,45 @@
 #include "PotentialFieldImplementation.h"
 #include "MeshImplementation.h"
 
+#include "fieldOperatorImplementation.h"
+#include "ExecutorImplementation.h"
+
 PotentialFieldImplementation::PotentialFieldImplementation(Mesh* meshGeom)
 	: 
-	basic_field(dynamic_cast<MeshImplementation*>(meshGeom)->geometryPtr())
+	basic_field(dynamic_cast<MeshImplementation*>(meshGeom)->geometryPtr()),
+	m_pSnapshots(new FieldSnapshots),
+	m_pExecutor(dynamic_cast<MeshImplementation*>(meshGeom)->executor()),
+	m_pSurface(dynamic_cast<MeshImplementation*>(meshGeom)->surfacePtr())
+{}
+
+PotentialFieldImplementation::PotentialFieldImplementation(const PotentialFieldImplementation& other)
+	:
+	PotentialField(),
+	basic_field(other),
+	m_pSnapshots(new FieldSnapshots),
+	m_pExecutor(other.m_pExecutor),
+	m_pSurface(other.m_pSurface)
 {}
 
+std::shared_ptr<const std::vector<double>> PotentialFieldImplementation::activeSnapshot() const
+{
+	//While a background solve runs the field data belong to the solver thread
+	if (!m_pSnapshots->active()) return std::shared_ptr<const std::vector<double>>();
+	return m_pSnapshots->current();
+}
+
+std::vector<double> PotentialFieldImplementation::outerVals(const std::vector<double>& vals) const
+{
+	std::vector<double> result(vals.size());
+	for (UINT i = 0; i < vals.size(); ++i) result[mesh().outerLabel(i)] = vals[i];
+	return result;
+}
+
 const std::vector<double>& PotentialFieldImplementation::getPotentialVals() const
 {
-	return basic_field::data();
+	if (!mesh().renumbered()) return basic_field::data();
+	m_outerVals = outerVals(basic_field::data());
+	return m_outerVals;
 }
 
 void PotentialFieldImplementation::setBoundaryVal(const std::string & name, double val)
@@ -18,7 +49,20 @@ void PotentialFieldImplementation::setBoundaryVal(const std::string & name, doub
 
 void PotentialFieldImplementation::setBoundaryVal(const std::string & name, const std::vector<double>& vals)
 {
-	basic_field::set_boundary_vals(name, vals);
+	if (!mesh().renumbered()) return basic_field::set_boundary_vals(name, vals);
+
+	//Values are listed in ascending order of user labels, the field expects them in order of mesh labels
+	const mesh_geom::label_list& labels = boundary().boundaryLabels(name);
+	if (vals.size() != labels.size())
+		throw std::runtime_error("PotentialFieldImplementation::setBoundaryVal: "
+			"Boundary and input vector sizes mismatch.");
+	std::vector<std::pair<UINT, size_t>> outer;
+	outer.reserve(labels.size());
+	for (UINT l : labels) outer.push_back(std::make_pair(mesh().outerLabel(l), outer.size()));
+	std::sort(outer.begin(), outer.end());
+	std::vector<double> innerVals(vals.size());
+	for (size_t i = 0; i < outer.size(); ++i) innerVals[outer[i].second] = vals[i];
+	basic_field::set_boundary_vals(name, innerVals);
 }
 
 void PotentialFieldImplementation::addBoundary(
@@ -29,7 +73,69 @@ void PotentialFieldImplementation::addBoundary(
 	std::vector<vector3f> vNormalsInner(vNormals.size());
 	std::transform(vNormals.begin(), vNormals.end(), vNormalsInner.begin(),
 		[](V3D v)->vector3f { return vector3f{ v.x, v.y, v.z }; });
-	basic_field::add_boundary(sName, vLabels, vNormalsInner);
+	if (!mesh().renumbered()) return basic_field::add_boundary(sName, vLabels, vNormalsInner);
+
+	std::vector<UINT> vLabelsInner(vLabels.size());
+	std::transform(vLabels.begin(), vLabels.end(), vLabelsInner.begin(),
+		[&](UINT l)->UINT { return mesh().innerLabel(l); });
+	basic_field::add_boundary(sName, vLabelsInner, vNormalsInner);
+}
+
+std::vector<UINT> PotentialFieldImplementation::innerLabels(const UINT* labels, size_t nLabels) const
+{
+	std::vector<UINT> result(nLabels);
+	for (size_t i = 0; i < nLabels; ++i)
+	{
+		if (labels[i] >= mesh().size())
+			throw std::runtime_error("PotentialFieldImplementation::innerLabels: Too big label for used mesh.");
+		result[i] = mesh().innerLabel(labels[i]);
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+void PotentialFieldImplementation::addSurfaceBoundary(const std::string& sName, const std::vector<UINT>& vLabelsInner)
+{
+	if (m_pSurface->size() == 0)
+		throw std::runtime_error("PotentialFieldImplementation::addSurfaceBoundary: "
+			"Mesh has no volume elements, boundary normals should be given.");
+	std::vector<vector3f> vNormals(vLabelsInner.size());
+	std::transform(vLabelsInner.begin(), vLabelsInner.end(), vNormals.begin(),
+		[&](UINT l)->vector3f { return m_pSurface->normal(l); });
+	basic_field::add_boundary(sName, vLabelsInner, vNormals);
+}
+
+void PotentialFieldImplementation::addBoundary(const std::string& sName, const std::vector<UINT>& vLabels)
+{
+	addSurfaceBoundary(sName, innerLabels(vLabels.data(), vLabels.size()));
+}
+
+void PotentialFieldImplementation::addBoundaryFaces(const std::string& sName, const UINT* faceNodes, size_t nFaces,
+	UINT nodesPerFace)
+{
+	if (nodesPerFace != 3 && nodesPerFace != 4)
+		throw std::runtime_error("PotentialFieldImplementation::addBoundaryFaces: Faces should have 3 or 4 nodes.");
+	addSurfaceBoundary(sName, innerLabels(faceNodes, nFaces * nodesPerFace));
+}
+
+void PotentialFieldImplementation::addBoundariesByTag(const std::vector<UINT>& faceTags, const std::string& prefix)
+{
+	if (faceTags.size() != m_pSurface->size())
+		throw std::runtime_error("PotentialFieldImplementation::addBoundariesByTag: "
+			"Sizes of tags and exterior faces mismatch.");
+	std::map<UINT, std::vector<UINT>> patches;
+	for (size_t i = 0; i < faceTags.size(); ++i)
+	{
+		std::vector<UINT>& labels = patches[faceTags[i]];
+		labels.insert(labels.end(), m_pSurface->face(i), m_pSurface->face(i) + 4);
+	}
+	for (std::pair<const UINT, std::vector<UINT>>& patch : patches)
+	{
+		std::sort(patch.second.begin(), patch.second.end());
+		patch.second.erase(std::unique(patch.second.begin(), patch.second.end()), patch.second.end());
+		addSurfaceBoundary(prefix + std::to_string(patch.first), patch.second);
+	}
 }
 
 void PotentialFieldImplementation::setBoundaryType(const std::string & name, BOUNDARY_TYPE type)
@@ -44,6 +150,18 @@ void PotentialFieldImplementation::setBoundaryType(const std::string & name, BOU
 	}
 }
 
+void PotentialFieldImplementation::addSymmetryPlane(UINT axis, double position, SYMMETRY_TYPE type)
+{
+	switch (type)
+	{
+	case SYMMETRIC: return basic_field::add_symmetry_plane(static_cast<int>(axis), position, false);
+	case ANTISYMMETRIC: return basic_field::add_symmetry_plane(static_cast<int>(axis), position, true);
+	default: throw std::runtime_error(
+		"PotentialFieldImplementation::addSymmetryPlane :"
+		"Unsupported symmetry type");
+	}
+}
+
 void PotentialFieldImplementation::applyBoundaryConditions()
 {
 	basic_field::applyBoundaryConditions();
@@ -51,12 +169,52 @@ void PotentialFieldImplementation::applyBoundaryConditions()
 
 void PotentialFieldImplementation::diffuse()
 {
-	basic_field next = basic_field::diffuse();
-	data() = next.data();
+	std::vector<double> next;
+	basic_field::diffuse(next, runnerOf(m_pExecutor));
+	data().swap(next);
+	touch_values();
 }
 
 double PotentialFieldImplementation::interpolate(double x, double y, double z, UINT * track_label) const
 {
-	return basic_field::interpolate(x, y, z, track_label);
+	std::shared_ptr<const std::vector<double>> pSnapshot = activeSnapshot();
+	const std::vector<double>& values = pSnapshot ? *pSnapshot : basic_field::data();
+
+	if (!track_label || !mesh().renumbered()) return basic_field::interpolate(values, x, y, z, track_label);
+
+	UINT label = mesh().innerLabel(*track_label);
+	double val = basic_field::interpolate(values, x, y, z, &label);
+	*track_label = mesh().outerLabel(label);
+	return val;
+}
+
+void PotentialFieldImplementation::resample(
+	double * values, 
+	UINT nx, UINT ny, UINT nz, 
+	const std::pair<V3D, V3D>* box, 
+	Executor* executor) const
+{
+	mesh_geom::box3D lattice = mesh().box();
+	if (box)
+	{
+		lattice.first = vector3f{ box->first.x, box->first.y, box->first.z };
+		lattice.second = vector3f{ box->second.x, box->second.y, box->second.z };
+	}
+	std::shared_ptr<const std::vector<double>> pSnapshot = activeSnapshot();
+	basic_field::resample(pSnapshot ? *pSnapshot : basic_field::data(),
+		lattice.first, lattice.second, nx, ny, nz, values, runnerOf(executor ? executor : m_pExecutor));
+}
+
+SolveHandle * PotentialFieldImplementation::solveAsync(const ScalarFieldOperator * op, size_t nIterations, size_t publishEvery)
+{
+	return new SolveHandleImplementation(this, op, nIterations, publishEvery);
+}
+
+std::shared_ptr<const std::vector<double>> PotentialFieldImplementation::getPotentialSnapshot() const
+{
+	std::shared_ptr<const std::vector<double>> pSnapshot = m_pSnapshots->current();
+	if (!m_pSnapshots->active() || !pSnapshot) pSnapshot = std::make_shared<const std::vector<double>>(basic_field::data());
+	if (!mesh().renumbered()) return pSnapshot;
+	return std::make_shared<const std::vector<double>>(outerVals(*pSnapshot));
 }
 
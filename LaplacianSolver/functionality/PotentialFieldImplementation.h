@@ -6,15 +6,48 @@
 
 #include "..\LSExport.h"
 #include "..\mesh_math\Field.h"
+#include "..\mesh_math\boundarySurface.h"
+#include "SolveHandleImplementation.h"
 
 class PotentialFieldImplementation : public PotentialField, public field<double>
 {
 	using mesh_geom = mesh_geometry<double, UINT>;
 	using basic_field = field<double>;
 
+	//Field values in the user node numbering, it is used only if mesh nodes were renumbered
+	mutable std::vector<double> m_outerVals;
+
+	//Copies of field values for readers while a background solve runs
+	std::unique_ptr<FieldSnapshots> m_pSnapshots;
+
+	//Executor of the mesh
+	Executor* m_pExecutor;
+
+	//Exterior surface of the mesh elements, it gives normals of boundaries added without them
+	std::shared_ptr<const boundary_surface<UINT>> m_pSurface;
+
+	//Adds a boundary of sorted unique mesh labels with the normals of the exterior surface
+	void addSurfaceBoundary(const std::string& sName, const std::vector<UINT>& vLabelsInner);
+
+	//Converts user labels to sorted unique mesh labels
+	std::vector<UINT> innerLabels(const UINT* labels, size_t nLabels) const;
+
+	//Converts values from the mesh numbering to the user numbering
+	std::vector<double> outerVals(const std::vector<double>& vals) const;
+
 public:
 	PotentialFieldImplementation(Mesh* meshGeom);
 
+	//Copies field values and boundaries, snapshots are not shared
+	PotentialFieldImplementation(const PotentialFieldImplementation& other);
+
+	FieldSnapshots& snapshots() { return *m_pSnapshots; }
+
+	Executor* executor() const { return m_pExecutor; }
+
+	//Returns the last snapshot while a background solve runs and NULL otherwise
+	std::shared_ptr<const std::vector<double>> activeSnapshot() const;
+
 	const std::vector<double>& getPotentialVals() const;
 
 	void setBoundaryVal(const std::string& name, double val);
@@ -23,13 +56,27 @@ public:
 
 	void addBoundary(const std::string& sName, const std::vector<UINT>& vLabels, const std::vector<V3D>& vNormals);
 
+	void addBoundary(const std::string& sName, const std::vector<UINT>& vLabels);
+
+	void addBoundaryFaces(const std::string& sName, const UINT* faceNodes, size_t nFaces, UINT nodesPerFace);
+
+	void addBoundariesByTag(const std::vector<UINT>& faceTags, const std::string& prefix);
+
 	void setBoundaryType(const std::string& name, BOUNDARY_TYPE type);
 
+	void addSymmetryPlane(UINT axis, double position, SYMMETRY_TYPE type);
+
 	void applyBoundaryConditions();
 
 	void diffuse();
 
 	double interpolate(double x, double y, double z, UINT* track_label) const;
+
+	void resample(double* values, UINT nx, UINT ny, UINT nz, const std::pair<V3D, V3D>* box, Executor* executor) const;
+
+	SolveHandle* solveAsync(const ScalarFieldOperator* op, size_t nIterations, size_t publishEvery);
+
+	std::shared_ptr<const std::vector<double>> getPotentialSnapshot() const;
 };
 
 #endif // !_POTENTIAL_FIELD_IMPLEMENTATION_H_
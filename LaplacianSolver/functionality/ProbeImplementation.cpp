@@ -0,0 +1,107 @@
+#include "ProbeImplementation.h"
+#include "ExecutorImplementation.h"
+
+ProbeImplementation::ProbeImplementation(const Mesh * m, const std::vector<V3D>& points, Executor* executor)
+	:
+	m_pMesh(dynamic_cast<const MeshImplementation*>(m)->geometryPtr()),
+	m_pExecutor(executor ? executor : dynamic_cast<const MeshImplementation*>(m)->executor()),
+	m_points(points),
+	m_pRows(compile(points))
+{}
+
+std::shared_ptr<ProbeImplementation::Rows> ProbeImplementation::compile(const std::vector<V3D>& points) const
+{
+	LS_PROFILE_SCOPE("ProbeImplementation::compile");
+	const size_t n = points.size();
+	const size_t capacity = mesh_geom::InterpStencil::capacity;
+
+	//Stencils are found by chunks of points, every search starts from the node found for the previous point.
+	//The rows take the same room for every point at first and are packed after that
+	std::vector<UINT> labels(n * capacity);
+	std::vector<double> weights(n * capacity);
+	std::vector<size_t> rowSize(n);
+	parallelBlocks(runnerOf(m_pExecutor), n, s_pointsPerChunk, [&](size_t block)
+	{
+		UINT label = 0;
+		for (size_t i = block * s_pointsPerChunk; i < std::min((block + 1) * s_pointsPerChunk, n); ++i)
+		{
+			mesh_geom::InterpStencil stencil = m_pMesh->interpStencil(points[i].x, points[i].y, points[i].z, label);
+			label = stencil.labels[0];
+			rowSize[i] = stencil.size();
+			std::copy(stencil.labels, stencil.labels + stencil.size(), labels.begin() + i * capacity);
+			std::copy(stencil.weights, stencil.weights + stencil.size(), weights.begin() + i * capacity);
+		}
+	});
+
+	std::shared_ptr<Rows> pRows = std::make_shared<Rows>();
+	pRows->rowStart.assign(1, 0);
+	pRows->rowStart.reserve(n + 1);
+	for (size_t i = 0; i < n; ++i) pRows->rowStart.push_back(pRows->rowStart.back() + rowSize[i]);
+	pRows->labels.reserve(pRows->rowStart.back());
+	pRows->weights.reserve(pRows->rowStart.back());
+	for (size_t i = 0; i < n; ++i)
+	{
+		pRows->labels.insert(pRows->labels.end(), labels.begin() + i * capacity, labels.begin() + i * capacity + rowSize[i]);
+		pRows->weights.insert(pRows->weights.end(), weights.begin() + i * capacity, weights.begin() + i * capacity + rowSize[i]);
+	}
+	return pRows;
+}
+
+std::shared_ptr<const ProbeImplementation::Rows> ProbeImplementation::rowsFor(const PotentialFieldImplementation & field) const
+{
+	const SymmetryPlanes& planes = field.symmetry_planes();
+	if (planes.empty()) return m_pRows;
+	std::lock_guard<std::mutex> lock(m_reflectedMutex);
+	if (m_pReflected && m_reflectedPlanes == planes) return m_pReflected;
+
+	//Points are reflected as field interpolation does, the probe rows serve if no point moves
+	std::vector<V3D> reflected(m_points);
+	std::vector<double> signs(m_points.size());
+	bool moved = false, flipped = false;
+	for (size_t i = 0; i < reflected.size(); ++i)
+	{
+		V3D& p = reflected[i];
+		signs[i] = field.reflect(p.x, p.y, p.z);
+		moved = moved || p.x != m_points[i].x || p.y != m_points[i].y || p.z != m_points[i].z;
+		flipped = flipped || signs[i] != 1.0;
+	}
+	if (!moved) m_pReflected = m_pRows;
+	else
+	{
+		std::shared_ptr<Rows> pRows = compile(reflected);
+		if (flipped) pRows->signs.swap(signs);
+		m_pReflected = pRows;
+	}
+	m_reflectedPlanes = planes;
+	return m_pReflected;
+}
+
+size_t ProbeImplementation::size() const
+{
+	return m_points.size();
+}
+
+void ProbeImplementation::sample(const PotentialField * f, double * values) const
+{
+	LS_PROFILE_SCOPE("ProbeImplementation::sample");
+	const PotentialFieldImplementation& field = dynamic_cast<const PotentialFieldImplementation&>(*f);
+	if (&field.mesh() != m_pMesh.get())
+		throw std::runtime_error("ProbeImplementation::sample: The field is created on another mesh.");
+	std::shared_ptr<const std::vector<double>> pSnapshot = field.activeSnapshot();
+	const std::vector<double>& x = pSnapshot ? *pSnapshot : field.data();
+	const std::shared_ptr<const Rows> pRows = rowsFor(field);
+	const Rows& r = *pRows;
+
+	auto rows = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			double val = 0.0;
+			for (size_t k = r.rowStart[i]; k < r.rowStart[i + 1]; ++k) val += r.weights[k] * x[r.labels[k]];
+			values[i] = r.signs.empty() ? val : r.signs[i] * val;
+		}
+	};
+	//Small sets are cheaper to sample in the calling thread
+	if (size() <= s_pointsPerChunk) rows(0, size());
+	else m_pExecutor->parallelFor(0, size(), s_pointsPerChunk, rows);
+}
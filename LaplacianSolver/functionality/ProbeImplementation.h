@@ -0,0 +1,56 @@
+#pragma once
+#ifndef _PROBE_IMPLEMENTATION_H_
+#define _PROBE_IMPLEMENTATION_H_ 1
+
+#include <memory>
+#include <mutex>
+
+#include "..\LSExport.h"
+#include "MeshImplementation.h"
+#include "PotentialFieldImplementation.h"
+
+/**
+ * Interpolation stencils of the points stored as sparse rows, the row of a point holds mesh labels and their weights.
+ * Fields with symmetry planes are sampled with the stencils of the points reflected into the mesh,
+ * they are compiled on the first such sample and kept for the same planes
+ */
+class ProbeImplementation : public Probe
+{
+	using SymmetryPlanes = std::vector<PotentialFieldImplementation::SymmetryPlane>;
+
+	//Number of points in a chunk of parallel loops
+	static const size_t s_pointsPerChunk = 1024;
+
+	//Stencils of all points, signs are empty if no point changes the sign of the value
+	struct Rows
+	{
+		std::vector<size_t> rowStart;
+		std::vector<UINT> labels;
+		std::vector<double> weights;
+		std::vector<double> signs;
+	};
+
+	std::shared_ptr<const mesh_geom> m_pMesh;
+	Executor* m_pExecutor;
+	std::vector<V3D> m_points;
+	std::shared_ptr<const Rows> m_pRows;
+
+	//Stencils of the reflected points for the planes of the last sampled field with symmetry planes
+	mutable SymmetryPlanes m_reflectedPlanes;
+	mutable std::shared_ptr<const Rows> m_pReflected;
+	mutable std::mutex m_reflectedMutex;
+
+	//Locates the points on the mesh
+	std::shared_ptr<Rows> compile(const std::vector<V3D>& points) const;
+
+	//Stencils for the symmetry planes of the field
+	std::shared_ptr<const Rows> rowsFor(const PotentialFieldImplementation& field) const;
+public:
+	ProbeImplementation(const Mesh* m, const std::vector<V3D>& points, Executor* executor);
+
+	size_t size() const;
+
+	void sample(const PotentialField* f, double* values) const;
+};
+
+#endif // !_PROBE_IMPLEMENTATION_H_
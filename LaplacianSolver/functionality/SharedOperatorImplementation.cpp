@@ -0,0 +1,162 @@
+#include "SharedOperatorImplementation.h"
+
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	using OperatorPtr = std::shared_ptr<const FieldOperatorImplementation>;
+
+	//Operator built for a mesh, boundary conditions, type and executor
+	struct CacheEntry
+	{
+		const void* mesh;
+		ScalarFieldOperator::OperatorType type;
+		Executor* executor;
+
+		//While the operator is assembled, boundary conditions of the field it is assembled for and its future,
+		//the boundary is NULL when the operator is published
+		const field<double>::BoundaryMesh* pBoundary;
+		std::shared_future<OperatorPtr> pending;
+
+		std::weak_ptr<const FieldOperatorImplementation> op;
+	};
+
+	//Entries are keyed by the hash of boundary conditions
+	using OperatorCache = std::unordered_multimap<size_t, CacheEntry>;
+
+	//The cache is never deleted as the shared executor, operators may be freed while the library is unloaded
+	std::mutex& cacheMutex()
+	{
+		static std::mutex* pMutex = new std::mutex;
+		return *pMutex;
+	}
+
+	OperatorCache& cache()
+	{
+		static OperatorCache* pCache = new OperatorCache;
+		return *pCache;
+	}
+}
+
+std::shared_ptr<const SharedOperatorImplementation::Operator> SharedOperatorImplementation::acquire(
+	const PotentialFieldImplementation & field, ScalarFieldOperator::OperatorType type, Executor * executor, bool & assembled)
+{
+	assembled = false;
+	std::mutex* pMutex = &cacheMutex();
+	OperatorCache* pCache = &cache();
+
+	const size_t hash = field.boundary().conditionsHash();
+	//The lock only guards the cache. A new operator is announced by its future and assembled without the lock,
+	//so fields asking for the same operator wait for one assembly and the others are not blocked
+	std::promise<OperatorPtr> promise;
+	CacheEntry* pEntry = NULL; //Entries being assembled are not erased, rehashing keeps their addresses
+	{
+		std::unique_lock<std::mutex> lock(*pMutex);
+		for (auto it = pCache->begin(); it != pCache->end();)
+			if (!it->second.pBoundary && it->second.op.expired()) it = pCache->erase(it);
+			else ++it;
+
+		auto range = pCache->equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const CacheEntry& entry = it->second;
+			if (entry.mesh != &field.mesh() || entry.type != type || entry.executor != executor) continue;
+			if (entry.pBoundary)
+			{
+				if (!entry.pBoundary->sameConditions(field.boundary())) continue;
+				std::shared_future<OperatorPtr> pending = entry.pending;
+				lock.unlock();
+				return pending.get();
+			}
+			std::shared_ptr<const Operator> pOp = entry.op.lock();
+			if (pOp && pOp->boundary().sameConditions(field.boundary())) return pOp;
+		}
+
+		pEntry = &pCache->insert(std::make_pair(hash, CacheEntry{ &field.mesh(), type, executor,
+			&field.boundary(), promise.get_future().share(), std::weak_ptr<const Operator>() }))->second;
+	}
+
+	std::shared_ptr<const Operator> pOp;
+	try
+	{
+		pOp = std::make_shared<Operator>(field, type, executor);
+	}
+	catch (...)
+	{
+		//Waiting fields get the error and the next request assembles again
+		{
+			std::lock_guard<std::mutex> lock(*pMutex);
+			auto range = pCache->equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+				if (&it->second == pEntry)
+				{
+					pCache->erase(it);
+					break;
+				}
+		}
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(*pMutex);
+		pEntry->op = pOp;
+		pEntry->pBoundary = NULL;
+		pEntry->pending = std::shared_future<OperatorPtr>();
+	}
+	promise.set_value(pOp);
+	assembled = true;
+	return pOp;
+}
+
+SharedOperatorImplementation::SharedOperatorImplementation(const PotentialFieldImplementation & field,
+	ScalarFieldOperator::OperatorType type, Executor * executor, bool & assembled)
+	:
+	m_pOp(acquire(field, type, executor, assembled))
+{}
+
+size_t SharedOperatorImplementation::cachedOperators()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex());
+	size_t n = 0;
+	for (const auto& entry : cache()) if (entry.second.pBoundary || !entry.second.op.expired()) ++n;
+	return n;
+}
+
+void SharedOperatorImplementation::applyToField(PotentialField * field) const
+{
+	m_pOp->applyToField(field);
+}
+
+size_t SharedOperatorImplementation::update(const PotentialField *)
+{
+	throw std::runtime_error("SharedOperatorImplementation::update: "
+		"Shared operators are immutable, create a new one for the changed boundaries.");
+}
+
+size_t SharedOperatorImplementation::relax(PotentialField * field, double tolerance, size_t maxUpdates) const
+{
+	return m_pOp->relax(field, tolerance, maxUpdates);
+}
+
+void SharedOperatorImplementation::applyChebyshev(PotentialField * field, size_t nIterations) const
+{
+	m_pOp->applyChebyshev(field, nIterations);
+}
+
+double SharedOperatorImplementation::spectralRadius() const
+{
+	return m_pOp->spectralRadius();
+}
+
+void SharedOperatorImplementation::applyTiled(PotentialField * field, size_t nIterations, size_t depth, size_t cacheBytes) const
+{
+	m_pOp->applyTiled(field, nIterations, depth, cacheBytes);
+}
+
+void SharedOperatorImplementation::applyToFields(PotentialField * const * fields, size_t nFields, size_t nIterations) const
+{
+	m_pOp->applyToFields(fields, nFields, nIterations);
+}
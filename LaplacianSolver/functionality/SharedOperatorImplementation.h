@@ -0,0 +1,46 @@
+#pragma once
+#ifndef _SHARED_OPERATOR_IMPLEMENTATION_H_
+#define _SHARED_OPERATOR_IMPLEMENTATION_H_ 1
+
+#include <memory>
+
+#include "..\LSExport.h"
+#include "fieldOperatorImplementation.h"
+#include "PotentialFieldImplementation.h"
+
+/**
+ * Handle of an immutable operator shared by fields of one mesh with the same boundary conditions.
+ * Operators are cached while at least one handle refers to them
+ */
+class SharedOperatorImplementation : public ScalarFieldOperator
+{
+	using Operator = FieldOperatorImplementation;
+
+	std::shared_ptr<const Operator> m_pOp;
+
+	//Finds the cached operator for the mesh and boundary conditions of the field or assembles a new one, assembled is set then
+	static std::shared_ptr<const Operator> acquire(const PotentialFieldImplementation& field,
+		ScalarFieldOperator::OperatorType type, Executor* executor, bool& assembled);
+public:
+	SharedOperatorImplementation(const PotentialFieldImplementation& field, ScalarFieldOperator::OperatorType type, Executor* executor,
+		bool& assembled);
+
+	//Number of cached operators which are assembled or being assembled and are not released
+	static size_t cachedOperators();
+
+	void applyToField(PotentialField* field) const;
+
+	size_t update(const PotentialField* field);
+
+	size_t relax(PotentialField* field, double tolerance, size_t maxUpdates) const;
+
+	void applyChebyshev(PotentialField* field, size_t nIterations) const;
+
+	double spectralRadius() const;
+
+	void applyTiled(PotentialField* field, size_t nIterations, size_t depth, size_t cacheBytes) const;
+
+	void applyToFields(PotentialField* const* fields, size_t nFields, size_t nIterations) const;
+};
+
+#endif // !_SHARED_OPERATOR_IMPLEMENTATION_H_
@@ -0,0 +1,110 @@
+#include "SolveHandleImplementation.h"
+#include "PotentialFieldImplementation.h"
+
+FieldSnapshots::FieldSnapshots()
+	: m_bActive(false)
+{}
+
+void FieldSnapshots::publish(const Values & values)
+{
+	//Previous copy is released by the last reader holding it
+	std::atomic_store(&m_pCurrent, std::shared_ptr<const Values>(std::make_shared<Values>(values)));
+}
+
+std::shared_ptr<const FieldSnapshots::Values> FieldSnapshots::current() const
+{
+	return std::atomic_load(&m_pCurrent);
+}
+
+bool FieldSnapshots::active() const
+{
+	return m_bActive.load(std::memory_order_acquire);
+}
+
+bool FieldSnapshots::begin()
+{
+	bool bActive = false;
+	return m_bActive.compare_exchange_strong(bActive, true, std::memory_order_acq_rel);
+}
+
+void FieldSnapshots::end()
+{
+	m_bActive.store(false, std::memory_order_release);
+	std::atomic_store(&m_pCurrent, std::shared_ptr<const Values>());
+}
+
+SolveHandleImplementation::SolveHandleImplementation(
+	PotentialFieldImplementation* pF,
+	const ScalarFieldOperator* pOp,
+	size_t nIterations,
+	size_t publishEvery)
+	:
+	m_bCancel(false),
+	m_bFinished(false),
+	m_nDone(0),
+	m_nTotal(nIterations)
+{
+	if (pOp == NULL) throw std::runtime_error("SolveHandleImplementation::SolveHandleImplementation: Operator is not given.");
+	//Until the first copy is published readers take the field values, the solve has not changed them yet
+	if (!pF->snapshots().begin())
+		throw std::runtime_error("SolveHandleImplementation::SolveHandleImplementation: "
+			"Another solve of the field is running.");
+	pF->snapshots().publish(pF->data());
+	m_thread = std::thread(&SolveHandleImplementation::run, this, pF, pOp, std::max<size_t>(publishEvery, 1));
+}
+
+SolveHandleImplementation::~SolveHandleImplementation()
+{
+	cancel();
+	if (m_thread.joinable()) m_thread.join();
+}
+
+void SolveHandleImplementation::run(PotentialFieldImplementation* pF, const ScalarFieldOperator* pOp, size_t publishEvery)
+{
+	//Operators keeping iterates of their own write them to the field data before every copy
+	try
+	{
+		while (m_nDone < m_nTotal && !m_bCancel)
+		{
+			pOp->applyToField(pF);
+			if (++m_nDone % publishEvery == 0)
+			{
+				pOp->flush(pF);
+				pF->snapshots().publish(pF->data());
+			}
+		}
+		pOp->flush(pF);
+	}
+	catch (...)
+	{
+		m_error = std::current_exception();
+	}
+	pF->snapshots().end();
+	m_bFinished = true;
+}
+
+void SolveHandleImplementation::cancel()
+{
+	m_bCancel = true;
+}
+
+size_t SolveHandleImplementation::progress() const
+{
+	return m_nDone;
+}
+
+size_t SolveHandleImplementation::total() const
+{
+	return m_nTotal;
+}
+
+bool SolveHandleImplementation::finished() const
+{
+	return m_bFinished;
+}
+
+void SolveHandleImplementation::wait()
+{
+	if (m_thread.joinable()) m_thread.join();
+	if (m_error) std::rethrow_exception(m_error);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef _SOLVE_HANDLE_IMPLEMENTATION_H_
+#define _SOLVE_HANDLE_IMPLEMENTATION_H_ 1
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "..\LSExport.h"
+
+/**
+ * Immutable copies of field values published by a background solve (read-copy-update)
+ * Readers take the current copy without waiting for the writer
+ */
+class FieldSnapshots
+{
+	using Values = std::vector<double>;
+
+	std::shared_ptr<const Values> m_pCurrent;
+	std::atomic<bool> m_bActive;
+public:
+	FieldSnapshots();
+
+	//Publishes a copy of values, it should be called by a single writer
+	void publish(const Values& values);
+
+	//Returns the last published copy
+	std::shared_ptr<const Values> current() const;
+
+	//Snapshots are used by readers only while a background solve runs
+	bool active() const;
+
+	//Marks a solve running, returns false if another one already runs
+	bool begin();
+
+	//Marks the solve finished and drops the last copy, readers take the field values again
+	void end();
+};
+
+class PotentialFieldImplementation;
+
+//Background thread applying an operator to a field
+class SolveHandleImplementation : public SolveHandle
+{
+	std::atomic<bool> m_bCancel;
+	std::atomic<bool> m_bFinished;
+	std::atomic<size_t> m_nDone;
+	size_t m_nTotal;
+	std::exception_ptr m_error;
+	std::thread m_thread;
+
+	void run(PotentialFieldImplementation* pF, const ScalarFieldOperator* pOp, size_t publishEvery);
+public:
+	SolveHandleImplementation(
+		PotentialFieldImplementation* pF, 
+		const ScalarFieldOperator* pOp, 
+		size_t nIterations, 
+		size_t publishEvery);
+
+	~SolveHandleImplementation();
+
+	void cancel();
+
+	size_t progress() const;
+
+	size_t total() const;
+
+	bool finished() const;
+
+	void wait();
+};
+
+#endif // !_SOLVE_HANDLE_IMPLEMENTATION_H_
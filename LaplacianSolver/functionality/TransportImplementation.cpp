@@ -0,0 +1,96 @@
+#include "TransportImplementation.h"
+
+LocalTransportHub::LocalTransportHub(int nRanks)
+	: m_nRanks(nRanks)
+{
+	for (int i = 0; i < nRanks * nRanks; ++i) m_channels.emplace_back(new Channel);
+}
+
+void LocalTransportHub::push(int src, int dest, const void* data, size_t bytes)
+{
+	Channel& c = channel(src, dest);
+	const char* begin = static_cast<const char*>(data);
+	{
+		std::lock_guard<std::mutex> lock(c.mutex);
+		c.messages.emplace_back(begin, begin + bytes);
+	}
+	c.cv.notify_one();
+}
+
+void LocalTransportHub::pop(int src, int dest, void* data, size_t bytes)
+{
+	Channel& c = channel(src, dest);
+	std::unique_lock<std::mutex> lock(c.mutex);
+	c.cv.wait(lock, [&]() { return !c.messages.empty(); });
+	std::vector<char> message = std::move(c.messages.front());
+	c.messages.pop_front();
+	lock.unlock();
+	if (message.size() != bytes)
+		throw std::runtime_error("LocalTransportHub::pop: Unexpected message size.");
+	std::copy(message.begin(), message.end(), static_cast<char*>(data));
+}
+
+LocalTransport::LocalTransport(const std::shared_ptr<LocalTransportHub>& pHub, int rank)
+	: m_pHub(pHub), m_rank(rank)
+{}
+
+int LocalTransport::rank() const
+{
+	return m_rank;
+}
+
+int LocalTransport::size() const
+{
+	return m_pHub->size();
+}
+
+void LocalTransport::send(int dest, const void * data, size_t bytes)
+{
+	m_pHub->push(m_rank, dest, data, bytes);
+}
+
+void LocalTransport::receive(int src, void * data, size_t bytes)
+{
+	m_pHub->pop(src, m_rank, data, bytes);
+}
+
+void LocalTransport::wait()
+{
+	//Messages are copied to the hub queues when they are sent
+}
+
+#ifdef LS_USE_MPI
+int MPITransport::rank() const
+{
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	return rank;
+}
+
+int MPITransport::size() const
+{
+	int size;
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	return size;
+}
+
+void MPITransport::send(int dest, const void * data, size_t bytes)
+{
+	const char* begin = static_cast<const char*>(data);
+	m_buffers.emplace_back(begin, begin + bytes);
+	m_requests.emplace_back();
+	MPI_Isend(m_buffers.back().data(), static_cast<int>(bytes), MPI_BYTE, dest, 0, MPI_COMM_WORLD, &m_requests.back());
+}
+
+void MPITransport::receive(int src, void * data, size_t bytes)
+{
+	MPI_Recv(data, static_cast<int>(bytes), MPI_BYTE, src, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+void MPITransport::wait()
+{
+	MPI_Waitall(static_cast<int>(m_requests.size()), m_requests.data(), MPI_STATUSES_IGNORE);
+	m_requests.clear();
+	m_buffers.clear();
+}
+#endif // LS_USE_MPI
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef _TRANSPORT_IMPLEMENTATION_H_
+#define _TRANSPORT_IMPLEMENTATION_H_ 1
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "..\LSExport.h"
+
+//Message queues between all pairs of local transports
+class LocalTransportHub
+{
+	struct Channel
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<std::vector<char>> messages;
+	};
+
+	int m_nRanks;
+	std::vector<std::unique_ptr<Channel>> m_channels;
+
+	Channel& channel(int src, int dest) { return *m_channels[src * m_nRanks + dest]; }
+public:
+	LocalTransportHub(int nRanks);
+
+	int size() const { return m_nRanks; }
+
+	void push(int src, int dest, const void* data, size_t bytes);
+
+	void pop(int src, int dest, void* data, size_t bytes);
+};
+
+//Transport between threads of one process
+class LocalTransport : public Transport
+{
+	std::shared_ptr<LocalTransportHub> m_pHub;
+	int m_rank;
+public:
+	LocalTransport(const std::shared_ptr<LocalTransportHub>& pHub, int rank);
+
+	int rank() const;
+
+	int size() const;
+
+	void send(int dest, const void* data, size_t bytes);
+
+	void receive(int src, void* data, size_t bytes);
+
+	void wait();
+};
+
+#ifdef LS_USE_MPI
+#include <mpi.h>
+
+//Transport between processes of MPI_COMM_WORLD
+class MPITransport : public Transport
+{
+	std::vector<MPI_Request> m_requests;
+	std::deque<std::vector<char>> m_buffers; //keeps sent data until wait
+public:
+	int rank() const;
+
+	int size() const;
+
+	void send(int dest, const void* data, size_t bytes);
+
+	void receive(int src, void* data, size_t bytes);
+
+	void wait();
+};
+#endif // LS_USE_MPI
+
+#endif // !_TRANSPORT_IMPLEMENTATION_H_
@@ -1,21 +1,111 @@
 #include "fieldOperatorImplementation.h"
+#include "ExecutorImplementation.h"
 
 FieldOperatorImplementation::FieldOperatorImplementation(const field<double>& field,
-	ScalarFieldOperator::OperatorType type)
+	ScalarFieldOperator::OperatorType type, Executor* executor)
 	:
-	basic_operator(field)
+	basic_operator(field),
+	m_rho(-1.0)
 {
-	switch (type)
+	basic_operator::setRunner(runnerOf(executor));
+	assembleOperator(*this, type, "FieldOperatorImplementation::FieldOperatorImplementation");
+}
+
+void FieldOperatorImplementation::applyToField(PotentialField * field) const
+{
+	basic_operator::applyToField(*dynamic_cast<basic_operator::Field*>(field));
+}
+
+size_t FieldOperatorImplementation::update(const PotentialField * field)
+{
+	size_t nRows = basic_operator::update(*dynamic_cast<const basic_operator::Field*>(field));
+	if (nRows != 0) m_rho = -1.0;
+	return nRows;
+}
+
+size_t FieldOperatorImplementation::relax(PotentialField * field, double tolerance, size_t maxUpdates) const
+{
+	return basic_operator::relax(*dynamic_cast<basic_operator::Field*>(field), tolerance, maxUpdates);
+}
+
+void FieldOperatorImplementation::applyChebyshev(PotentialField * field, size_t nIterations) const
+{
+	basic_operator::chebyshev(*dynamic_cast<basic_operator::Field*>(field), nIterations, spectralRadius());
+}
+
+double FieldOperatorImplementation::spectralRadius() const
+{
+	double rho = m_rho;
+	if (rho < 0.0) m_rho = rho = basic_operator::spectralRadius();
+	return rho;
+}
+
+void FieldOperatorImplementation::applyToFields(PotentialField * const * fields, size_t nFields, size_t nIterations) const
+{
+	if (nFields == 0 || nIterations == 0) return;
+	std::vector<basic_operator::Field*> pFields(nFields);
+	for (size_t f = 0; f < nFields; ++f)
 	{
-	case ScalarFieldOperator::Identity: basic_operator::setToIdentity(); break;
-	case ScalarFieldOperator::LaplacianSolver: basic_operator::laplacianSolver(); break;
-	default: throw std::runtime_error("FieldOperatorImplementation::FieldOperatorImplementation:"
-										 " Unsupported operator type.");
+		pFields[f] = dynamic_cast<basic_operator::Field*>(fields[f]);
+		if (pFields[f]->size() != basic_operator::size()) throw
+			std::runtime_error("FieldOperatorImplementation::applyToFields:"
+				"Field and operator sizes mismatch.");
 	}
 
+	//Fields are interleaved by nodes for the whole call
+	std::vector<double> x(basic_operator::size() * nFields);
+	for (size_t f = 0; f < nFields; ++f)
+	{
+		const std::vector<double>& data = pFields[f]->data();
+		for (size_t i = 0; i < data.size(); ++i) x[i * nFields + f] = data[i];
+	}
+	for (size_t it = 0; it < nIterations; ++it) basic_operator::applyToFields(x, nFields);
+	for (size_t f = 0; f < nFields; ++f)
+	{
+		std::vector<double>& data = pFields[f]->data();
+		for (size_t i = 0; i < data.size(); ++i) data[i] = x[i * nFields + f];
+		pFields[f]->clear_changed();
+		pFields[f]->touch_values();
+	}
 }
 
-void FieldOperatorImplementation::applyToField(PotentialField * field) const
+void FieldOperatorImplementation::applyTiled(PotentialField * field, size_t nIterations, size_t depth, size_t cacheBytes) const
 {
-	basic_operator::applyToField(*dynamic_cast<basic_operator::Field*>(field));
+	basic_operator::tiled(*dynamic_cast<basic_operator::Field*>(field), nIterations, depth, cacheBytes);
+}
+
+void checkOperatorType(ScalarFieldOperator::OperatorType type, const char * caller)
+{
+	if (type != ScalarFieldOperator::Identity && type != ScalarFieldOperator::LaplacianSolver)
+		throw std::runtime_error(std::string(caller) + ": Unsupported operator type.");
+}
+
+void assembleOperator(FieldLinearOp<double>& op, ScalarFieldOperator::OperatorType type, const char * caller)
+{
+	checkOperatorType(type, caller);
+	if (type == ScalarFieldOperator::Identity) op.setToIdentity();
+	else op.laplacianSolver();
+}
+
+void assembleOperatorRow(const FieldLinearOp<double>& op, ScalarFieldOperator::OperatorType type, uint32_t i,
+	FieldLinearOp<double>::MatrixRow & row)
+{
+	if (type == ScalarFieldOperator::Identity) row.assign(1, FieldLinearOp<double>::MatrixElem(i, 1.0));
+	else op.laplacianRow(i, row);
+}
+
+std::vector<double>& operatorFieldData(PotentialField * pField, size_t size, const char * caller)
+{
+	field<double>& f = *dynamic_cast<field<double>*>(pField);
+	if (f.size() != size) throw std::runtime_error(std::string(caller) + ": Field and operator sizes mismatch.");
+	f.clear_changed();
+	f.touch_values();
+	return f.data();
+}
+
+const field<double>& operatorField(const PotentialField * pField, size_t size, const char * caller)
+{
+	const field<double>& f = *dynamic_cast<const field<double>*>(pField);
+	if (f.size() != size) throw std::runtime_error(std::string(caller) + ": Field and operator sizes mismatch.");
+	return f;
 }
@@ -2,16 +2,52 @@
 #ifndef _FIELD_OPERATOR_IMPLEMENTATION_
 #define _FIELD_OPERATOR_IMPLEMENTATION_
 
+#include <atomic>
+
 #include "../LSExport.h"
 #include "../mesh_math/fieldOperator.h"
 
 class FieldOperatorImplementation : public ScalarFieldOperator, public FieldLinearOp<double>
 {
 	using basic_operator = FieldLinearOp<double>;
+
+	mutable std::atomic<double> m_rho; //Negative until it is estimated
 public:
-	FieldOperatorImplementation(const field<double>& field, ScalarFieldOperator::OperatorType type);
+	//The executor runs assembly and matrix products
+	FieldOperatorImplementation(const field<double>& field, ScalarFieldOperator::OperatorType type, Executor* executor);
 
 	void applyToField(PotentialField* field) const;
+
+	size_t update(const PotentialField* field);
+
+	size_t relax(PotentialField* field, double tolerance, size_t maxUpdates) const;
+
+	void applyChebyshev(PotentialField* field, size_t nIterations) const;
+
+	double spectralRadius() const;
+
+	void applyTiled(PotentialField* field, size_t nIterations, size_t depth, size_t cacheBytes) const;
+
+	void applyToFields(PotentialField* const* fields, size_t nFields, size_t nIterations) const;
 };
 
+//Helpers of the operators keeping the matrix in their own storage, caller names the method in the errors
+
+//Throws if the operator type is not supported
+void checkOperatorType(ScalarFieldOperator::OperatorType type, const char* caller);
+
+//Assembles the matrix of the operator type with the runner of op
+void assembleOperator(FieldLinearOp<double>& op, ScalarFieldOperator::OperatorType type, const char* caller);
+
+//Assembles the row i of the operator type, the matrix of op is not used, so rows can be converted one by one
+void assembleOperatorRow(const FieldLinearOp<double>& op, ScalarFieldOperator::OperatorType type, uint32_t i,
+	FieldLinearOp<double>::MatrixRow& row);
+
+//Data of the field checked to have the operator size, the changed nodes of the field are taken by the caller
+//and its values tag is replaced
+std::vector<double>& operatorFieldData(PotentialField* field, size_t size, const char* caller);
+
+//Field checked to have the operator size for reading
+const field<double>& operatorField(const PotentialField* field, size_t size, const char* caller);
+
 #endif //_FIELD_OPERATOR_IMPLEMENTATION_
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <linearAlgebra\matrixTemplate.h>
 
 #include "mesh_geometry.h"
+#include "parallel.h"
 
 /**
 * Field manipulation class
@@ -32,6 +33,20 @@ public:
 	using BoundaryMeshSharedPtr = std::shared_ptr<BoundaryMesh>;
 	using MeshSharedPtr = std::shared_ptr<mesh_geom>;
 	using BoundaryValues = std::map<std::string, std::map<uint32_t, field_type>>;
+
+	//Mirror plane of the full domain, the mesh covers the side of greater coordinates if upper is set
+	struct SymmetryPlane
+	{
+		int axis;
+		double position;
+		bool antisymmetric;
+		bool upper;
+
+		bool operator==(const SymmetryPlane& other) const
+		{
+			return axis == other.axis && position == other.position && antisymmetric == other.antisymmetric && upper == other.upper;
+		}
+	};
 private:
 	//Keep reference to a space mesh
 	MeshSharedPtr m_pMeshGeometry;
@@ -40,6 +55,50 @@ private:
 	data_vector _data; //Field data itself
 	node_types_list _node_types; //Types of a field nodes, true if it is inner point and false if it is a boundary
 	BoundaryValues m_boundaryFieldVals;
+	std::vector<uint32_t> m_changedLabels; //Nodes changed by boundary conditions since the last relaxation
+	std::vector<bool> m_changedFlags; //Marks the nodes of m_changedLabels, so every node is listed once
+
+	std::vector<SymmetryPlane> m_symmetryPlanes;
+
+	//Revision of the last add_boundary or set_boundary_type call changing the conditions of every node,
+	//nodes leaving a patch get the revision too. Operators keep the revision they were built for
+	std::vector<size_t> m_nodeRevisions;
+	size_t m_boundaryRevision;
+
+	//Owner of the tag of the current values, a copied field gets a new tag
+	struct ValuesTag
+	{
+		std::shared_ptr<const void> p;
+
+		ValuesTag() : p(std::make_shared<char>(0)) {}
+		ValuesTag(const ValuesTag&) : ValuesTag() {}
+		ValuesTag& operator=(const ValuesTag&) { p = std::make_shared<char>(0); return *this; }
+	};
+	ValuesTag m_valuesTag;
+
+	//Adds a node to the changed nodes unless it is already there
+	void markChanged(uint32_t l)
+	{
+		if (m_changedFlags[l]) return;
+		m_changedFlags[l] = true;
+		m_changedLabels.push_back(l);
+	}
+
+	//Returns the changed nodes and clears them
+	std::vector<uint32_t> takeChanged()
+	{
+		for (uint32_t l : m_changedLabels) m_changedFlags[l] = false;
+		std::vector<uint32_t> result;
+		result.swap(m_changedLabels);
+		return result;
+	}
+
+	//Makes own copy of the boundary mesh if it is shared with other fields or operators
+	void detachBoundary()
+	{
+		if (m_pBoundaryMesh.use_count() > 1)
+			m_pBoundaryMesh.reset(new BoundaryMesh(*m_pBoundaryMesh));
+	}
 public:
 	/**
 	 * Creates zero filled field
@@ -49,15 +108,41 @@ public:
 		m_pMeshGeometry(meshGeometry),
 		m_pBoundaryMesh(new BoundaryMesh(meshGeometry->createBoundary())),
 		_data(m_pMeshGeometry->size(), field_type(0.0)),
-		_node_types(m_pMeshGeometry->size(), true)
+		_node_types(m_pMeshGeometry->size(), true),
+		m_changedFlags(m_pMeshGeometry->size(), false),
+		m_nodeRevisions(m_pMeshGeometry->size(), 0),
+		m_boundaryRevision(0)
 	{}
 
+	//Copy shares the boundary mesh with the original field until one of them changes its boundaries
+	field(const field& other) = default;
+	field(field&& other) = default;
+
 	const data_vector& data() const { return _data; }
 	data_vector& data() { return _data; }
 
+	//Returns space mesh of the field
+	const mesh_geom& mesh() const { return *m_pMeshGeometry; }
+
+	//Returns boundary conditions of the field
+	const BoundaryMesh& boundary() const { return *m_pBoundaryMesh; }
+
 	//Returns field data size
 	size_t size() const { return _data.size(); }
 
+	//Returns labels of nodes changed by boundary conditions since the last relaxation
+	const std::vector<uint32_t>& changed_labels() const { return m_changedLabels; }
+
+	//Forgets the changed nodes, an operator applied to all nodes takes their changes
+	void clear_changed() { takeChanged(); }
+
+	//Tag of the current values, it expires when the values are written by anything but boundary conditions
+	//or the field is destroyed, so holders of values derived from the field can tell them stale
+	std::weak_ptr<const void> values_tag() const { return m_valuesTag.p; }
+
+	//Replaces the values tag, called by everything writing the values except boundary conditions
+	void touch_values() { m_valuesTag.p = std::make_shared<char>(0); }
+
 	/**
 	 * Adds new boundary to a field
 	 */
@@ -67,11 +152,26 @@ public:
 		const std::vector<vector3f>& vNormals
 	)
 	{
+		detachBoundary();
+		++m_boundaryRevision;
+		typename mesh_geom::label_list previous;
+		if (m_pBoundaryMesh->isBoundary(sName)) previous = m_pBoundaryMesh->boundaryLabels(sName);
 		m_pBoundaryMesh->addBoundary(sName, vLabels, vNormals);
+
+		//Nodes which left the patch need their rows rebuilt too
+		for (uint32_t l : previous)
+		{
+			m_nodeRevisions[l] = m_boundaryRevision;
+			_node_types[l] = !m_pBoundaryMesh->isBoundary(l);
+		}
 		std::map<uint32_t, field_type>& boundaryPatch = m_boundaryFieldVals[sName];
+		boundaryPatch.clear();
+		typename std::map<uint32_t, field_type>::iterator hint = boundaryPatch.begin();
 		for (uint32_t l : vLabels)
 		{
-			boundaryPatch[l] = field_type(0.0);
+			hint = boundaryPatch.insert(hint, std::make_pair(l, field_type(0.0)));
+			++hint;
+			m_nodeRevisions[l] = m_boundaryRevision;
 			_node_types[l] = false;
 		}
 	}
@@ -99,13 +199,86 @@ public:
 	 */
 	void set_boundary_type(const std::string& sName, BoundaryMesh::BoundaryType type)
 	{
+		detachBoundary();
 		m_pBoundaryMesh->boundaryType(sName, type);
+		++m_boundaryRevision;
+		for (uint32_t l : m_pBoundaryMesh->boundaryLabels(sName)) m_nodeRevisions[l] = m_boundaryRevision;
+	}
+
+	/**
+	 * Declares that the mesh covers one side of a mirror plane x[axis] = position of the full domain.
+	 * Field is even about a symmetric plane and odd about an antisymmetric one, so mesh nodes on the plane get
+	 * a boundary patch "symmetry_x", "_y" or "_z" with mirror or zero value conditions.
+	 * Interpolation reflects points from the other side of the plane and changes the sign for antisymmetric planes
+	 */
+	void add_symmetry_plane(int axis, double position, bool antisymmetric)
+	{
+		if (axis < 0 || axis > 2) throw std::runtime_error("field::add_symmetry_plane: Axis should be 0, 1 or 2.");
+		for (const SymmetryPlane& plane : m_symmetryPlanes)
+			if (plane.axis == axis) throw std::runtime_error("field::add_symmetry_plane: The axis already has a symmetry plane.");
+
+		const typename mesh_geom::box3D box = m_pMeshGeometry->box();
+		double extent = 0.0;
+		for (int k = 0; k < 3; ++k) extent = std::max(extent, box.second[k] - box.first[k]);
+		const double tolerance = 1e-9 * extent;
+		SymmetryPlane plane{ axis, position, antisymmetric, box.first[axis] >= position - tolerance };
+		if (!plane.upper && box.second[axis] > position + tolerance)
+			throw std::runtime_error("field::add_symmetry_plane: Mesh lies on both sides of the plane.");
+		m_symmetryPlanes.push_back(plane);
+
+		//Nodes on several planes get the normal pointing inside along all of them,
+		//nodes of other boundaries keep their normals
+		std::vector<uint32_t> labels;
+		std::vector<vector3f> normals;
+		for (uint32_t l = 0; l < size(); ++l)
+		{
+			const vector3f& r = m_pMeshGeometry->spacePositionOf(l);
+			if (std::fabs(r[axis] - position) > tolerance) continue;
+			labels.push_back(l);
+			if (m_pBoundaryMesh->isBoundary(l) && !m_pBoundaryMesh->isMirror(l))
+			{
+				normals.push_back(m_pBoundaryMesh->normal(l));
+				continue;
+			}
+			vector3f n{ 0.0, 0.0, 0.0 };
+			for (const SymmetryPlane& p : m_symmetryPlanes)
+				if (std::fabs(r[p.axis] - p.position) <= tolerance) n[p.axis] = p.upper ? 1.0 : -1.0;
+			normals.push_back((1.0 / std::sqrt(math::sqr(n))) * n);
+		}
+		if (labels.empty()) throw std::runtime_error("field::add_symmetry_plane: There are no mesh nodes on the plane.");
+
+		const std::string name = std::string("symmetry_") + "xyz"[axis];
+		add_boundary(name, labels, normals);
+		set_boundary_type(name, antisymmetric ? BoundaryMesh::FIXED_VAL : BoundaryMesh::MIRROR);
+	}
+
+	//Symmetry planes in the order they were added
+	const std::vector<SymmetryPlane>& symmetry_planes() const { return m_symmetryPlanes; }
+
+	/**
+	 * Reflects a point of the full domain into the mesh, returns -1 if the field changes its sign
+	 * after an odd number of reflections about antisymmetric planes and 1 otherwise
+	 */
+	double reflect(double& x, double& y, double& z) const
+	{
+		double sign = 1.0;
+		for (const SymmetryPlane& plane : m_symmetryPlanes)
+		{
+			double& c = plane.axis == 0 ? x : plane.axis == 1 ? y : z;
+			if (plane.upper ? c < plane.position : c > plane.position)
+			{
+				c = 2.0 * plane.position - c;
+				if (plane.antisymmetric) sign = -sign;
+			}
+		}
+		return sign;
 	}
 
 	//Applies boundary conditions to a mesh
 	//Puts averaged fixed values at FIXED_VAL boundary conditions and initializes ZERO_GRAD with zeros
 	void applyBoundaryConditions()
 	{
+		LS_PROFILE_SCOPE("field::applyBoundaryConditions");
 		for (const auto& boundaryLabel : *m_pBoundaryMesh)
 		{
 			int primaryCondition = 0;
@@ -116,6 +289,7 @@ public:
 				switch (m_pBoundaryMesh->boundaryType(name))
 				{
 				case BoundaryMesh::ZERO_GRAD:
+				case BoundaryMesh::MIRROR:
 					break;
 				case BoundaryMesh::FIXED_VAL:
 					primaryCondAcc += m_boundaryFieldVals[name][boundaryLabel.first];
@@ -125,10 +299,12 @@ public:
 					throw std::runtime_error("Field::applyBoundaryConditions : Unexpected boundary condition type.");
 				}
 			}
-			if (primaryCondition != 0)
-				_data[boundaryLabel.first] = primaryCondAcc / primaryCondition;
-			else
-				_data[boundaryLabel.first] = 0;
+			field_type val = primaryCondition != 0 ? primaryCondAcc / primaryCondition : field_type(0.0);
+			if (_data[boundaryLabel.first] != val)
+			{
+				_data[boundaryLabel.first] = val;
+				markChanged(boundaryLabel.first);
+			}
 		}
 	}
 
@@ -168,14 +344,27 @@ public:
 		return result / totalSqrDist;
 	}
 
+	/**
+	 * Puts diffused field values to the result vector, points are shared between the threads of the runner
+	 */
+	void diffuse(data_vector& result, const ParallelRunner& run = ParallelRunner()) const
+	{
+		LS_PROFILE_SCOPE("field::diffuse");
+		result.resize(_data.size());
+		parallelFor(run, 0, _data.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				result[i] = diffuse_one_point(static_cast<uint32_t>(i));
+		}, 4096);
+	}
+
 	/**
 	 * Returns diffused field
 	 */
 	field diffuse() const
 	{
 		field result(*this);
-		for (UINT i = 0; i < _data.size(); ++i)
-			result._data[i] = diffuse_one_point(i);
+		diffuse(result._data);
 		return result;
 	}
 
@@ -185,15 +374,64 @@ public:
 	 */
 	field_type interpolate(double x, double y, double z, uint32_t * track_label = nullptr) const
 	{
+		return interpolate(_data, x, y, z, track_label);
+	}
+
+	/**
+	 * Interpolates values given for every node of the field mesh, for instance a copy of the field data
+	 */
+	field_type interpolate(const data_vector& values, double x, double y, double z, uint32_t * track_label = nullptr) const
+	{
+		LS_PROFILE_SCOPE("field::interpolate");
 		uint32_t start_label = track_label ? *track_label : 0;
-		//track_info result = closest_plane_interpolation(x, y, z, start_label);
-		mesh_geom::InterpCoefs coefs = m_pMeshGeometry->interpCoefs(x, y, z, start_label);
+		const double sign = reflect(x, y, z);
+		mesh_geom::InterpStencil stencil = m_pMeshGeometry->interpStencil(x, y, z, start_label);
+
+		if (track_label) *track_label = stencil.labels[0];
+		return sign * stencil.apply(values);
+	}
 
-		if (track_label) *track_label = coefs.begin()->first;
-		return std::accumulate(coefs.begin(),coefs.end(),0.0,
-			[&](field_type val, mesh_geom::InterpCoef c)->field_type
+	/**
+	 * Interpolates values onto a regular lattice of nx*ny*nz points between corners lo and hi,
+	 * result of the point (i, j, k) is put to out[i + nx*(j + ny*k)].
+	 * Lattice rows are walked point by point, so every point search starts from the closest node of the previous point,
+	 * and every row starts from the closest node to the beginning of the previous row.
+	 * Slabs of constant k (or groups of rows of a 2D slice) are shared between the threads of the runner.
+	 * Every slab starts its search from the same node, so the result does not depend on the runner
+	 */
+	void resample(
+		const data_vector& values,
+		const vector3f& lo, const vector3f& hi,
+		size_t nx, size_t ny, size_t nz,
+		field_type* out,
+		const ParallelRunner& run = ParallelRunner()) const
+	{
+		LS_PROFILE_SCOPE("field::resample");
+		if (values.size() != size()) throw std::runtime_error("field::resample: Field and values sizes mismatch.");
+		auto coord = [&](int k, size_t i, size_t n)->double
+		{
+			return n > 1 ? lo[k] + (hi[k] - lo[k]) * static_cast<double>(i) / static_cast<double>(n - 1) : (lo[k] + hi[k]) / 2.0;
+		};
+		const size_t rowsPerChunk = nz > 1 ? ny : 16;
+		parallelBlocks(run, ny * nz, rowsPerChunk, [&](size_t block)
 		{
-			return val += _data[c.first] * c.second;
+			const size_t rowBegin = block * rowsPerChunk, rowEnd = std::min(rowBegin + rowsPerChunk, ny * nz);
+			uint32_t label = 0, rowStartLabel = 0;
+			for (size_t row = rowBegin; row < rowEnd; ++row)
+			{
+				const double y = coord(1, row % ny, ny), z = coord(2, row / ny, nz);
+				field_type* rowOut = out + row * nx;
+				label = rowStartLabel;
+				for (size_t i = 0; i < nx; ++i)
+				{
+					double px = coord(0, i, nx), py = y, pz = z;
+					const double sign = reflect(px, py, pz);
+					mesh_geom::InterpStencil stencil = m_pMeshGeometry->interpStencil(px, py, pz, label);
+					label = stencil.labels[0];
+					if (i == 0) rowStartLabel = label;
+					rowOut[i] = sign * stencil.apply(values);
+				}
+			}
 		});
 	}
 
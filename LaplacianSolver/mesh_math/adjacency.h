@@ -0,0 +1,149 @@
+#pragma once
+#ifndef _ADJACENCY_H_
+#define _ADJACENCY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "parallel.h"
+#include "profiler.h"
+
+/**
+ * Mesh connectivity in compressed sparse rows: neighbours of every node are stored contiguously in ascending order
+ */
+template<typename label>
+class adjacency
+{
+	std::vector<size_t> m_start;
+	std::vector<label> m_neighbours;
+public:
+	//Neighbours of a node
+	class range
+	{
+		const label* m_pBegin;
+		const label* m_pEnd;
+	public:
+		range(const label* pBegin, const label* pEnd) : m_pBegin(pBegin), m_pEnd(pEnd) {}
+
+		const label* begin() const { return m_pBegin; }
+		const label* end() const { return m_pEnd; }
+		size_t size() const { return m_pEnd - m_pBegin; }
+		bool empty() const { return m_pBegin == m_pEnd; }
+	};
+
+	//Edge given by labels packed as (smaller << 32) | larger
+	using edge_key = uint64_t;
+
+	static edge_key key(label l1, label l2)
+	{
+		return l1 < l2 ? uint64_t(l1) << 32 | l2 : uint64_t(l2) << 32 | l1;
+	}
+
+	//Creates graph of nNodes nodes without edges
+	explicit adjacency(size_t nNodes = 0) : m_start(nNodes + 1, 0) {}
+
+	/**
+	 * Creates graph of nNodes nodes from edge keys, the keys can repeat and come in any order.
+	 * Edges connecting a node with itself are dropped
+	 */
+	static adjacency fromEdges(const std::vector<edge_key>& edges, size_t nNodes, const ParallelRunner& run = ParallelRunner())
+	{
+		LS_PROFILE_SCOPE("adjacency::fromEdges");
+		//Edges are sorted by their smaller node with a counting sort, so every node gets a bucket of its larger neighbours
+		std::vector<size_t> bucketStart(nNodes + 1, 0);
+		for (edge_key e : edges)
+		{
+			const size_t l1 = e >> 32, l2 = e & 0xffffffff;
+			if (l2 >= nNodes) throw std::runtime_error("adjacency::fromEdges: Node label is out of range.");
+			if (l1 != l2) ++bucketStart[l1 + 1];
+		}
+		for (size_t i = 0; i < nNodes; ++i) bucketStart[i + 1] += bucketStart[i];
+		std::vector<label> buckets(bucketStart[nNodes]);
+		std::vector<size_t> pos(bucketStart.begin(), bucketStart.end() - 1);
+		for (edge_key e : edges)
+		{
+			const label l1 = static_cast<label>(e >> 32), l2 = static_cast<label>(e & 0xffffffff);
+			if (l1 != l2) buckets[pos[l1]++] = l2;
+		}
+
+		//Buckets are short, they are sorted and cleared of repeated edges in parallel
+		std::vector<size_t> bucketSize(nNodes);
+		parallelFor(run, 0, nNodes, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				label* first = buckets.data() + bucketStart[i];
+				std::sort(first, buckets.data() + bucketStart[i + 1]);
+				bucketSize[i] = std::unique(first, buckets.data() + bucketStart[i + 1]) - first;
+			}
+		}, 1 << 14);
+
+		adjacency result(nNodes);
+		for (size_t i = 0; i < nNodes; ++i)
+			for (size_t k = bucketStart[i]; k < bucketStart[i] + bucketSize[i]; ++k)
+			{
+				++result.m_start[i + 1];
+				++result.m_start[buckets[k] + 1];
+			}
+		for (size_t i = 0; i < nNodes; ++i) result.m_start[i + 1] += result.m_start[i];
+
+		//Smaller neighbours of every node are met before its own bucket, so the lists come out sorted
+		result.m_neighbours.resize(result.m_start[nNodes]);
+		pos.assign(result.m_start.begin(), result.m_start.end() - 1);
+		for (size_t i = 0; i < nNodes; ++i)
+			for (size_t k = bucketStart[i]; k < bucketStart[i] + bucketSize[i]; ++k)
+			{
+				result.m_neighbours[pos[i]++] = buckets[k];
+				result.m_neighbours[pos[buckets[k]]++] = static_cast<label>(i);
+			}
+		return result;
+	}
+
+	//Number of nodes
+	size_t size() const { return m_start.size() - 1; }
+
+	//Number of edges
+	size_t connectionsNum() const { return m_neighbours.size() / 2; }
+
+	range getNeighbour(label l) const
+	{
+		return range(m_neighbours.data() + m_start[l], m_neighbours.data() + m_start[l + 1]);
+	}
+
+	//Calls V(i, j) once for every edge, i < j
+	template<typename visitor>
+	void iterateOverUniqueConnections(visitor V) const
+	{
+		for (size_t i = 0; i < size(); ++i)
+			for (size_t k = m_start[i]; k < m_start[i + 1]; ++k)
+				if (m_neighbours[k] > i) V(i, static_cast<size_t>(m_neighbours[k]));
+	}
+
+	/**
+	 * Breadth first search from the start node, V(l) is called once for every reached node
+	 * and the search continues from the node only if it returns true
+	 */
+	template<typename visitor>
+	void bfs_iterative(label start, visitor V) const
+	{
+		//Searches are local, so visited nodes are kept in a set instead of a mark for every node
+		std::unordered_set<label> visited;
+		std::queue<label> front;
+		visited.insert(start);
+		front.push(start);
+		while (!front.empty())
+		{
+			const label l = front.front();
+			front.pop();
+			for (label ll : getNeighbour(l))
+				if (visited.insert(ll).second && V(ll)) front.push(ll);
+		}
+	}
+};
+
+#endif // !_ADJACENCY_H_
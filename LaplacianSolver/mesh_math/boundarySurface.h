@@ -0,0 +1,207 @@
+#pragma once
+#ifndef _BOUNDARY_SURFACE_H_
+#define _BOUNDARY_SURFACE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <linearAlgebra\vectorTemplate.h>
+
+#include "parallel.h"
+#include "profiler.h"
+
+/**
+ * Exterior surface of a volume mesh: faces of elements not shared with other elements
+ * and area weighted normals of the surface nodes pointing inside the mesh
+ */
+template<typename label>
+class boundary_surface
+{
+public:
+	enum element_type { TET, PYR, WEDGE, HEXA };
+
+	using vector3f = math::vector_c<double, 3>;
+
+	//Volume elements of every type, nodes of an element follow each other, NULL for missing types
+	struct volume_elements
+	{
+		const std::vector<label>* lists[HEXA + 1];
+	};
+
+private:
+	std::vector<label> m_faces; //Four nodes of every face, triangles repeat their last node
+	std::vector<vector3f> m_normals; //Unit normals of nodes, zero for nodes out of the surface
+
+	static size_t elementNodes(int type)
+	{
+		static const size_t nodes[] = { 4, 5, 6, 8 };
+		return nodes[type];
+	}
+
+	static size_t elementFaces(int type)
+	{
+		static const size_t faces[] = { 4, 5, 5, 6 };
+		return faces[type];
+	}
+
+	//Local nodes of the face of an element, triangles repeat their last node
+	static const unsigned char* faceNodes(int type, size_t face)
+	{
+		static const unsigned char nodes[][6][4] =
+		{
+			{ { 0, 1, 2, 2 }, { 0, 1, 3, 3 }, { 1, 2, 3, 3 }, { 0, 2, 3, 3 } },
+			{ { 0, 1, 2, 3 }, { 0, 1, 4, 4 }, { 1, 2, 4, 4 }, { 2, 3, 4, 4 }, { 3, 0, 4, 4 } },
+			{ { 0, 1, 2, 2 }, { 3, 4, 5, 5 }, { 0, 1, 4, 3 }, { 1, 2, 5, 4 }, { 2, 0, 3, 5 } },
+			{ { 0, 1, 2, 3 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 }, { 1, 2, 6, 5 }, { 2, 3, 7, 6 }, { 3, 0, 4, 7 } }
+		};
+		return nodes[type][face];
+	}
+
+	//Face of an element with its nodes sorted, the smallest node is the bucket of the face
+	struct FaceRef
+	{
+		label others[3];
+		uint64_t elementFace; //(element << 3) | face, elements of all types are numbered one after another
+	};
+
+public:
+	boundary_surface() {}
+
+	/**
+	 * Finds faces met once among the faces of all elements. Element nodes are converted by labelOf(l)
+	 * to labels of the node positions np. Faces are generated and matched by the threads of the runner
+	 */
+	template<typename node_positions, typename label_map>
+	static boundary_surface fromElements(const volume_elements& elements, const node_positions& np,
+		label_map labelOf, const ParallelRunner& run = ParallelRunner())
+	{
+		LS_PROFILE_SCOPE("boundary_surface::fromElements");
+		const size_t nNodes = np.size();
+		size_t elementOffset[HEXA + 2] = { 0 }, faceOffset[HEXA + 2] = { 0 };
+		for (int type = TET; type <= HEXA; ++type)
+		{
+			const size_t n = elements.lists[type] ? elements.lists[type]->size() / elementNodes(type) : 0;
+			elementOffset[type + 1] = elementOffset[type] + n;
+			faceOffset[type + 1] = faceOffset[type] + n * elementFaces(type);
+		}
+		auto elementType = [&](uint64_t element)->int
+		{
+			int type = TET;
+			while (element >= elementOffset[type + 1]) ++type;
+			return type;
+		};
+		auto nodeOf = [&](uint64_t elementFace, size_t k)->label
+		{
+			const uint64_t element = elementFace >> 3;
+			const int type = elementType(element);
+			const label* nodes = elements.lists[type]->data() + (element - elementOffset[type]) * elementNodes(type);
+			return labelOf(nodes[faceNodes(type, elementFace & 7)[k]]);
+		};
+
+		//Every element writes its faces to its own place
+		std::vector<label> firstNode(faceOffset[HEXA + 1]);
+		std::vector<FaceRef> faces(faceOffset[HEXA + 1]);
+		for (int type = TET; type <= HEXA; ++type)
+			parallelFor(run, elementOffset[type], elementOffset[type + 1], [&](size_t begin, size_t end)
+			{
+				for (size_t e = begin; e < end; ++e)
+					for (size_t f = 0; f < elementFaces(type); ++f)
+					{
+						const size_t i = faceOffset[type] + (e - elementOffset[type]) * elementFaces(type) + f;
+						//Triangles take the largest label as the fourth node, so both sides of a face get the same key
+						const bool triangle = faceNodes(type, f)[2] == faceNodes(type, f)[3];
+						label sorted[4];
+						for (size_t k = 0; k < 4; ++k) sorted[k] = triangle && k == 3 ? static_cast<label>(-1) : nodeOf(e << 3 | f, k);
+						std::sort(sorted, sorted + 4);
+						firstNode[i] = sorted[0];
+						std::copy(sorted + 1, sorted + 4, faces[i].others);
+						faces[i].elementFace = e << 3 | f;
+					}
+			}, 1 << 12);
+
+		//Faces are sorted by their smallest node with a counting sort as edges of adjacency
+		std::vector<size_t> bucketStart(nNodes + 1, 0);
+		for (label l : firstNode) ++bucketStart[l + 1];
+		for (size_t i = 0; i < nNodes; ++i) bucketStart[i + 1] += bucketStart[i];
+		std::vector<FaceRef> buckets(faces.size());
+		{
+			std::vector<size_t> pos(bucketStart.begin(), bucketStart.end() - 1);
+			for (size_t i = 0; i < faces.size(); ++i) buckets[pos[firstNode[i]]++] = faces[i];
+		}
+		std::vector<FaceRef>().swap(faces);
+		std::vector<label>().swap(firstNode);
+
+		//Faces met once in their bucket are exterior
+		std::vector<unsigned char> exterior(buckets.size(), 0);
+		parallelFor(run, 0, nNodes, [&](size_t begin, size_t end)
+		{
+			auto less = [](const FaceRef& f1, const FaceRef& f2)->bool
+			{
+				return std::lexicographical_compare(f1.others, f1.others + 3, f2.others, f2.others + 3);
+			};
+			for (size_t b = begin; b < end; ++b)
+			{
+				FaceRef* first = buckets.data() + bucketStart[b], *last = buckets.data() + bucketStart[b + 1];
+				std::sort(first, last, less);
+				for (FaceRef* f = first; f != last;)
+				{
+					FaceRef* next = f + 1;
+					while (next != last && !less(*f, *next)) ++next;
+					if (next - f == 1) exterior[f - buckets.data()] = 1;
+					f = next;
+				}
+			}
+		}, 1 << 14);
+
+		//Face normals point to the centre of their element
+		boundary_surface result;
+		result.m_normals.assign(nNodes, vector3f{ 0.0, 0.0, 0.0 });
+		for (size_t i = 0; i < buckets.size(); ++i)
+		{
+			if (!exterior[i]) continue;
+			const uint64_t elementFace = buckets[i].elementFace;
+			label nodes[4];
+			for (size_t k = 0; k < 4; ++k) nodes[k] = nodeOf(elementFace, k);
+			result.m_faces.insert(result.m_faces.end(), nodes, nodes + 4);
+
+			const uint64_t element = elementFace >> 3;
+			const int type = elementType(element);
+			const label* elementLabels = elements.lists[type]->data() + (element - elementOffset[type]) * elementNodes(type);
+			vector3f centre{ 0.0, 0.0, 0.0 }, faceCentre{ 0.0, 0.0, 0.0 };
+			for (size_t k = 0; k < elementNodes(type); ++k) centre = centre + np[labelOf(elementLabels[k])];
+			for (size_t k = 0; k < 4; ++k) faceCentre = faceCentre + np[nodes[k]];
+			centre = (1.0 / elementNodes(type)) * centre;
+			faceCentre = 0.25 * faceCentre;
+
+			//Doubled area vector of a quadrangle or a triangle with the repeated last node
+			const vector3f d1 = np[nodes[2]] - np[nodes[0]], d2 = np[nodes[3]] - np[nodes[1]];
+			vector3f area{ d1[1] * d2[2] - d1[2] * d2[1], d1[2] * d2[0] - d1[0] * d2[2], d1[0] * d2[1] - d1[1] * d2[0] };
+			const vector3f inside = centre - faceCentre;
+			if (area * inside < 0.0) area = -1.0 * area;
+			for (size_t k = 0; k < 4; ++k)
+				if (k == 0 || nodes[k] != nodes[k - 1]) result.m_normals[nodes[k]] = result.m_normals[nodes[k]] + area;
+		}
+		parallelFor(run, 0, nNodes, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				vector3f& n = result.m_normals[i];
+				const double norm = math::abs(n);
+				if (norm > 0.0) n = (1.0 / norm) * n;
+			}
+		}, 1 << 14);
+		return result;
+	}
+
+	//Number of exterior faces
+	size_t size() const { return m_faces.size() / 4; }
+
+	//Four nodes of the face i, triangles repeat their last node
+	const label* face(size_t i) const { return m_faces.data() + 4 * i; }
+
+	//Unit normal of the node pointing inside the mesh, zero if the node is not on the surface
+	const vector3f& normal(label l) const { return m_normals[l]; }
+};
+
+#endif // !_BOUNDARY_SURFACE_H_
@@ -0,0 +1,238 @@
+#pragma once
+#ifndef _COMPRESSED_OPERATOR_H_
+#define _COMPRESSED_OPERATOR_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "fieldOperator.h"
+
+/**
+ * Sparse matrix with compressed column labels. Every row keeps the number of its elements and differences
+ * of the consecutive column labels starting from the row label, they are zigzag encoded and written
+ * in 7 bit groups, so after a locality reordering most of labels take one byte. Coefficients are kept
+ * in doubles or, optionally, quantized to floats. Rows are grouped in blocks with known offsets
+ * which are decoded in parallel
+ */
+class CompressedLinearOp
+{
+	using data_vector = std::vector<double>;
+
+public:
+	//Row elements as (column, coefficient) pairs sorted by columns, the same as FieldLinearOp::MatrixRow
+	using matrix_row = std::vector<std::pair<uint32_t, double>>;
+
+private:
+
+	//Number of rows in a block, flags of its identity rows fill one word
+	static const size_t s_blockRows = 64;
+	static_assert(s_blockRows <= 64, "Identity flags of a block should fit in a word.");
+
+	//Number of blocks in a chunk of parallel loops
+	static const size_t s_blocksPerChunk = 64;
+
+	size_t m_size;
+	std::vector<size_t> m_blockByte; //Position of every block in m_bytes, the last one is the size of m_bytes
+	std::vector<size_t> m_blockElem; //Position of the first coefficient of every block
+	std::vector<uint8_t> m_bytes;
+	std::vector<double> m_coefs;
+	std::vector<float> m_floatCoefs;
+	std::vector<uint64_t> m_identityRows; //Bit i % s_blockRows of the word of the block is set for identity rows
+	ParallelRunner m_run;
+
+	static size_t writeNumber(uint64_t val, uint8_t* out)
+	{
+		size_t n = 0;
+		for (; val >= 0x80; val >>= 7)
+		{
+			if (out) out[n] = static_cast<uint8_t>(val | 0x80);
+			++n;
+		}
+		if (out) out[n] = static_cast<uint8_t>(val);
+		return n + 1;
+	}
+
+	static uint64_t readNumber(const uint8_t*& p)
+	{
+		uint64_t val = *p++;
+		if (val < 0x80) return val;
+		val &= 0x7f;
+		for (unsigned shift = 7;; shift += 7)
+		{
+			const uint64_t b = *p++;
+			val |= (b & 0x7f) << shift;
+			if (b < 0x80) return val;
+		}
+	}
+
+	//Appends the encoded row i with sorted column labels
+	static void encodeRow(size_t i, const matrix_row& row, std::vector<uint8_t>& out)
+	{
+		uint8_t buf[10];
+		out.insert(out.end(), buf, buf + writeNumber(row.size(), buf));
+		int64_t prev = static_cast<int64_t>(i);
+		for (const auto& e : row)
+		{
+			const int64_t diff = static_cast<int64_t>(e.first) - prev;
+			out.insert(out.end(), buf, buf + writeNumber(static_cast<uint64_t>(diff) << 1 ^ static_cast<uint64_t>(diff >> 63), buf));
+			prev = e.first;
+		}
+	}
+
+	//Calls V(i, (Ax)_i) for the rows of a block, the sum goes in the order of the original row
+	template<typename coef_type, typename visitor>
+	void blockProduct(size_t block, const coef_type* coefs, const data_vector& x, visitor V) const
+	{
+		const uint8_t* p = m_bytes.data() + m_blockByte[block];
+		coefs += m_blockElem[block];
+		const size_t end = std::min((block + 1) * s_blockRows, m_size);
+		for (size_t i = block * s_blockRows; i < end; ++i)
+		{
+			size_t n = static_cast<size_t>(readNumber(p));
+			int64_t col = static_cast<int64_t>(i);
+			double val = 0.0;
+			for (; n != 0; --n)
+			{
+				const uint64_t z = readNumber(p);
+				col += static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+				val += x[static_cast<size_t>(col)] * static_cast<double>(*coefs++);
+			}
+			V(i, val);
+		}
+	}
+
+	//Visits elements of the row i
+	template<typename visitor>
+	void visitRow(size_t i, visitor V) const
+	{
+		const size_t block = i / s_blockRows;
+		const uint8_t* p = m_bytes.data() + m_blockByte[block];
+		size_t k = m_blockElem[block];
+		for (size_t j = block * s_blockRows;; ++j)
+		{
+			size_t n = static_cast<size_t>(readNumber(p));
+			int64_t col = static_cast<int64_t>(j);
+			for (; n != 0; --n, ++k)
+			{
+				const uint64_t z = readNumber(p);
+				col += static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+				if (j == i) V(static_cast<size_t>(col), m_floatCoefs.empty() ? m_coefs[k] : m_floatCoefs[k]);
+			}
+			if (j == i) return;
+		}
+	}
+
+public:
+	/**
+	 * Compresses the n x n matrix with the rows assembled by rowOf(i, row). Rows are encoded as soon as they are assembled,
+	 * so the uncompressed matrix is never kept. Chunks of blocks are encoded in parallel and then joined in order
+	 */
+	template<typename row_assembler>
+	CompressedLinearOp(size_t n, row_assembler rowOf, bool floatCoefs, const ParallelRunner& run = ParallelRunner())
+		:
+		m_size(n),
+		m_run(run)
+	{
+		LS_PROFILE_SCOPE("CompressedLinearOp::compress");
+		struct Chunk
+		{
+			std::vector<size_t> blockByte, blockElem; //Sizes of the blocks
+			std::vector<uint8_t> bytes;
+			std::vector<double> coefs;
+			std::vector<float> floatCoefs;
+		};
+		const size_t nBlocks = (m_size + s_blockRows - 1) / s_blockRows;
+		const size_t chunkRows = s_blockRows * s_blocksPerChunk;
+		std::vector<Chunk> chunks((m_size + chunkRows - 1) / chunkRows);
+		m_identityRows.assign(nBlocks, 0);
+		parallelBlocks(m_run, m_size, chunkRows, [&](size_t c)
+		{
+			Chunk& chunk = chunks[c];
+			matrix_row row;
+			for (size_t block = c * s_blocksPerChunk; block < std::min((c + 1) * s_blocksPerChunk, nBlocks); ++block)
+			{
+				const size_t bytesBefore = chunk.bytes.size(), elemsBefore = chunk.coefs.size() + chunk.floatCoefs.size();
+				for (size_t i = block * s_blockRows; i < std::min((block + 1) * s_blockRows, m_size); ++i)
+				{
+					rowOf(static_cast<uint32_t>(i), row);
+					encodeRow(i, row, chunk.bytes);
+					//Every block has its own word, so chunks set the bits without races
+					if (row.size() == 1 && row[0].first == i && row[0].second == 1.0)
+						m_identityRows[block] |= uint64_t(1) << (i % s_blockRows);
+					for (const auto& e : row)
+						if (floatCoefs) chunk.floatCoefs.push_back(static_cast<float>(e.second));
+						else chunk.coefs.push_back(e.second);
+				}
+				chunk.blockByte.push_back(chunk.bytes.size() - bytesBefore);
+				chunk.blockElem.push_back(chunk.coefs.size() + chunk.floatCoefs.size() - elemsBefore);
+			}
+		});
+
+		m_blockByte.assign(1, 0);
+		m_blockElem.assign(1, 0);
+		m_blockByte.reserve(nBlocks + 1);
+		m_blockElem.reserve(nBlocks + 1);
+		size_t nBytes = 0, nElems = 0;
+		for (const Chunk& chunk : chunks)
+		{
+			nBytes += chunk.bytes.size();
+			nElems += chunk.coefs.size() + chunk.floatCoefs.size();
+		}
+		m_bytes.reserve(nBytes);
+		if (floatCoefs) m_floatCoefs.reserve(nElems);
+		else m_coefs.reserve(nElems);
+		LS_PROFILE_ALLOC(nBytes);
+		LS_PROFILE_ALLOC(nElems * (floatCoefs ? sizeof(float) : sizeof(double)));
+		for (Chunk& chunk : chunks)
+		{
+			for (size_t b : chunk.blockByte) m_blockByte.push_back(m_blockByte.back() + b);
+			for (size_t k : chunk.blockElem) m_blockElem.push_back(m_blockElem.back() + k);
+			m_bytes.insert(m_bytes.end(), chunk.bytes.begin(), chunk.bytes.end());
+			m_coefs.insert(m_coefs.end(), chunk.coefs.begin(), chunk.coefs.end());
+			m_floatCoefs.insert(m_floatCoefs.end(), chunk.floatCoefs.begin(), chunk.floatCoefs.end());
+			chunk = Chunk();
+		}
+	}
+
+	//Sets the runner of matrix products, an empty one makes them serial
+	void setRunner(const ParallelRunner& run) { m_run = run; }
+
+	//Gets the size of a field
+	size_t size() const { return m_size; }
+
+	//Gets the number of stored matrix elements
+	size_t nonZeros() const { return m_blockElem.back(); }
+
+	//Memory taken by the matrix
+	size_t memoryBytes() const
+	{
+		return (m_blockByte.size() + m_blockElem.size()) * sizeof(size_t) + m_bytes.size()
+			+ m_coefs.size() * sizeof(double) + m_floatCoefs.size() * sizeof(float) + m_identityRows.size() * sizeof(uint64_t);
+	}
+
+	//Calls V(i, (Ax)_i) for every row i, blocks of rows are shared between the threads of the runner
+	template<typename visitor>
+	void product(const data_vector& x, visitor V) const
+	{
+		LS_PROFILE_SCOPE("CompressedLinearOp::product");
+		if (x.size() != m_size) throw std::runtime_error("CompressedLinearOp::product: "
+			"Field and operator sizes mismatch.");
+		const size_t nBlocks = m_blockByte.size() - 1;
+		parallelFor(m_run, 0, nBlocks, [&](size_t begin, size_t end)
+		{
+			for (size_t block = begin; block < end; ++block)
+				if (m_floatCoefs.empty()) blockProduct(block, m_coefs.data(), x, V);
+				else blockProduct(block, m_floatCoefs.data(), x, V);
+		}, s_blocksPerChunk);
+	}
+
+	//Checks if the row i keeps a node value unchanged, e.g. a fixed value boundary
+	bool isIdentityRow(size_t i) const
+	{
+		return (m_identityRows[i / s_blockRows] >> (i % s_blockRows) & 1) != 0;
+	}
+};
+
+#endif // !_COMPRESSED_OPERATOR_H_
@@ -0,0 +1,238 @@
+#pragma once
+#ifndef _CONDENSED_OPERATOR_H_
+#define _CONDENSED_OPERATOR_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "fieldOperator.h"
+
+/**
+ * Operator restricted to the nodes it changes. Identity rows of fixed value nodes are dropped, the other nodes
+ * (unknowns) get compact labels in the order of mesh labels and their rows are split into the matrix of unknowns
+ * and the coupling to fixed nodes. Iterations x = Ax + b run on unknowns only, b gathers the coupling
+ * with the fixed values, changed fixed values recompute only the elements of b of the unknowns using them
+ */
+class CondensedLinearOp
+{
+	using data_vector = std::vector<double>;
+
+	//Number of rows in a chunk of parallel loops
+	static const size_t s_rowsPerChunk = 4096;
+
+	size_t m_size; //Size of the full field
+	std::vector<uint32_t> m_unknowns; //Mesh labels of unknowns
+
+	//Matrix of unknowns in compact labels
+	std::vector<size_t> m_rowStart;
+	std::vector<uint32_t> m_cols;
+	std::vector<double> m_coefs;
+
+	//Coupling of unknowns to fixed nodes in mesh labels
+	std::vector<size_t> m_fixedStart;
+	std::vector<uint32_t> m_fixedCols;
+	std::vector<double> m_fixedCoefs;
+
+	//Fixed nodes coupled to unknowns in the order of mesh labels and the unknowns using every one of them
+	std::vector<uint32_t> m_coupled;
+	std::vector<size_t> m_usersStart;
+	std::vector<uint32_t> m_users;
+
+	ParallelRunner m_run;
+
+	//Element of b of the unknown k for the fixed values of the full field data
+	double rhsRow(size_t k, const data_vector& x) const
+	{
+		double val = 0.0;
+		for (size_t j = m_fixedStart[k]; j < m_fixedStart[k + 1]; ++j) val += x[m_fixedCols[j]] * m_fixedCoefs[j];
+		return val;
+	}
+
+	void checkSize(const data_vector& x, const char* method) const
+	{
+		if (x.size() != m_size) throw std::runtime_error(std::string("CondensedLinearOp::") + method + ":"
+			"Field and operator sizes mismatch.");
+	}
+
+public:
+	//Splits the matrix A, it should provide size(), isIdentityRow(i) and visitRow(i, V) as FieldLinearOp
+	template<typename matrix>
+	CondensedLinearOp(const matrix& A, const ParallelRunner& run = ParallelRunner())
+		:
+		m_size(A.size()),
+		m_run(run)
+	{
+		LS_PROFILE_SCOPE("CondensedLinearOp::condense");
+		const uint32_t fixed = static_cast<uint32_t>(-1);
+		std::vector<uint32_t> compact(m_size, fixed);
+		for (uint32_t i = 0; i < m_size; ++i)
+			if (!A.isIdentityRow(i))
+			{
+				compact[i] = static_cast<uint32_t>(m_unknowns.size());
+				m_unknowns.push_back(i);
+			}
+
+		m_rowStart.assign(1, 0);
+		m_fixedStart.assign(1, 0);
+		m_rowStart.reserve(m_unknowns.size() + 1);
+		m_fixedStart.reserve(m_unknowns.size() + 1);
+		for (uint32_t i : m_unknowns)
+		{
+			A.visitRow(i, [&](uint32_t col, double coef)
+			{
+				if (compact[col] != fixed)
+				{
+					m_cols.push_back(compact[col]);
+					m_coefs.push_back(coef);
+				}
+				else
+				{
+					m_fixedCols.push_back(col);
+					m_fixedCoefs.push_back(coef);
+				}
+			});
+			m_rowStart.push_back(m_cols.size());
+			m_fixedStart.push_back(m_fixedCols.size());
+		}
+
+		//The coupling is transposed with a counting sort, coupled fixed nodes get their compact labels in the unused entries of compact
+		std::vector<size_t> nUsers(m_size, 0);
+		for (uint32_t col : m_fixedCols) ++nUsers[col];
+		for (uint32_t l = 0; l < m_size; ++l)
+			if (nUsers[l] != 0)
+			{
+				compact[l] = static_cast<uint32_t>(m_coupled.size());
+				m_coupled.push_back(l);
+			}
+		m_usersStart.assign(m_coupled.size() + 1, 0);
+		for (size_t j = 0; j < m_coupled.size(); ++j) m_usersStart[j + 1] = m_usersStart[j] + nUsers[m_coupled[j]];
+		m_users.resize(m_fixedCols.size());
+		std::vector<size_t> pos(m_usersStart.begin(), m_usersStart.end() - 1);
+		for (uint32_t k = 0; k < m_unknowns.size(); ++k)
+			for (size_t j = m_fixedStart[k]; j < m_fixedStart[k + 1]; ++j) m_users[pos[compact[m_fixedCols[j]]]++] = k;
+	}
+
+	//Sets the runner of matrix products, an empty one makes them serial
+	void setRunner(const ParallelRunner& run) { m_run = run; }
+
+	//Gets the size of the full field
+	size_t size() const { return m_size; }
+
+	//Gets the number of unknowns
+	size_t unknowns() const { return m_unknowns.size(); }
+
+	//Visits elements of the row of the unknown k in compact labels, the coupling to fixed nodes is not visited
+	template<typename visitor>
+	void visitRow(uint32_t k, visitor V) const
+	{
+		for (size_t j = m_rowStart[k]; j < m_rowStart[k + 1]; ++j) V(m_cols[j], m_coefs[j]);
+	}
+
+	//Values of unknowns taken from the full field data
+	data_vector gather(const data_vector& x) const
+	{
+		checkSize(x, "gather");
+		data_vector result(m_unknowns.size());
+		LS_PROFILE_ALLOC(result.size() * sizeof(double));
+		for (size_t k = 0; k < m_unknowns.size(); ++k) result[k] = x[m_unknowns[k]];
+		return result;
+	}
+
+	//Puts values of unknowns back to the full field data
+	void scatter(const data_vector& xI, data_vector& x) const
+	{
+		checkSize(x, "scatter");
+		for (size_t k = 0; k < m_unknowns.size(); ++k) x[m_unknowns[k]] = xI[k];
+	}
+
+	//Contribution of fixed values of the full field data to every unknown
+	data_vector rhs(const data_vector& x) const
+	{
+		checkSize(x, "rhs");
+		data_vector b(m_unknowns.size());
+		LS_PROFILE_ALLOC(b.size() * sizeof(double));
+		parallelFor(m_run, 0, m_unknowns.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t k = begin; k < end; ++k) b[k] = rhsRow(k, x);
+		}, s_rowsPerChunk);
+		return b;
+	}
+
+	//Values of the fixed nodes coupled to unknowns taken from the full field data
+	data_vector coupledValues(const data_vector& x) const
+	{
+		checkSize(x, "coupledValues");
+		data_vector result(m_coupled.size());
+		LS_PROFILE_ALLOC(result.size() * sizeof(double));
+		for (size_t j = 0; j < m_coupled.size(); ++j) result[j] = x[m_coupled[j]];
+		return result;
+	}
+
+	/**
+	 * Brings b = rhs(x) up to date with the fixed values of the full field data, values are the coupled fixed values
+	 * b was computed for, they are updated too. Only the elements of the unknowns using changed values are recomputed.
+	 * Returns the number of changed fixed values
+	 */
+	size_t updateRhs(const data_vector& x, data_vector& values, data_vector& b) const
+	{
+		checkSize(x, "updateRhs");
+		size_t nChanged = 0;
+		for (size_t j = 0; j < m_coupled.size(); ++j)
+		{
+			if (x[m_coupled[j]] == values[j]) continue;
+			values[j] = x[m_coupled[j]];
+			for (size_t u = m_usersStart[j]; u < m_usersStart[j + 1]; ++u) b[m_users[u]] = rhsRow(m_users[u], x);
+			++nChanged;
+		}
+		return nChanged;
+	}
+
+	//Calls V(k, (A xI)_k + b_k) for every unknown k, b can be empty, rows are shared between the threads of the runner
+	template<typename visitor>
+	void product(const data_vector& xI, const data_vector& b, visitor V) const
+	{
+		LS_PROFILE_SCOPE("CondensedLinearOp::product");
+		parallelFor(m_run, 0, m_unknowns.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t k = begin; k < end; ++k)
+			{
+				double val = b.empty() ? 0.0 : b[k];
+				for (size_t j = m_rowStart[k]; j < m_rowStart[k + 1]; ++j) val += xI[m_cols[j]] * m_coefs[j];
+				V(k, val);
+			}
+		}, s_rowsPerChunk);
+	}
+
+	//Makes nIterations of xI = A xI + b on the values of unknowns, next is the scratch vector of the same size
+	void apply(data_vector& xI, const data_vector& b, size_t nIterations, data_vector& next) const
+	{
+		LS_PROFILE_SCOPE("CondensedLinearOp::apply");
+		next.resize(xI.size());
+		for (size_t it = 0; it < nIterations; ++it)
+		{
+			product(xI, b, [&](size_t k, double val) { next[k] = val; });
+			xI.swap(next);
+		}
+	}
+
+	//Chebyshev accelerated iteration of xI = A xI + b, the eigen values of the matrix of unknowns are supposed to lie in [-rho, rho]
+	void chebyshev(data_vector& xI, const data_vector& b, size_t nIterations, double rho) const
+	{
+		LS_PROFILE_SCOPE("CondensedLinearOp::chebyshev");
+		chebyshevIteration(xI, nIterations, rho,
+			[&](const data_vector& v, auto V) { product(v, b, V); });
+	}
+
+	//Estimates the spectral radius of the matrix of unknowns by power iterations
+	double spectralRadius(size_t nIterations = 30) const
+	{
+		LS_PROFILE_SCOPE("CondensedLinearOp::spectralRadius");
+		const data_vector noRhs;
+		return powerIteration(m_unknowns.size(), nIterations,
+			[&](const data_vector& v, auto V) { product(v, noRhs, V); },
+			[](size_t) { return false; });
+	}
+};
+
+#endif // !_CONDENSED_OPERATOR_H_
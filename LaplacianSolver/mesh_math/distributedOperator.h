@@ -0,0 +1,145 @@
+#pragma once
+#ifndef _DISTRIBUTED_OPERATOR_H_
+#define _DISTRIBUTED_OPERATOR_H_
+
+#include "fieldOperator.h"
+#include "meshPartition.h"
+
+/**
+ * Laplacian solver operator restricted to the owned nodes of a local mesh, it is the laplacian solver
+ * of the local field with the rows of ghost nodes left empty.
+ * Values of ghost nodes are exchanged with neighbour processes before every application
+ * transport should provide rank(), size(), send(dest, data, bytes), receive(src, data, bytes) and wait()
+ */
+template<typename field_type, typename transport>
+class DistributedOperator
+{
+public:
+	using Field = field<field_type>;
+	using data_vector = std::vector<field_type>;
+	using local_mesh_type = local_mesh<double, uint32_t>;
+
+private:
+	transport& m_transport;
+	size_t m_nOwned;
+	size_t m_nLocal;
+	FieldLinearOp<field_type> m_op; //Columns are local labels
+
+	//Nodes exchanged with a neighbour process
+	struct HaloPlan
+	{
+		int rank;
+		std::vector<uint32_t> send;    //owned nodes needed by the neighbour
+		std::vector<uint32_t> receive; //ghost nodes owned by the neighbour
+	};
+	std::vector<HaloPlan> m_halo;
+	mutable data_vector m_buffer;
+
+	//Agrees with other processes which ghost values each of them has to send
+	void setupHalo(const local_mesh_type& lm, const std::vector<bool>& needed)
+	{
+		const int nRanks = m_transport.size();
+		std::vector<std::vector<uint32_t>> requests(nRanks), receives(nRanks), sends(nRanks);
+		for (size_t l = m_nOwned; l < m_nLocal; ++l)
+			if (needed[l])
+			{
+				requests[lm.owners[l]].push_back(lm.globalLabels[l]);
+				receives[lm.owners[l]].push_back(static_cast<uint32_t>(l));
+			}
+
+		const std::vector<std::vector<uint32_t>> asked = exchangeAll(m_transport, requests);
+		std::string error;
+		for (int r = 0; r < nRanks; ++r)
+			for (uint32_t global : asked[r])
+			{
+				uint32_t local;
+				if (!lm.localLabel(global, local) || local >= m_nOwned)
+					error = "DistributedOperator::setupHalo: Requested node is not owned by the process.";
+				else sends[r].push_back(local);
+			}
+		throwIfAnyFailed(m_transport, error, "DistributedOperator::setupHalo");
+
+		for (int r = 0; r < nRanks; ++r)
+			if (!sends[r].empty() || !receives[r].empty())
+				m_halo.push_back(HaloPlan{ r, std::move(sends[r]), std::move(receives[r]) });
+	}
+
+public:
+	/**
+	 * Assembles owned rows of the laplacian solver of a local field
+	 * All processes should create their operators together
+	 */
+	DistributedOperator(transport& t, const local_mesh_type& lm, const Field& localField)
+		:
+		m_transport(t),
+		m_nOwned(lm.nOwned),
+		m_nLocal(lm.globalLabels.size()),
+		m_op(localField)
+	{
+		LS_PROFILE_SCOPE("DistributedOperator::DistributedOperator");
+		m_op.laplacianSolver(m_nOwned);
+		std::vector<bool> needed(m_nLocal, false);
+		for (uint32_t col : m_op.m_cols) needed[col] = true;
+		setupHalo(lm, needed);
+	}
+
+	//Number of owned nodes
+	size_t owned() const { return m_nOwned; }
+
+	//Number of owned and ghost nodes
+	size_t size() const { return m_nLocal; }
+
+	//Receives ghost values of x and calls V(i, (Ax)_i) for every owned row i
+	template<typename visitor>
+	void product(data_vector& x, visitor V) const
+	{
+		exchange(x);
+		for (size_t i = 0; i < m_nOwned; ++i) V(i, m_op.rowProduct(i, x));
+	}
+
+	//Updates ghost values of x from their owners
+	void exchange(data_vector& x) const
+	{
+		LS_PROFILE_SCOPE("DistributedOperator::exchange");
+		for (const HaloPlan& p : m_halo)
+		{
+			if (p.send.empty()) continue;
+			m_buffer.resize(p.send.size());
+			for (size_t k = 0; k < p.send.size(); ++k) m_buffer[k] = x[p.send[k]];
+			m_transport.send(p.rank, m_buffer.data(), m_buffer.size() * sizeof(field_type));
+		}
+		for (const HaloPlan& p : m_halo)
+		{
+			if (p.receive.empty()) continue;
+			m_buffer.resize(p.receive.size());
+			m_transport.receive(p.rank, m_buffer.data(), m_buffer.size() * sizeof(field_type));
+			for (size_t k = 0; k < p.receive.size(); ++k) x[p.receive[k]] = m_buffer[k];
+		}
+		m_transport.wait();
+	}
+
+	//Exchanges halo and applies operator to the owned values of x
+	void applyToField(data_vector& x) const
+	{
+		LS_PROFILE_SCOPE("DistributedOperator::applyToField");
+		if (x.size() != m_nLocal) throw
+			std::runtime_error("DistributedOperator::applyToField:"
+				"Field and operator sizes mismatch.");
+		data_vector result(m_nOwned);
+		LS_PROFILE_ALLOC(result.size() * sizeof(field_type));
+		product(x, [&](size_t i, field_type val) { result[i] = val; });
+		std::copy(result.begin(), result.end(), x.begin());
+	}
+
+	//Chebyshev accelerated iteration, see chebyshevIteration. Halo is exchanged once per step
+	void chebyshev(data_vector& x, size_t nIterations, double rho) const
+	{
+		LS_PROFILE_SCOPE("DistributedOperator::chebyshev");
+		if (x.size() != m_nLocal) throw
+			std::runtime_error("DistributedOperator::chebyshev:"
+				"Field and operator sizes mismatch.");
+		chebyshevIteration(x, nIterations, rho, [this](data_vector& values, auto V) { product(values, V); });
+	}
+};
+
+#endif // !_DISTRIBUTED_OPERATOR_H_
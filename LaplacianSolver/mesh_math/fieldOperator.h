@@ -2,10 +2,77 @@
 #ifndef _FIELD_OPERATOR_
 #define _FIELD_OPERATOR_
 
+#include <cmath>
+#include <deque>
+#include <unordered_map>
+
 #include "Field.h"
 
 //Implementation of basic field operations in the shape of linear transforamtions
 
+/**
+ * Estimates the spectral radius of an n x n matrix restricted to not fixed rows by power iterations,
+ * the estimate approaches the radius from below.
+ * product(v, V) calls V(i, (Av)_i) for every row i, possibly from several threads,
+ * isFixed(i) checks if the row i keeps a node value unchanged
+ */
+template<typename product, typename fixed_check>
+double powerIteration(size_t n, size_t nIterations, product P, fixed_check isFixed)
+{
+	std::vector<double> v(n), w(n);
+	LS_PROFILE_ALLOC(n * sizeof(double));
+	LS_PROFILE_ALLOC(n * sizeof(double));
+	//Deterministic pseudo random start vector, fixed nodes are zero and stay zero
+	uint32_t seed = 12345;
+	double norm = 0.0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		v[i] = isFixed(i) ? 0.0 : static_cast<double>(seed >> 8) / (1 << 24) - 0.5;
+		norm += v[i] * v[i];
+	}
+	double rho = 0.0;
+	for (size_t it = 0; it < nIterations && norm > 0.0; ++it)
+	{
+		norm = std::sqrt(norm);
+		for (size_t i = 0; i < n; ++i) v[i] /= norm;
+		P(static_cast<const std::vector<double>&>(v), [&](size_t i, double val) { w[i] = val; });
+		double wNorm = 0.0;
+		for (size_t i = 0; i < n; ++i) wNorm += w[i] * w[i];
+		rho = std::sqrt(wNorm);
+		v.swap(w);
+		norm = wNorm;
+	}
+	return rho;
+}
+
+/**
+ * Chebyshev accelerated iteration of x = Ax, the eigen values of A on not fixed nodes are supposed to lie in [-rho, rho].
+ * product(x, V) calls V(i, (Ax)_i) for every row i, possibly from several threads, no global reductions are needed.
+ * It may refresh the values of x it does not visit, e.g. ghost values of a distributed field
+ */
+template<typename data_vector, typename product>
+void chebyshevIteration(data_vector& x, size_t nIterations, double rho, product P)
+{
+	//Radius one gives no acceleration and makes the recurrence singular
+	rho = std::min(std::max(rho, 0.0), 1.0 - 1e-6);
+	data_vector prev(x);
+	LS_PROFILE_ALLOC(x.size() * sizeof(typename data_vector::value_type));
+
+	//x(k+1) = x(k-1) + omega(k+1) * (A x(k) - x(k-1)), new values overwrite x(k-1)
+	double omega = 1.0;
+	for (size_t k = 0; k < nIterations; ++k)
+	{
+		if (k == 1) omega = 1.0 / (1.0 - rho * rho / 2.0);
+		else if (k > 1) omega = 1.0 / (1.0 - rho * rho * omega / 4.0);
+		P(x, [&](size_t i, typename data_vector::value_type val)
+		{
+			prev[i] += omega * (val - prev[i]);
+		});
+		x.swap(prev);
+	}
+}
+
 template<typename field_type>
 class FieldLinearOp
 {
@@ -13,123 +80,608 @@ public:
 	using Field = field<field_type>;
 	using mesh_geom = mesh_geometry<double, uint32_t>;
 	using MatrixElem = typename mesh_geom::InterpCoef;
-	using MatrixRow = typename mesh_geom::InterpCoefs;
-	using Matrix = std::vector<MatrixRow>;
+	using MatrixRow = std::vector<MatrixElem>;
 	using BoundaryMeshSharedPtr = std::shared_ptr<mesh_geometry<double, uint32_t>::BoundaryMesh>; 
 	using MeshSharedPtr = std::shared_ptr<mesh_geometry<double, uint32_t>>;
 	using InterpCoef = mesh_geometry<double, uint32_t>::InterpCoef;
 	using InterpCoefs = mesh_geometry<double, uint32_t>::InterpCoefs;
-	using NodeTypes = std::vector<bool>;
+	using InterpStencil = mesh_geometry<double, uint32_t>::InterpStencil;
 	using vector3f = mesh_geom::vector3f;
 
 private:
-	Matrix m_matrix;
+	template<typename, typename> friend class DistributedOperator;
+
+	//Matrix in compressed sparse rows format
+	std::vector<size_t> m_rowStart;
+	std::vector<uint32_t> m_cols;
+	std::vector<double> m_coefs;
+
 	MeshSharedPtr m_pMeshGeometry;
 	BoundaryMeshSharedPtr m_pBoundaryMesh;
+	size_t m_boundaryRevision; //Revision of field boundaries the operator was built for
+	bool m_bLaplacian;
+	ParallelRunner m_run; //Runs assembly and matrix products, they are serial if it is empty
 
-	NodeTypes m_nodeTypes;
+	//Number of rows in a chunk of parallel loops
+	static const size_t s_rowsPerChunk = 4096;
+
+	//Transposed matrix structure: rows using every node value
+	struct Dependents
+	{
+		std::vector<size_t> start;
+		std::vector<uint32_t> rows;
+	};
+	//It is built on the first relaxation and shared between threads
+	mutable std::shared_ptr<const Dependents> m_pDependents;
 
-	//Adds two matrix rows
-	static MatrixRow& add(MatrixRow& r1, const MatrixRow& r2)
+	std::shared_ptr<const Dependents> dependents() const
 	{
+		std::shared_ptr<const Dependents> pDeps = std::atomic_load(&m_pDependents);
+		if (pDeps) return pDeps;
 
-		for (const InterpCoef& c : r2)
+		std::shared_ptr<Dependents> pNew = std::make_shared<Dependents>();
+		pNew->start.assign(size() + 1, 0);
+		for (uint32_t col : m_cols) ++pNew->start[col + 1];
+		for (size_t i = 0; i < size(); ++i) pNew->start[i + 1] += pNew->start[i];
+		pNew->rows.resize(m_cols.size());
+		std::vector<size_t> pos(pNew->start.begin(), pNew->start.end() - 1);
+		for (uint32_t i = 0; i < size(); ++i)
+			for (size_t k = m_rowStart[i]; k < m_rowStart[i + 1]; ++k) pNew->rows[pos[m_cols[k]]++] = i;
+		pDeps = pNew;
+		std::atomic_store(&m_pDependents, pDeps);
+		return pDeps;
+	}
+
+	/**
+	 * Block of rows with the rows it depends on during depth iterations, the nodes of the block come first,
+	 * and the rows updated at every iteration form a prefix of the local nodes.
+	 * Tiles keep only their nodes, matrix elements are read from the operator
+	 */
+	struct Tile
+	{
+		std::vector<uint32_t> nodes; //Global labels of the local nodes, the block is a range of labels
+		std::vector<size_t> stepRows; //Number of local rows updated at the iteration j, the last one is the block size
+		std::vector<std::pair<uint32_t, uint32_t>> ghosts; //Global and local labels of the nodes out of the block sorted by global labels
+
+		//Local label of a node of the tile
+		uint32_t localLabel(uint32_t l) const
+		{
+			if (l - nodes[0] < stepRows.back()) return l - nodes[0];
+			return std::lower_bound(ghosts.begin(), ghosts.end(), std::make_pair(l, uint32_t(0)))->second;
+		}
+	};
+	struct Tiling
+	{
+		size_t depth, cacheBytes;
+		std::vector<Tile> tiles;
+	};
+	//It is built on the first tiled application and rebuilt if the parameters change
+	mutable std::shared_ptr<const Tiling> m_pTiling;
+
+	std::shared_ptr<const Tiling> tiling(size_t depth, size_t cacheBytes) const
+	{
+		std::shared_ptr<const Tiling> pTiling = std::atomic_load(&m_pTiling);
+		if (pTiling && pTiling->depth == depth && pTiling->cacheBytes == cacheBytes) return pTiling;
+		LS_PROFILE_SCOPE("FieldLinearOp::tiling");
+
+		//A row takes its matrix elements, its label and two values, ghost layers are supposed to double a block
+		const size_t n = size();
+		const size_t rowBytes = (nonZeros() / std::max<size_t>(n, 1) + 1) * (sizeof(uint32_t) + sizeof(double))
+			+ sizeof(size_t) + sizeof(uint32_t) + 2 * sizeof(field_type);
+		const size_t blockRows = std::max<size_t>(cacheBytes / rowBytes / 2, 16);
+
+		std::shared_ptr<Tiling> pNew = std::make_shared<Tiling>();
+		pNew->depth = depth;
+		pNew->cacheBytes = cacheBytes;
+		pNew->tiles.resize((n + blockRows - 1) / blockRows);
+		parallelBlocks(m_run, n, blockRows, [&](size_t block)
 		{
-			MatrixRow::iterator it = r1.find(c.first);
-			if (it == r1.end())
+			Tile& tile = pNew->tiles[block];
+			std::unordered_map<uint32_t, uint32_t> local;
+			auto addNode = [&](uint32_t l)
 			{
-				r1[c.first] = c.second;
-			}
-			else
+				if (local.emplace(l, static_cast<uint32_t>(tile.nodes.size())).second) tile.nodes.push_back(l);
+			};
+			for (size_t i = block * blockRows; i < std::min((block + 1) * blockRows, n); ++i) addNode(static_cast<uint32_t>(i));
+
+			//Rows updated at the iteration j - 1 are the rows of the iteration j and their columns
+			tile.stepRows.assign(depth, 0);
+			tile.stepRows[depth - 1] = tile.nodes.size();
+			for (size_t step = depth; step-- > 0;)
 			{
-				it->second += c.second;
+				const size_t rows = tile.stepRows[step];
+				for (size_t r = 0; r < rows; ++r)
+					for (size_t k = m_rowStart[tile.nodes[r]]; k < m_rowStart[tile.nodes[r] + 1]; ++k) addNode(m_cols[k]);
+				if (step > 0) tile.stepRows[step - 1] = tile.nodes.size();
 			}
+
+			for (size_t r = tile.stepRows.back(); r < tile.nodes.size(); ++r)
+				tile.ghosts.push_back(std::make_pair(tile.nodes[r], static_cast<uint32_t>(r)));
+			std::sort(tile.ghosts.begin(), tile.ghosts.end());
+		});
+		pTiling = pNew;
+		std::atomic_store(&m_pTiling, pTiling);
+		return pTiling;
+	}
+
+	//Adds interpolation stencil multiplied by a number to a matrix row
+	static void add(MatrixRow& row, const InterpStencil& s, double h = 1.0)
+	{
+		for (size_t k = 0; k < s.size(); ++k) row.push_back(MatrixElem(s.labels[k], h * s.weights[k]));
+	}
+
+	//Sorts row elements by labels and sums elements with repeated labels
+	static void compress(MatrixRow& row)
+	{
+		std::sort(row.begin(), row.end(),
+			[](const MatrixElem& e1, const MatrixElem& e2)->bool { return e1.first < e2.first; });
+		size_t n = 0;
+		for (size_t k = 0; k < row.size(); ++k)
+		{
+			if (n != 0 && row[n - 1].first == row[k].first) row[n - 1].second += row[k].second;
+			else row[n++] = row[k];
+		}
+		row.resize(n);
+	}
+
+	//Appends a row to the end of the matrix
+	void pushRow(const MatrixRow& row)
+	{
+		for (const MatrixElem& e : row)
+		{
+			m_cols.push_back(e.first);
+			m_coefs.push_back(e.second);
 		}
-		return r1;
+		m_rowStart.push_back(m_cols.size());
+	}
+
+	//Product of the row i and a vector
+	template<typename data_vector>
+	field_type rowProduct(size_t i, const data_vector& x) const
+	{
+		field_type result = 0.0;
+		for (size_t k = m_rowStart[i]; k < m_rowStart[i + 1]; ++k) result += x[m_cols[k]] * m_coefs[k];
+		return result;
+	}
+
+	//Calls V(i, (Ax)_i) for every row i, rows are shared between the threads of the runner
+	template<typename data_vector, typename visitor>
+	void product(const data_vector& x, visitor V) const
+	{
+		parallelFor(m_run, 0, size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i) V(i, rowProduct(i, x));
+		}, s_rowsPerChunk);
 	}
 
-	//Multiplicates a matrix row by a number
-	static MatrixRow& mul(double h, MatrixRow& r)
+	//Clears matrix before filling it row by row
+	void clear()
 	{
-		for (std::pair<const uint32_t, double>& e : r) e.second *= h;
-		return r;
+		m_rowStart.assign(1, 0);
+		m_cols.clear();
+		m_coefs.clear();
+		std::atomic_store(&m_pDependents, std::shared_ptr<const Dependents>());
+		std::atomic_store(&m_pTiling, std::shared_ptr<const Tiling>());
 	}
 
 public:
+	//Creates zero operator
 	FieldLinearOp(const Field& field)
 		: 
-		m_matrix(field.m_pMeshGeometry->size()),
+		m_rowStart(field.m_pMeshGeometry->size() + 1, 0),
 		m_pMeshGeometry(field.m_pMeshGeometry),
 		m_pBoundaryMesh(field.m_pBoundaryMesh),
-		m_nodeTypes(field._node_types)
+		m_boundaryRevision(field.m_boundaryRevision),
+		m_bLaplacian(false)
 	{}
 
+	//Sets the runner of parallel loops, an empty one makes them serial
+	void setRunner(const ParallelRunner& run) { m_run = run; }
+
 	//Gets the size of a field
-	size_t size() const { return m_matrix.size(); }
+	size_t size() const { return m_rowStart.size() - 1; }
+
+	//Gets the number of stored matrix elements
+	size_t nonZeros() const { return m_cols.size(); }
+
+	//Mesh and boundary conditions the operator was built for
+	const mesh_geom& mesh() const { return *m_pMeshGeometry; }
+	const typename mesh_geom::BoundaryMesh& boundary() const { return *m_pBoundaryMesh; }
+
+	//Gets the position of the first element of the row i among all stored elements, rowBegin(size()) == nonZeros()
+	size_t rowBegin(size_t i) const { return m_rowStart[i]; }
+
+	//Products of the row i and width interleaved fields starting at x, x[l * stride + f] is the value of the field f at the node l
+	template<size_t width>
+	void rowProducts(size_t i, const field_type* x, size_t stride, field_type* result) const
+	{
+		field_type acc[width];
+		for (size_t f = 0; f < width; ++f) acc[f] = 0.0;
+		for (size_t k = m_rowStart[i]; k < m_rowStart[i + 1]; ++k)
+		{
+			const field_type* xCol = x + m_cols[k] * stride;
+			const double coef = m_coefs[k];
+			for (size_t f = 0; f < width; ++f) acc[f] += xCol[f] * coef;
+		}
+		for (size_t f = 0; f < width; ++f) result[f] = acc[f];
+	}
+
+	//Checks if the row i keeps a node value unchanged, e.g. a fixed value boundary
+	bool isIdentityRow(size_t i) const
+	{
+		return m_rowStart[i + 1] - m_rowStart[i] == 1 && m_cols[m_rowStart[i]] == i && m_coefs[m_rowStart[i]] == 1.0;
+	}
+
+	//Visits elements of the row i
+	template<typename visitor>
+	void visitRow(uint32_t i, visitor V) const
+	{
+		for (size_t k = m_rowStart[i]; k < m_rowStart[i + 1]; ++k) V(m_cols[k], m_coefs[k]);
+	}
 
 	//Sets inner matrix to identity
 	FieldLinearOp& setToIdentity()
 	{
-		uint32_t i = 0;
-		for (MatrixRow& row : m_matrix)
+		const size_t n = size();
+		clear();
+		m_bLaplacian = false;
+		m_cols.reserve(n);
+		m_coefs.reserve(n);
+		LS_PROFILE_ALLOC(n * sizeof(uint32_t));
+		LS_PROFILE_ALLOC(n * sizeof(double));
+		for (uint32_t i = 0; i < n; ++i) pushRow(MatrixRow{ MatrixElem(i, 1.0) });
+		return *this;
+	}
+
+	//Assembles row i of the laplacian solver
+	void laplacianRow(uint32_t i, MatrixRow& row) const
+	{
+		row.clear();
+		double h = m_pMeshGeometry->shortestEdgeLength(i) / 2.0; //calculate small step
+		if (m_pBoundaryMesh->isBoundary(i))
 		{
-			row.clear();
-			row[i++] = 1.0;
+			if (m_pBoundaryMesh->isFirstType(i))
+			{
+				row.push_back(MatrixElem(i, 1.0));
+			}
+			else if (m_pBoundaryMesh->isMirror(i))
+			{//Inner stencil with the points behind symmetry planes mirrored into the mesh
+				const vector3f r = m_pMeshGeometry->spacePositionOf(i), n = m_pBoundaryMesh->normal(i);
+				for (int k = 0; k < 3; ++k)
+					for (double step : { h, -h })
+					{
+						vector3f p = r;
+						p[k] += step * n[k] < 0.0 ? -step : step;
+						add(row, m_pMeshGeometry->interpStencil(p[0], p[1], p[2], i), 1. / 6.);
+					}
+			}
+			else
+			{//Zero gradient condition					
+				vector3f r = m_pMeshGeometry->spacePositionOf(i) + h*m_pBoundaryMesh->normal(i);
+				add(row, m_pMeshGeometry->interpStencil(r[0], r[1], r[2], i));
+			}
+		}
+		else
+		{
+			vector3f r = m_pMeshGeometry->spacePositionOf(i);
+			add(row, m_pMeshGeometry->interpStencil(r[0] + h, r[1], r[2], i), 1. / 6.);
+			add(row, m_pMeshGeometry->interpStencil(r[0] - h, r[1], r[2], i), 1. / 6.);
+			add(row, m_pMeshGeometry->interpStencil(r[0], r[1] + h, r[2], i), 1. / 6.);
+			add(row, m_pMeshGeometry->interpStencil(r[0], r[1] - h, r[2], i), 1. / 6.);
+			add(row, m_pMeshGeometry->interpStencil(r[0], r[1], r[2] + h, i), 1. / 6.);
+			add(row, m_pMeshGeometry->interpStencil(r[0], r[1], r[2] - h, i), 1. / 6.);
 		}
+		compress(row);
+	}
+
+	//Creates solver for equations system Ax=0, where A is laplacian. Only the first nRows rows are assembled if nRows is set, others stay empty
+	FieldLinearOp& laplacianSolver(size_t nRows = ~size_t(0))
+	{
+		LS_PROFILE_SCOPE("FieldLinearOp::laplacianSolver");
+		const size_t nTotal = size(), n = std::min(nRows, nTotal);
+		clear();
+		m_bLaplacian = true;
+
+		//Chunks of rows are assembled in parallel to their own arrays and then joined in order
+		struct Chunk
+		{
+			std::vector<size_t> rowSize;
+			std::vector<uint32_t> cols;
+			std::vector<double> coefs;
+		};
+		std::vector<Chunk> chunks((n + s_rowsPerChunk - 1) / s_rowsPerChunk);
+		parallelBlocks(m_run, n, s_rowsPerChunk, [&](size_t block)
+		{
+			Chunk& chunk = chunks[block];
+			const size_t begin = block * s_rowsPerChunk, end = std::min(begin + s_rowsPerChunk, n);
+			chunk.rowSize.reserve(end - begin);
+			chunk.cols.reserve((end - begin) * 8);
+			chunk.coefs.reserve((end - begin) * 8);
+			MatrixRow row;
+			row.reserve(6 * InterpStencil::capacity);
+			for (size_t i = begin; i < end; ++i)
+			{
+				laplacianRow(static_cast<uint32_t>(i), row);
+				for (const MatrixElem& e : row)
+				{
+					chunk.cols.push_back(e.first);
+					chunk.coefs.push_back(e.second);
+				}
+				chunk.rowSize.push_back(row.size());
+			}
+		});
+
+		size_t nonZeros = 0;
+		for (const Chunk& chunk : chunks) nonZeros += chunk.cols.size();
+		m_rowStart.reserve(nTotal + 1);
+		m_cols.reserve(nonZeros);
+		m_coefs.reserve(nonZeros);
+		LS_PROFILE_ALLOC((nTotal + 1) * sizeof(size_t));
+		LS_PROFILE_ALLOC(nonZeros * sizeof(uint32_t));
+		LS_PROFILE_ALLOC(nonZeros * sizeof(double));
+		for (const Chunk& chunk : chunks)
+		{
+			for (size_t rowSize : chunk.rowSize) m_rowStart.push_back(m_rowStart.back() + rowSize);
+			m_cols.insert(m_cols.end(), chunk.cols.begin(), chunk.cols.end());
+			m_coefs.insert(m_coefs.end(), chunk.coefs.begin(), chunk.coefs.end());
+		}
+		m_rowStart.resize(nTotal + 1, m_cols.size());
 		return *this;
 	}
 
-	//Creates solver for equations system Ax=0, where A is laplacian
-	FieldLinearOp& laplacianSolver()
+	/**
+	 * Takes boundaries of the field changed after the operator was built and rebuilds the rows of the nodes
+	 * which joined, left or retyped patches since then. field should be the one the operator was created for or its copy.
+	 * Returns the number of rebuilt rows
+	 */
+	size_t update(const Field& field)
 	{
+		LS_PROFILE_SCOPE("FieldLinearOp::update");
+		if (field.m_pMeshGeometry != m_pMeshGeometry) throw
+			std::runtime_error("FieldLinearOp::update:"
+				"Field and operator meshes are different.");
+		std::vector<uint32_t> rows;
+		for (uint32_t l = 0; l < field.size(); ++l)
+			if (field.m_nodeRevisions[l] > m_boundaryRevision) rows.push_back(l);
+		m_pBoundaryMesh = field.m_pBoundaryMesh;
+		m_boundaryRevision = field.m_boundaryRevision;
+		if (!m_bLaplacian || rows.empty()) return 0;
+
+		//Rebuilt rows are merged with the kept ones in one pass
+		std::vector<size_t> rowStart;
+		std::vector<uint32_t> cols;
+		std::vector<double> coefs;
+		rowStart.reserve(m_rowStart.size());
+		cols.reserve(m_cols.size());
+		coefs.reserve(m_coefs.size());
+		LS_PROFILE_ALLOC(m_rowStart.size() * sizeof(size_t));
+		LS_PROFILE_ALLOC(m_cols.size() * sizeof(uint32_t));
+		LS_PROFILE_ALLOC(m_coefs.size() * sizeof(double));
+		rowStart.push_back(0);
+		MatrixRow row;
+		std::vector<uint32_t>::const_iterator next = rows.begin();
 		for (uint32_t i = 0; i < size(); ++i)
 		{
-			double h = m_pMeshGeometry->shortestEdgeLength(i) / 2.0; //calculate small step
-			if (m_pBoundaryMesh->isBoundary(i))
+			if (next != rows.end() && *next == i)
 			{
-				if (m_pBoundaryMesh->isFirstType(i))
+				laplacianRow(i, row);
+				for (const MatrixElem& e : row)
 				{
-					m_matrix[i] = InterpCoefs{ InterpCoef{i, 1.0} };
-				}
-				else
-				{//Zero gradient condition					
-					vector3f r = m_pMeshGeometry->spacePositionOf(i) + h*m_pBoundaryMesh->normal(i);
-					m_matrix[i] = m_pMeshGeometry->interpCoefs(r[0], r[1], r[2], i);
+					cols.push_back(e.first);
+					coefs.push_back(e.second);
 				}
+				++next;
 			}
 			else
 			{
-				vector3f r = m_pMeshGeometry->spacePositionOf(i);
-				m_matrix[i] = m_pMeshGeometry->interpCoefs(r[0] + h, r[1], r[2], i);
-				m_matrix[i] = add(m_matrix[i], m_pMeshGeometry->interpCoefs(r[0] - h, r[1], r[2], i));
-				m_matrix[i] = add(m_matrix[i], m_pMeshGeometry->interpCoefs(r[0], r[1] + h, r[2], i));
-				m_matrix[i] = add(m_matrix[i], m_pMeshGeometry->interpCoefs(r[0], r[1] - h, r[2], i));
-				m_matrix[i] = add(m_matrix[i], m_pMeshGeometry->interpCoefs(r[0], r[1], r[2] + h, i));
-				m_matrix[i] = add(m_matrix[i], m_pMeshGeometry->interpCoefs(r[0], r[1], r[2] - h, i));
-				m_matrix[i] = mul(1. / 6., m_matrix[i]);
+				cols.insert(cols.end(), m_cols.begin() + m_rowStart[i], m_cols.begin() + m_rowStart[i + 1]);
+				coefs.insert(coefs.end(), m_coefs.begin() + m_rowStart[i], m_coefs.begin() + m_rowStart[i + 1]);
 			}
+			rowStart.push_back(cols.size());
 		}
-		return *this;
+		m_rowStart.swap(rowStart);
+		m_cols.swap(cols);
+		m_coefs.swap(coefs);
+		std::atomic_store(&m_pDependents, std::shared_ptr<const Dependents>());
+		std::atomic_store(&m_pTiling, std::shared_ptr<const Tiling>());
+		LS_PROFILE_COUNT("FieldLinearOp::updatedRows", rows.size());
+		return rows.size();
 	}
 
 	//Applies linear operator to a field
 	void applyToField(Field& field) const
 	{
+		LS_PROFILE_SCOPE("FieldLinearOp::applyToField");
 		if (field.size() != size()) throw
 			std::runtime_error("FieldLinearOp::applyToField:"
 				"Field and operator sizes mismatch.");
-		typename Field::data_vector data = field.data();
-		size_t i = 0;
-		for (const auto& row : m_matrix)
+		typename Field::data_vector data(field.size());
+		LS_PROFILE_ALLOC(data.size() * sizeof(field_type));
+		product(field.data(), [&](size_t i, field_type val) { data[i] = val; });
+		field.data().swap(data);
+		field.clear_changed();
+		field.touch_values();
+	}
+
+	/**
+	 * Applies the operator to nFields fields stored interleaved, x[i * nFields + f] is the value of the field f at the node i.
+	 * The matrix is read once for all fields, groups of up to 8 fields are summed in registers with the same order
+	 * of operations as applyToField, so every field gets exactly the same result
+	 */
+	void applyToFields(typename Field::data_vector& x, size_t nFields) const
+	{
+		LS_PROFILE_SCOPE("FieldLinearOp::applyToFields");
+		if (x.size() != size() * nFields) throw
+			std::runtime_error("FieldLinearOp::applyToFields:"
+				"Fields and operator sizes mismatch.");
+		typename Field::data_vector data(x.size());
+		LS_PROFILE_ALLOC(data.size() * sizeof(field_type));
+		parallelFor(m_run, 0, size(), [&](size_t begin, size_t end)
 		{
-			field_type& dataElem = data[i++];
-			dataElem = 0.0;
-			for (const auto& interpCoef : row)
+			for (size_t i = begin; i < end; ++i)
+				for (size_t f = 0; f < nFields; f += 8)
+				{
+					const field_type* xGroup = x.data() + f;
+					field_type* result = data.data() + i * nFields + f;
+					switch (std::min<size_t>(nFields - f, 8))
+					{
+					case 1: rowProducts<1>(i, xGroup, nFields, result); break;
+					case 2: rowProducts<2>(i, xGroup, nFields, result); break;
+					case 3: rowProducts<3>(i, xGroup, nFields, result); break;
+					case 4: rowProducts<4>(i, xGroup, nFields, result); break;
+					case 5: rowProducts<5>(i, xGroup, nFields, result); break;
+					case 6: rowProducts<6>(i, xGroup, nFields, result); break;
+					case 7: rowProducts<7>(i, xGroup, nFields, result); break;
+					default: rowProducts<8>(i, xGroup, nFields, result); break;
+					}
+				}
+		}, s_rowsPerChunk);
+		x.swap(data);
+	}
+
+	/**
+	 * Estimates the spectral radius of the operator restricted to not fixed nodes by power iterations.
+	 * The estimate approaches the radius from below
+	 */
+	double spectralRadius(size_t nIterations = 30) const
+	{
+		LS_PROFILE_SCOPE("FieldLinearOp::spectralRadius");
+		return powerIteration(size(), nIterations,
+			[this](const std::vector<double>& v, auto V) { product(v, V); },
+			[this](size_t i)->bool { return isIdentityRow(i); });
+	}
+
+	/**
+	 * Chebyshev accelerated iteration of x = Ax, the eigen values of the operator on not fixed nodes
+	 * are supposed to lie in [-rho, rho]. It uses the same matrix products as applyToField and no global reductions
+	 */
+	void chebyshev(Field& field, size_t nIterations, double rho) const
+	{
+		LS_PROFILE_SCOPE("FieldLinearOp::chebyshev");
+		if (field.size() != size()) throw
+			std::runtime_error("FieldLinearOp::chebyshev:"
+				"Field and operator sizes mismatch.");
+		chebyshevIteration(field.data(), nIterations, rho,
+			[this](const typename Field::data_vector& x, auto V) { product(x, V); });
+		field.clear_changed();
+		field.touch_values();
+	}
+
+	/**
+	 * Applies the operator nIterations times with exactly the same result as separate applyToField calls.
+	 * Rows are split into blocks of about cacheBytes, every block is extended by the rows it depends on
+	 * and makes depth iterations at once while its data stay in the cache. Ghost rows are computed
+	 * by several blocks, so deeper tiles save memory traffic for extra arithmetic
+	 */
+	void tiled(Field& field, size_t nIterations, size_t depth, size_t cacheBytes) const
+	{
+		LS_PROFILE_SCOPE("FieldLinearOp::tiled");
+		if (field.size() != size()) throw
+			std::runtime_error("FieldLinearOp::tiled:"
+				"Field and operator sizes mismatch.");
+		if (depth == 0) throw std::runtime_error("FieldLinearOp::tiled: Depth should be positive.");
+		const size_t nPasses = nIterations / depth;
+		if (nPasses != 0)
+		{
+			std::shared_ptr<const Tiling> pTiling = tiling(depth, cacheBytes);
+			typename Field::data_vector result(size());
+			LS_PROFILE_ALLOC(result.size() * sizeof(field_type));
+			for (size_t pass = 0; pass < nPasses; ++pass)
 			{
-				dataElem += field._data[interpCoef.first] * interpCoef.second;
+				const typename Field::data_vector& x = field.data();
+				parallelFor(m_run, 0, pTiling->tiles.size(), [&](size_t begin, size_t end)
+				{
+					std::vector<field_type> prev, next;
+					std::vector<uint32_t> cols;
+					for (size_t t = begin; t < end; ++t)
+					{
+						const Tile& tile = pTiling->tiles[t];
+						prev.resize(tile.nodes.size());
+						next.resize(tile.nodes.size());
+						for (size_t r = 0; r < tile.nodes.size(); ++r) prev[r] = x[tile.nodes[r]];
+
+						//Local labels of the columns are found for the pass, the elements of a row keep their order
+						const size_t nRows = tile.stepRows[0];
+						cols.clear();
+						for (size_t r = 0; r < nRows; ++r)
+							for (size_t k = m_rowStart[tile.nodes[r]]; k < m_rowStart[tile.nodes[r] + 1]; ++k)
+								cols.push_back(tile.localLabel(m_cols[k]));
+
+						//Products are summed in the order of rowProduct, so the values are the same bit to bit
+						for (size_t rows : tile.stepRows)
+						{
+							const uint32_t* rowCols = cols.data();
+							for (size_t r = 0; r < rows; ++r)
+							{
+								const size_t first = m_rowStart[tile.nodes[r]], last = m_rowStart[tile.nodes[r] + 1];
+								field_type val = 0.0;
+								for (size_t k = first; k < last; ++k) val += prev[*rowCols++] * m_coefs[k];
+								next[r] = val;
+							}
+							prev.swap(next);
+						}
+						for (size_t r = 0; r < tile.stepRows.back(); ++r) result[tile.nodes[r]] = prev[r];
+					}
+				}, 1);
+				field.data().swap(result);
 			}
+			field.clear_changed();
+			field.touch_values();
+		}
+		for (size_t i = nPasses * depth; i < nIterations; ++i) applyToField(field);
+	}
+
+	/**
+	 * Active set relaxation: updates in place only the nodes whose residual |(Ax)_i - x_i| exceeds tolerance.
+	 * The work list starts from the nodes changed by boundary conditions since the last relaxation
+	 * and grows with the rows depending on every updated node, so a local change costs a local work.
+	 * Returns the number of node updates, maxUpdates = 0 means no limit
+	 */
+	size_t relax(Field& field, double tolerance, size_t maxUpdates = 0) const
+	{
+		LS_PROFILE_SCOPE("FieldLinearOp::relax");
+		if (field.size() != size()) throw
+			std::runtime_error("FieldLinearOp::relax:"
+				"Field and operator sizes mismatch.");
+		std::shared_ptr<const Dependents> pDeps = dependents();
+		typename Field::data_vector& x = field.data();
+
+		std::deque<uint32_t> work;
+		std::vector<bool> queued(size(), false);
+		auto push = [&](uint32_t l)
+		{
+			if (queued[l]) return;
+			queued[l] = true;
+			work.push_back(l);
+		};
+		auto pushDependents = [&](uint32_t l)
+		{
+			for (size_t k = pDeps->start[l]; k < pDeps->start[l + 1]; ++k) push(pDeps->rows[k]);
+		};
+		for (uint32_t l : field.takeChanged())
+		{
+			push(l);
+			pushDependents(l);
 		}
-		field.data() = data;
+
+		size_t nUpdates = 0;
+		while (!work.empty() && (maxUpdates == 0 || nUpdates < maxUpdates))
+		{
+			uint32_t i = work.front();
+			work.pop_front();
+			queued[i] = false;
+			field_type val = rowProduct(i, x);
+			if (std::abs(val - x[i]) <= tolerance) continue;
+			x[i] = val;
+			++nUpdates;
+			pushDependents(i);
+		}
+		LS_PROFILE_COUNT("FieldLinearOp::relaxUpdates", nUpdates);
+		if (nUpdates) field.touch_values();
+
+		//Unfinished work is continued by the next relaxation
+		for (uint32_t l : work) field.markChanged(l);
+		return nUpdates;
 	}
 };
 
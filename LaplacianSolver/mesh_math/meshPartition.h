@@ -0,0 +1,266 @@
+#pragma once
+#ifndef _MESH_PARTITION_H_
+#define _MESH_PARTITION_H_
+
+#include <string>
+#include <unordered_map>
+
+#include "mesh_geometry.h"
+
+//Domain decomposition of a mesh between several solver processes
+
+/**
+ * Recursive coordinate bisection of node positions
+ * Returns part number for every node, parts have equal sizes up to one node
+ */
+template<typename node_positions>
+std::vector<uint32_t> coordinateBisection(const node_positions& np, uint32_t nParts)
+{
+	if (nParts == 0) throw std::runtime_error("coordinateBisection: Number of parts should be positive.");
+
+	std::vector<uint32_t> parts(np.size(), 0);
+	std::vector<uint32_t> nodes(np.size());
+	for (size_t i = 0; i < nodes.size(); ++i) nodes[i] = static_cast<uint32_t>(i);
+
+	//Range of nodes to split between parts [firstPart, firstPart + nParts)
+	struct Range { size_t begin, end; uint32_t firstPart, nParts; };
+	std::vector<Range> stack{ Range{ 0, nodes.size(), 0, nParts } };
+	while (!stack.empty())
+	{
+		Range r = stack.back();
+		stack.pop_back();
+		if (r.nParts == 1 || r.end - r.begin <= 1)
+		{
+			for (size_t i = r.begin; i < r.end; ++i) parts[nodes[i]] = r.firstPart;
+			continue;
+		}
+
+		//Split along the longest side of the bounding box
+		double lo[3] = { np[nodes[r.begin]][0], np[nodes[r.begin]][1], np[nodes[r.begin]][2] };
+		double hi[3] = { lo[0], lo[1], lo[2] };
+		for (size_t i = r.begin; i < r.end; ++i)
+			for (int k = 0; k < 3; ++k)
+			{
+				lo[k] = std::min(lo[k], static_cast<double>(np[nodes[i]][k]));
+				hi[k] = std::max(hi[k], static_cast<double>(np[nodes[i]][k]));
+			}
+		int axis = 0;
+		for (int k = 1; k < 3; ++k) if (hi[k] - lo[k] > hi[axis] - lo[axis]) axis = k;
+
+		uint32_t nLeft = r.nParts / 2;
+		size_t mid = r.begin + (r.end - r.begin) * nLeft / r.nParts;
+		std::nth_element(nodes.begin() + r.begin, nodes.begin() + mid, nodes.begin() + r.end,
+			[&](uint32_t l1, uint32_t l2)->bool { return np[l1][axis] < np[l2][axis]; });
+		stack.push_back(Range{ r.begin, mid, r.firstPart, nLeft });
+		stack.push_back(Range{ mid, r.end, r.firstPart + nLeft, r.nParts - nLeft });
+	}
+	return parts;
+}
+
+/**
+ * Part of a global mesh owned by one process together with ghost layers of its neighbours
+ * Local labels of owned nodes go first, then ghost nodes layer by layer
+ */
+template<typename Float, typename label>
+struct local_mesh
+{
+	using mesh_geom = mesh_geometry<Float, label>;
+
+	std::shared_ptr<mesh_geom> mesh;
+	std::vector<label> globalLabels; //local label -> global label
+	std::vector<uint32_t> owners;    //part owning every local node
+	size_t nOwned;
+
+	std::unordered_map<label, label> localLabels; //global label -> local label
+
+	//Converts global label to a local one, returns false if the node is not in the local mesh
+	bool localLabel(label global, label& local) const
+	{
+		typename std::unordered_map<label, label>::const_iterator it = localLabels.find(global);
+		if (it == localLabels.end()) return false;
+		local = it->second;
+		return true;
+	}
+};
+
+/**
+ * Sends out[r] to every process r and returns the vectors received from every process r
+ * transport should provide rank(), size(), send(dest, data, bytes), receive(src, data, bytes) and wait(),
+ * all processes should call it together
+ */
+template<typename T, typename transport>
+std::vector<std::vector<T>> exchangeAll(transport& t, const std::vector<std::vector<T>>& out)
+{
+	const int nRanks = t.size(), me = t.rank();
+	std::vector<std::vector<T>> in(nRanks);
+	in[me] = out[me];
+	for (int r = 0; r < nRanks; ++r)
+	{
+		if (r == me) continue;
+		uint64_t count = out[r].size();
+		t.send(r, &count, sizeof(count));
+		if (count) t.send(r, out[r].data(), out[r].size() * sizeof(T));
+	}
+	for (int r = 0; r < nRanks; ++r)
+	{
+		if (r == me) continue;
+		uint64_t count = 0;
+		t.receive(r, &count, sizeof(count));
+		in[r].resize(static_cast<size_t>(count));
+		if (count) t.receive(r, in[r].data(), in[r].size() * sizeof(T));
+	}
+	t.wait();
+	return in;
+}
+
+/**
+ * Throws on all processes if any of them met an error, error is the message of this process or empty.
+ * Checks which may fail on one process only report through it before the next exchange, so no process
+ * is left waiting for the failed one. All processes should call it together
+ */
+template<typename transport>
+void throwIfAnyFailed(transport& t, const std::string& error, const char* caller)
+{
+	const std::vector<std::vector<uint8_t>> failed =
+		exchangeAll(t, std::vector<std::vector<uint8_t>>(t.size(), std::vector<uint8_t>(1, error.empty() ? 0 : 1)));
+	if (!error.empty()) throw std::runtime_error(error);
+	for (const std::vector<uint8_t>& f : failed)
+		if (f[0]) throw std::runtime_error(std::string(caller) + ": Another process failed.");
+}
+
+/**
+ * Builds the local mesh of a process from its own nodes only, ghostLayers layers of neighbour nodes
+ * are requested from the processes owning them. Nodes are named by global labels unique among all processes,
+ * neighbours of the owned node i are neighbours[neighbourStart[i]]...neighbours[neighbourStart[i + 1] - 1].
+ * Owners of the labels are found with a directory, every label is registered at the process label % size().
+ * All processes should call it together
+ */
+template<typename Float, typename label, typename transport>
+local_mesh<Float, label> assembleLocalMesh(
+	transport& t,
+	const std::vector<label>& owned,
+	const typename mesh_geometry<Float, label>::node_positions& positions,
+	const std::vector<size_t>& neighbourStart,
+	const std::vector<label>& neighbours,
+	size_t ghostLayers)
+{
+	LS_PROFILE_SCOPE("assembleLocalMesh");
+	using mesh_geom = mesh_geometry<Float, label>;
+	using vector3f = typename mesh_geom::vector3f;
+	const uint32_t nRanks = static_cast<uint32_t>(t.size()), me = static_cast<uint32_t>(t.rank());
+	//The number of layers is the same on all processes, so it is checked without an exchange
+	if (ghostLayers == 0) throw std::runtime_error("assembleLocalMesh: Number of ghost layers should be positive.");
+	std::string error;
+	if (positions.size() != owned.size() || neighbourStart.size() != owned.size() + 1 || neighbourStart.back() != neighbours.size())
+		error = "assembleLocalMesh: Sizes of node data mismatch.";
+
+	local_mesh<Float, label> result;
+	typename mesh_geom::node_positions np;
+	std::vector<size_t> adjacencyStart(1, 0);
+	std::vector<label> adjacency;
+	auto addNode = [&](label l, uint32_t owner, const vector3f& r, const label* first, const label* last)
+	{
+		if (!result.localLabels.emplace(l, static_cast<label>(result.globalLabels.size())).second)
+		{
+			error = "assembleLocalMesh: Node is met twice.";
+			return;
+		}
+		result.globalLabels.push_back(l);
+		result.owners.push_back(owner);
+		np.push_back(r);
+		adjacency.insert(adjacency.end(), first, last);
+		adjacencyStart.push_back(adjacency.size());
+	};
+	if (error.empty())
+		for (size_t i = 0; i < owned.size(); ++i)
+			addNode(owned[i], me, positions[i], neighbours.data() + neighbourStart[i], neighbours.data() + neighbourStart[i + 1]);
+	result.nOwned = result.globalLabels.size();
+	throwIfAnyFailed(t, error, "assembleLocalMesh");
+
+	std::unordered_map<label, uint32_t> directory;
+	{
+		std::vector<std::vector<label>> registered(nRanks);
+		for (label l : owned) registered[l % nRanks].push_back(l);
+		registered = exchangeAll(t, registered);
+		for (uint32_t r = 0; r < nRanks; ++r)
+			for (label l : registered[r]) directory[l] = r;
+	}
+
+	//Every layer takes the neighbours of the previous one, all processes make the same number of exchanges
+	size_t layerBegin = 0;
+	for (size_t layer = 0; layer < ghostLayers; ++layer)
+	{
+		const size_t layerEnd = result.globalLabels.size();
+		std::vector<label> missing;
+		for (size_t k = adjacencyStart[layerBegin]; k < adjacencyStart[layerEnd]; ++k)
+			if (result.localLabels.find(adjacency[k]) == result.localLabels.end()) missing.push_back(adjacency[k]);
+		std::sort(missing.begin(), missing.end());
+		missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+		//Owners of the missing nodes from the directory, unknown nodes get the owner nRanks
+		std::vector<std::vector<label>> queries(nRanks);
+		for (label l : missing) queries[l % nRanks].push_back(l);
+		std::vector<std::vector<label>> asked = exchangeAll(t, queries);
+		std::vector<std::vector<uint32_t>> answers(nRanks);
+		for (uint32_t r = 0; r < nRanks; ++r)
+			for (label l : asked[r])
+			{
+				typename std::unordered_map<label, uint32_t>::const_iterator it = directory.find(l);
+				answers[r].push_back(it == directory.end() ? nRanks : it->second);
+			}
+		answers = exchangeAll(t, answers);
+
+		//Positions and neighbours of the missing nodes from their owners
+		std::vector<std::vector<label>> requests(nRanks);
+		for (uint32_t r = 0; r < nRanks; ++r)
+			for (size_t k = 0; k < queries[r].size(); ++k)
+			{
+				if (answers[r][k] == nRanks) error = "assembleLocalMesh: Neighbour node is not owned by any process.";
+				else requests[answers[r][k]].push_back(queries[r][k]);
+			}
+		throwIfAnyFailed(t, error, "assembleLocalMesh");
+		asked = exchangeAll(t, requests);
+		std::vector<std::vector<Float>> coords(nRanks);
+		std::vector<std::vector<label>> lists(nRanks);
+		for (uint32_t r = 0; r < nRanks; ++r)
+			for (label l : asked[r])
+			{
+				label i;
+				if (!result.localLabel(l, i) || i >= result.nOwned)
+				{
+					error = "assembleLocalMesh: Requested node is not owned by the process.";
+					continue;
+				}
+				for (int k = 0; k < 3; ++k) coords[r].push_back(np[i][k]);
+				lists[r].push_back(static_cast<label>(adjacencyStart[i + 1] - adjacencyStart[i]));
+				lists[r].insert(lists[r].end(), adjacency.begin() + adjacencyStart[i], adjacency.begin() + adjacencyStart[i + 1]);
+			}
+		throwIfAnyFailed(t, error, "assembleLocalMesh");
+		coords = exchangeAll(t, coords);
+		lists = exchangeAll(t, lists);
+		for (uint32_t r = 0; r < nRanks; ++r)
+		{
+			const label* list = lists[r].data();
+			for (size_t k = 0; k < requests[r].size(); ++k)
+			{
+				const label nNeighbours = *list++;
+				addNode(requests[r][k], r, vector3f{ coords[r][3 * k], coords[r][3 * k + 1], coords[r][3 * k + 2] }, list, list + nNeighbours);
+				list += nNeighbours;
+			}
+		}
+		layerBegin = layerEnd;
+	}
+	throwIfAnyFailed(t, error, "assembleLocalMesh");
+
+	std::vector<typename mesh_geom::graph::edge_key> edges;
+	for (size_t i = 0; i < result.globalLabels.size(); ++i)
+		for (size_t k = adjacencyStart[i]; k < adjacencyStart[i + 1]; ++k)
+		{
+			label j;
+			if (result.localLabel(adjacency[k], j) && j > i) edges.push_back(mesh_geom::graph::key(static_cast<label>(i), j));
+		}
+	result.mesh = std::make_shared<mesh_geom>(mesh_geom::graph::fromEdges(edges, np.size()), std::move(np));
+	return result;
+}
+
+#endif // !_MESH_PARTITION_H_
@@ -1,11 +1,16 @@
 #ifndef MESH_GEOMETRY_H
 #define MESH_GEOMETRY_H
 
+#include <functional>
 #include <map>
+#include <memory>
+#include <set>
 
 #include <linearAlgebra\vectorTemplate.h>
 #include <linearAlgebra\linearInterpolation.h>
-#include <data_structs\graph.h>
+
+#include "adjacency.h"
+#include "profiler.h"
 
 /**
  * Mesh connectivity and node space positions
@@ -18,7 +23,7 @@ public:
 	using node_labels    = std::vector<label>;
 	using vector3f       = math::vector_c<Float, 3>;
 	using node_positions = std::vector<vector3f>;
-	using graph          = data_structs::graph<label>;
+	using graph          = adjacency<label>;
     using box3D          = std::pair<vector3f, vector3f>;
     using label_list	 = std::set<label>;
 
@@ -26,6 +31,93 @@ public:
 	using InterpCoef  = std::pair<label, Float>;
 	using InterpCoefs = std::map<label, Float>;
 
+	/**
+	 * Node positions kept in an own vector or in read only memory of an external owner, e.g. a memory mapped file.
+	 * Copies share the external memory
+	 */
+	class position_array
+	{
+		node_positions m_own;
+		std::shared_ptr<const void> m_pOwner;
+		const vector3f* m_pData;
+		size_t m_size;
+	public:
+		using const_iterator = const vector3f*;
+
+		position_array(node_positions&& np = node_positions())
+			: m_own(std::move(np)), m_pData(m_own.data()), m_size(m_own.size()) {}
+
+		//pData should stay valid while pOwner lives
+		position_array(const std::shared_ptr<const void>& pOwner, const vector3f* pData, size_t size)
+			: m_pOwner(pOwner), m_pData(pData), m_size(size) {}
+
+		position_array(const position_array& other)
+			: m_own(other.m_own), m_pOwner(other.m_pOwner), m_pData(m_pOwner ? other.m_pData : m_own.data()), m_size(other.m_size) {}
+
+		//Moved vectors keep their memory, so the address stays valid
+		position_array(position_array&& other)
+			: m_own(std::move(other.m_own)), m_pOwner(std::move(other.m_pOwner)), m_pData(other.m_pData), m_size(other.m_size)
+		{
+			other.m_pData = nullptr;
+			other.m_size = 0;
+		}
+
+		position_array& operator=(position_array other)
+		{
+			m_own.swap(other.m_own);
+			m_pOwner.swap(other.m_pOwner);
+			std::swap(m_pData, other.m_pData);
+			std::swap(m_size, other.m_size);
+			return *this;
+		}
+
+		size_t size() const { return m_size; }
+		const vector3f& operator[](size_t i) const { return m_pData[i]; }
+		const vector3f* data() const { return m_pData; }
+		const_iterator begin() const { return m_pData; }
+		const_iterator end() const { return m_pData + m_size; }
+
+		//Checks if the positions are kept by an external owner
+		bool external() const { return static_cast<bool>(m_pOwner); }
+	};
+
+	//Interpolation coefs stored inline, building them does not allocate memory
+	struct InterpStencil
+	{
+		static const size_t capacity = 8;
+
+		label labels[capacity];
+		Float weights[capacity];
+		size_t count;
+
+		InterpStencil() : count(0) {}
+
+		void add(label l, Float w)
+		{
+			labels[count] = l;
+			weights[count++] = w;
+		}
+
+		size_t size() const { return count; }
+
+		//Weighted sum of values
+		template<typename data_vector>
+		typename data_vector::value_type apply(const data_vector& data) const
+		{
+			typename data_vector::value_type result = weights[0] * data[labels[0]];
+			for (size_t i = 1; i < count; ++i) result += weights[i] * data[labels[i]];
+			return result;
+		}
+
+		//Converts stencil to a map, weights of repeated labels are summed
+		InterpCoefs coefs() const
+		{
+			InterpCoefs result;
+			for (size_t i = 0; i < count; ++i) result[labels[i]] += weights[i];
+			return result;
+		}
+	};
+
 	//Boundary conditions for the mesh
 	class BoundaryMesh
 	{
@@ -44,7 +136,8 @@ public:
 		};
 
 	public:
-		enum BoundaryType { ZERO_GRAD, FIXED_VAL };
+		//MIRROR is zero gradient across a symmetry plane normal to a coordinate axis, stencils crossing it are mirrored
+		enum BoundaryType { ZERO_GRAD, FIXED_VAL, MIRROR };
 
 		using BoundaryDescription = std::pair<BoundaryType, label_list>;
 		using BoundariesMap = std::map<std::string, BoundaryDescription>;
@@ -63,6 +156,24 @@ public:
 		//Creates empty boundary mesh
 		BoundaryMesh(const mesh_geometry& mesh):m_mesh(mesh){}
 
+		//Copies boundary mesh, names lists are rebound to the keys of the own boundaries map
+		BoundaryMesh(const BoundaryMesh& other)
+			:
+			m_mesh(other.m_mesh),
+			m_mapBoundariesList(other.m_mapBoundariesList),
+			m_mapReversedBoundariesList(other.m_mapReversedBoundariesList)
+		{
+			for (auto& entry : m_mapReversedBoundariesList)
+			{
+				NamesList names;
+				for (const std::string& name : entry.second.second)
+					names.insert(std::cref(m_mapBoundariesList.find(name)->first));
+				entry.second.second = std::move(names);
+			}
+		}
+
+		BoundaryMesh& operator=(const BoundaryMesh&) = delete;
+
 		//Adds new boundary patch
 		void addBoundary(
 			const std::string& strName, 
@@ -77,11 +188,15 @@ public:
 			if (isBoundary(strName)) removeBoundary(strName);
 			m_mapBoundariesList[strName] = std::make_pair(type, label_list(vLabels.begin(), vLabels.end()));
 			typename BoundariesMap::const_iterator it = m_mapBoundariesList.lower_bound(strName);
+			//Hinted inserts take constant time for sorted labels
+			typename ReversedBoundariesMap::iterator hint = m_mapReversedBoundariesList.begin();
 			for (size_t i = 0; i < vLabels.size(); ++i)
 			{
-				std::pair<vector3f, NamesList>& entry = m_mapReversedBoundariesList[vLabels[i]];
+				hint = m_mapReversedBoundariesList.insert(hint, std::make_pair(vLabels[i], std::pair<vector3f, NamesList>()));
+				std::pair<vector3f, NamesList>& entry = hint->second;
 				entry.first = vNormals[i];
 				entry.second.insert(std::cref(it->first));
+				++hint;
 			}
 		}
 
@@ -126,6 +241,13 @@ public:
 		const_iterator end() const { return m_mapReversedBoundariesList.end(); }
 		iterator end() { return m_mapReversedBoundariesList.end(); }
 
+		//Visits names of all boundary patches
+		template<typename visitor>
+		void visitBoundaries(visitor V) const
+		{
+			for (const auto& b : m_mapBoundariesList) V(b.first);
+		}
+
 		//Checks if the name is in the boundaries list
 		bool isBoundary(const std::string& sName) const 
 		{ 
@@ -151,27 +273,144 @@ public:
 			});
 		}
 
+		//Checks if all boundaries of the node are symmetry planes
+		bool isMirror(label l) const
+		{
+			for (const std::string& sName : m_mapReversedBoundariesList.at(l).second)
+				if (m_mapBoundariesList.at(sName).first != MIRROR) return false;
+			return true;
+		}
+
+		//Condition of the node used by operators
+		BoundaryType condition(label l) const
+		{
+			return isFirstType(l) ? FIXED_VAL : isMirror(l) ? MIRROR : ZERO_GRAD;
+		}
+
 		//Gets the normal for given node label
 		vector3f normal(label l) const
 		{
 			return m_mapReversedBoundariesList.at(l).first;
 		}
+
+		/**
+		 * Hash of the conditions operators depend on: boundary nodes, their types and normals.
+		 * Patch names are not used, so differently named patches with the same nodes give the same hash
+		 */
+		size_t conditionsHash() const
+		{
+			size_t hash = m_mapReversedBoundariesList.size();
+			auto combine = [&hash](size_t val) { hash ^= val + 0x9e3779b9 + (hash << 6) + (hash >> 2); };
+			for (const auto& entry : m_mapReversedBoundariesList)
+			{
+				combine(std::hash<label>()(entry.first));
+				combine(condition(entry.first));
+				for (size_t i = 0; i < 3; ++i) combine(std::hash<Float>()(entry.second.first[i]));
+			}
+			return hash;
+		}
+
+		//Checks if operators built for both boundary meshes are the same
+		bool sameConditions(const BoundaryMesh& other) const
+		{
+			if (this == &other) return true;
+			if (m_mapReversedBoundariesList.size() != other.m_mapReversedBoundariesList.size()) return false;
+			for (auto it = begin(), itOther = other.begin(); it != end(); ++it, ++itOther)
+			{
+				if (it->first != itOther->first || condition(it->first) != other.condition(itOther->first)) return false;
+				for (size_t i = 0; i < 3; ++i) if (it->second.first[i] != itOther->second.first[i]) return false;
+			}
+			return true;
+		}
 	};
 
 private:
     graph mesh_connectivity_;
-    node_positions node_positions_;
+    position_array node_positions_;
+
+	//Label maps between user (outer) and mesh (inner) numbering, both are empty if nodes were not renumbered
+	node_labels m_innerLabels;
+	node_labels m_outerLabels;
 
 	//Numeric limit for floating point precision
 	Float m_fEpsilon;
 public:
 	mesh_geometry(const graph& g, const node_positions& np)
-        : mesh_connectivity_(g), node_positions_(np), m_fEpsilon(std::numeric_limits<Float>::epsilon()*100.0)
+        : mesh_connectivity_(g), node_positions_(node_positions(np)), m_fEpsilon(std::numeric_limits<Float>::epsilon()*100.0)
     { 
 		if(g.size() != np.size()) 
 			throw(std::runtime_error("Sizes of graph and node positions array mismatch!"));
 	}
 
+	//Takes over the connectivity graph and node positions without copying
+	mesh_geometry(graph&& g, node_positions&& np)
+		: mesh_connectivity_(std::move(g)), node_positions_(std::move(np)), m_fEpsilon(std::numeric_limits<Float>::epsilon()*100.0)
+	{
+		if (mesh_connectivity_.size() != node_positions_.size())
+			throw(std::runtime_error("Sizes of graph and node positions array mismatch!"));
+	}
+
+	/**
+	 * Renumbers mesh nodes, order[newLabel] = oldLabel
+	 * User labels are kept and can be restored using outerLabel function. Renumbered positions are kept in own memory
+	 */
+	void renumber(const node_labels& order)
+	{
+		LS_PROFILE_SCOPE("mesh_geometry::renumber");
+		if (order.size() != size())
+			throw std::runtime_error("mesh_geometry::renumber: Order and mesh sizes mismatch.");
+
+		node_labels newLabels(size());
+		for (size_t i = 0; i < order.size(); ++i) newLabels[order[i]] = static_cast<label>(i);
+
+		std::vector<typename graph::edge_key> edges;
+		edges.reserve(mesh_connectivity_.connectionsNum());
+		mesh_connectivity_.iterateOverUniqueConnections([&](size_t i, size_t j)
+		{
+			edges.push_back(graph::key(newLabels[i], newLabels[j]));
+		});
+		graph g = graph::fromEdges(edges, size());
+
+		node_positions np(size());
+		for (size_t i = 0; i < order.size(); ++i) np[i] = node_positions_[order[i]];
+
+		mesh_connectivity_ = std::move(g);
+		node_positions_ = position_array(std::move(np));
+
+		//Compose with a previous renumbering
+		node_labels outer(order);
+		if (renumbered()) for (label& l : outer) l = m_outerLabels[l];
+		m_outerLabels = std::move(outer);
+		m_innerLabels = std::move(newLabels);
+		for (size_t i = 0; i < size(); ++i) m_innerLabels[m_outerLabels[i]] = static_cast<label>(i);
+	}
+
+	//Returns mesh connectivity graph
+	const graph& connectivity() const { return mesh_connectivity_; }
+
+	//Returns space positions of all nodes
+	const position_array& positions() const { return node_positions_; }
+
+	/**
+	 * Replaces node positions by the same positions kept elsewhere, e.g. in a memory mapped file,
+	 * the own copy is released
+	 */
+	void set_positions(position_array&& positions)
+	{
+		if (positions.size() != size())
+			throw std::runtime_error("mesh_geometry::set_positions: Positions and mesh sizes mismatch.");
+		node_positions_ = std::move(positions);
+	}
+
+	//Checks if mesh nodes were renumbered
+	bool renumbered() const { return !m_outerLabels.empty(); }
+
+	//Converts user node label to mesh label
+	label innerLabel(label l) const { return renumbered() ? m_innerLabels.at(l) : l; }
+
+	//Converts mesh node label to user label
+	label outerLabel(label l) const { return renumbered() ? m_outerLabels[l] : l; }
+
 	//Sets the precision limit
 	void eps(size_t fFactor)
 	{
@@ -223,7 +462,7 @@ public:
                 max_y = node_positions_[0][1],
                 max_z = node_positions_[0][2];
 
-        typename node_positions::const_iterator it = node_positions_.begin() + 1;
+        typename position_array::const_iterator it = node_positions_.begin() + 1;
         for(; it != node_positions_.end(); ++it)
         {
             min_x = std::min(min_x, (*it)[0]);
@@ -260,7 +499,7 @@ public:
 	/**
 	 * Gets nodes incident to a node with the label id
 	 */
-	inline const label_list& neighbour(label id) const { return mesh_connectivity_.getNeighbour(id); }
+	inline typename graph::range neighbour(label id) const { return mesh_connectivity_.getNeighbour(id); }
 
 	/**
 	 * Visit neigbour points
@@ -280,12 +519,15 @@ public:
 		const vector3f pos{ x, y, z };
 		label result = start;
 		double minSqrDist = math::sqr(node_positions_[start] - pos);
+		LS_PROFILE_COUNT("mesh_geometry::find_closest.calls", 1);
 
 		if (minSqrDist == 0.0) return start;
 
+		size_t visited = 0;
 		mesh_connectivity_.bfs_iterative(start, 
 			[&](label l)->bool 
 		{
+			++visited;
 			double testSqrDist = math::sqr(node_positions_[l] - pos);
 			if (testSqrDist <= minSqrDist)
 			{
@@ -295,6 +537,7 @@ public:
 			}
 			return false;
 		});
+		LS_PROFILE_COUNT("mesh_geometry::find_closest.visited", visited);
 
 		return result;
 	}
@@ -304,7 +547,7 @@ public:
 	label find_line(Float x, Float y, Float z, label start) const
 	{
 		const vector3f pos = vector3f{ x,y,z } - node_positions_[start];
-		const label_list& neighbor = mesh_connectivity_.getNeighbour(start);
+		const typename graph::range neighbor = mesh_connectivity_.getNeighbour(start);
 
 		return *std::max_element(neighbor.begin(), neighbor.end(),
 			[&](label l1, label l2)->bool
@@ -325,7 +568,7 @@ public:
 			e0 = node_positions_[next] - node_positions_[start];
 		pos -= (pos*e0)*e0 / math::sqr(e0);
 
-		const label_list& neighbor = mesh_connectivity_.getNeighbour(start);
+		const typename graph::range neighbor = mesh_connectivity_.getNeighbour(start);
 
 		return *std::max_element(neighbor.begin(), neighbor.end(),
 			[&](label l1, label l2)->bool
@@ -349,7 +592,7 @@ public:
 			e0 = node_positions_[next1] - node_positions_[start],
 			e1 = node_positions_[next2] - node_positions_[start];
 
-		const label_list& neighbor = mesh_connectivity_.getNeighbour(start);
+		const typename graph::range neighbor = mesh_connectivity_.getNeighbour(start);
 
 		return *std::max_element(neighbor.begin(), neighbor.end(),
 			[&](label l1, label l2)->bool
@@ -368,64 +611,61 @@ public:
 
 	/**
 	 * Returns coeffs for field interpolation
+	 * The first label of the stencil is the closest mesh node to x,y,z
 	 */
-	InterpCoefs interpCoefs(Float x, Float y, Float z, label start = 0) const
+	InterpStencil interpStencil(Float x, Float y, Float z, label start = 0) const
 	{
+		LS_PROFILE_SCOPE("mesh_geometry::interpStencil");
+		InterpStencil result;
 		label l0, l1, l2, l3;
 		vector3f pos{ x,y,z };
 		l0 = find_closest(x, y, z, start);
 		vector3f dp0 = pos - node_positions_[l0];
 		if (math::sqr(dp0) < eps())
 		{
-			return InterpCoefs{ InterpCoef(l0, 1.0) };
+			result.add(l0, 1.0);
+			return result;
 		}
-		else
+		l1 = find_line(x, y, z, l0);
+		vector3f e0 = node_positions_[l1] - node_positions_[l0],
+			dp1 = dp0 - (dp0 * e0) * e0 / math::sqr(e0);
+		if (math::sqr(dp1) < eps())
 		{
-			l1 = find_line(x, y, z, l0);
-			vector3f e0 = node_positions_[l1] - node_positions_[l0],
-				dp1 = dp0 - (dp0 * e0) * e0 / math::sqr(e0);
-			if (math::sqr(dp1) < eps())
-			{
-				std::tuple<Float, Float> coefs
-					= math::lineInterpolation(pos, node_positions_[l0], node_positions_[l1]);
-				return InterpCoefs
-				{ 
-					InterpCoef(l0, std::get<0>(coefs)), 
-					InterpCoef(l1, std::get<1>(coefs)) 
-				};
-			}
-			else
-			{
-				l2 = find_plane(x, y, z, l0, l1);
-				vector3f 
-					e1 = node_positions_[l2] - node_positions_[l0],
-					dp2 = dp1 - (dp1 * e1) * e1 / math::sqr(e1);
-				if (math::sqr(dp2) < eps())
-				{
-					std::tuple<Float, Float, Float> coefs
-						= math::triInterpolation(pos, node_positions_[l0], node_positions_[l1], node_positions_[l2]);
-					return InterpCoefs
-					{
-						InterpCoef(l0, std::get<0>(coefs)),
-						InterpCoef(l1, std::get<1>(coefs)),
-						InterpCoef(l2, std::get<2>(coefs))
-					};
-				}
-				else
-				{
-					l3 = find_tet(x, y, z, l0, l1, l2);
-					std::tuple<Float, Float, Float, Float> coefs
-						= math::tetInterpolation(pos, node_positions_[l0], node_positions_[l1], node_positions_[l2], node_positions_[l3]);
-					return InterpCoefs
-					{
-						InterpCoef(l0, std::get<0>(coefs)),
-						InterpCoef(l1, std::get<1>(coefs)),
-						InterpCoef(l2, std::get<2>(coefs)),
-						InterpCoef(l3, std::get<3>(coefs))
-					};
-				}
-			}
+			std::tuple<Float, Float> coefs
+				= math::lineInterpolation(pos, node_positions_[l0], node_positions_[l1]);
+			result.add(l0, std::get<0>(coefs));
+			result.add(l1, std::get<1>(coefs));
+			return result;
+		}
+		l2 = find_plane(x, y, z, l0, l1);
+		vector3f
+			e1 = node_positions_[l2] - node_positions_[l0],
+			dp2 = dp1 - (dp1 * e1) * e1 / math::sqr(e1);
+		if (math::sqr(dp2) < eps())
+		{
+			std::tuple<Float, Float, Float> coefs
+				= math::triInterpolation(pos, node_positions_[l0], node_positions_[l1], node_positions_[l2]);
+			result.add(l0, std::get<0>(coefs));
+			result.add(l1, std::get<1>(coefs));
+			result.add(l2, std::get<2>(coefs));
+			return result;
 		}
+		l3 = find_tet(x, y, z, l0, l1, l2);
+		std::tuple<Float, Float, Float, Float> coefs
+			= math::tetInterpolation(pos, node_positions_[l0], node_positions_[l1], node_positions_[l2], node_positions_[l3]);
+		result.add(l0, std::get<0>(coefs));
+		result.add(l1, std::get<1>(coefs));
+		result.add(l2, std::get<2>(coefs));
+		result.add(l3, std::get<3>(coefs));
+		return result;
+	}
+
+	/**
+	 * Returns coeffs for field interpolation as a map
+	 */
+	InterpCoefs interpCoefs(Float x, Float y, Float z, label start = 0) const
+	{
+		return interpStencil(x, y, z, start).coefs();
 	}
 };
 
@@ -0,0 +1,281 @@
+#pragma once
+#ifndef _NODE_ORDERING_H_
+#define _NODE_ORDERING_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "adjacency.h"
+#include "parallel.h"
+
+//Node renumbering strategies improving memory locality of neighbour accesses.
+//Each function returns an order list: order[newLabel] = oldLabel
+
+/**
+ * Reverse Cuthill-McKee ordering of graph nodes
+ * Every connected component starts at a pseudo-peripheral node
+ */
+template<typename label>
+std::vector<label> reverseCuthillMcKee(const adjacency<label>& g)
+{
+	const size_t n = g.size();
+	std::vector<label> order;
+	order.reserve(n);
+
+	auto degree = [&](label l)->size_t { return g.getNeighbour(l).size(); };
+
+	std::vector<label> byDegree(n);
+	for (size_t i = 0; i < n; ++i) byDegree[i] = static_cast<label>(i);
+	std::stable_sort(byDegree.begin(), byDegree.end(),
+		[&](label l1, label l2)->bool { return degree(l1) < degree(l2); });
+
+	std::vector<bool> visited(n, false);
+	std::vector<size_t> stamp(n, 0), level(n, 0);
+	std::vector<label> queue;
+	queue.reserve(n);
+	size_t search = 0;
+
+	//Breadth first search from start over not numbered nodes
+	//fills queue with the visited nodes and returns the number of levels
+	auto levelStructure = [&](label start)->size_t
+	{
+		++search;
+		queue.clear();
+		queue.push_back(start);
+		stamp[start] = search;
+		level[start] = 0;
+		for (size_t head = 0; head < queue.size(); ++head)
+		{
+			label l = queue[head];
+			for (label ll : g.getNeighbour(l))
+			{
+				if (visited[ll] || stamp[ll] == search) continue;
+				stamp[ll] = search;
+				level[ll] = level[l] + 1;
+				queue.push_back(ll);
+			}
+		}
+		return level[queue.back()];
+	};
+
+	for (label seed : byDegree)
+	{
+		if (visited[seed]) continue;
+
+		//George-Liu search for a pseudo-peripheral node
+		label start = seed;
+		size_t depth = levelStructure(start);
+		for (int attempt = 0; attempt < 8; ++attempt)
+		{
+			label candidate = queue.back();
+			for (size_t i = queue.size(); i-- > 0 && level[queue[i]] == depth;)
+				if (degree(queue[i]) < degree(candidate)) candidate = queue[i];
+			size_t candidateDepth = levelStructure(candidate);
+			if (candidateDepth <= depth) break;
+			start = candidate;
+			depth = candidateDepth;
+		}
+
+		//Cuthill-McKee numbering of the component
+		size_t head = order.size();
+		order.push_back(start);
+		visited[start] = true;
+		std::vector<label> next;
+		for (; head < order.size(); ++head)
+		{
+			next.clear();
+			for (label ll : g.getNeighbour(order[head]))
+				if (!visited[ll])
+				{
+					visited[ll] = true;
+					next.push_back(ll);
+				}
+			std::sort(next.begin(), next.end(),
+				[&](label l1, label l2)->bool { return degree(l1) < degree(l2); });
+			order.insert(order.end(), next.begin(), next.end());
+		}
+	}
+
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+/**
+ * Space filling Z-curve (Morton) ordering of node positions, keys of the nodes are computed by the threads of the runner
+ */
+template<typename label, typename node_positions>
+std::vector<label> mortonOrder(const node_positions& np, const ParallelRunner& run = ParallelRunner())
+{
+	const size_t n = np.size();
+	std::vector<label> order(n);
+	if (n == 0) return order;
+
+	double lo[3] = { np[0][0], np[0][1], np[0][2] }, hi[3] = { np[0][0], np[0][1], np[0][2] };
+	for (const auto& p : np)
+		for (int k = 0; k < 3; ++k)
+		{
+			lo[k] = std::min(lo[k], static_cast<double>(p[k]));
+			hi[k] = std::max(hi[k], static_cast<double>(p[k]));
+		}
+
+	//Spreads 21 lower bits of x to every third bit
+	auto spread = [](uint64_t x)->uint64_t
+	{
+		x &= 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffULL;
+		x = (x | x << 16) & 0x1f0000ff0000ffULL;
+		x = (x | x << 8) & 0x100f00f00f00f00fULL;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+		x = (x | x << 2) & 0x1249249249249249ULL;
+		return x;
+	};
+
+	const double cells = static_cast<double>((1 << 21) - 1);
+	std::vector<uint64_t> keys(n);
+	parallelFor(run, 0, n, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			uint64_t key = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				double span = hi[k] - lo[k];
+				uint64_t q = span > 0.0 ? static_cast<uint64_t>((np[i][k] - lo[k]) / span * cells) : 0;
+				key |= spread(q) << k;
+			}
+			keys[i] = key;
+			order[i] = static_cast<label>(i);
+		}
+	}, 1 << 14);
+	std::stable_sort(order.begin(), order.end(),
+		[&](label l1, label l2)->bool { return keys[l1] < keys[l2]; });
+	return order;
+}
+
+/**
+ * Nested dissection ordering reducing the fill of sparse factorizations: a set of nodes is split by a middle level
+ * of a breadth first search from a pseudo-peripheral node, both halves are numbered recursively and the separating
+ * level goes last. Sets of at most leafSize nodes keep their order
+ */
+template<typename label>
+std::vector<label> nestedDissection(const adjacency<label>& g, size_t leafSize = 64)
+{
+	const size_t n = g.size();
+	std::vector<label> order;
+	order.reserve(n);
+
+	std::vector<size_t> stamp(n, 0), level(n, 0);
+	std::vector<label> queue;
+	size_t search = 0;
+
+	//Breadth first search from start over nodes marked with set, fills queue and returns the number of levels
+	auto levelStructure = [&](label start, size_t set)->size_t
+	{
+		++search;
+		queue.clear();
+		queue.push_back(start);
+		level[start] = 0;
+		stamp[start] = search;
+		for (size_t head = 0; head < queue.size(); ++head)
+		{
+			label l = queue[head];
+			for (label ll : g.getNeighbour(l))
+			{
+				if (stamp[ll] != set) continue;
+				stamp[ll] = search;
+				level[ll] = level[l] + 1;
+				queue.push_back(ll);
+			}
+		}
+		//Nodes of the set are marked again for the next search
+		for (label l : queue) stamp[l] = set;
+		return level[queue.back()] + 1;
+	};
+
+	//Tasks are split sets and separators waiting for numbering, the last one is taken first
+	struct Task
+	{
+		std::vector<label> nodes;
+		bool separator;
+	};
+	std::vector<Task> tasks;
+	tasks.push_back(Task{ std::vector<label>(n), false });
+	for (size_t i = 0; i < n; ++i) tasks.back().nodes[i] = static_cast<label>(i);
+
+	while (!tasks.empty())
+	{
+		Task task = std::move(tasks.back());
+		tasks.pop_back();
+		if (task.separator || task.nodes.size() <= leafSize)
+		{
+			order.insert(order.end(), task.nodes.begin(), task.nodes.end());
+			continue;
+		}
+
+		const size_t set = ++search;
+		for (label l : task.nodes) stamp[l] = set;
+		label start = task.nodes[0];
+		size_t depth = levelStructure(start, set);
+		for (int attempt = 0; attempt < 4 && queue.size() == task.nodes.size(); ++attempt)
+		{
+			const label candidate = queue.back();
+			const size_t candidateDepth = levelStructure(candidate, set);
+			if (candidateDepth <= depth) break;
+			start = candidate;
+			depth = candidateDepth;
+		}
+		depth = levelStructure(start, set);
+
+		//Other connected components are numbered separately
+		if (queue.size() < task.nodes.size())
+		{
+			++search;
+			for (label l : queue) stamp[l] = search;
+			Task rest{ std::vector<label>(), false };
+			for (label l : task.nodes) if (stamp[l] == set) rest.nodes.push_back(l);
+			tasks.push_back(std::move(rest));
+			tasks.push_back(Task{ queue, false });
+			continue;
+		}
+		if (depth < 3)
+		{
+			order.insert(order.end(), task.nodes.begin(), task.nodes.end());
+			continue;
+		}
+
+		//Middle level splits the nodes in halves, its nodes without neighbours in the next level join the first half
+		size_t middle = 0, count = 0;
+		for (size_t i = 0; i < queue.size() && 2 * count < queue.size(); ++i, ++count) middle = level[queue[i]];
+		middle = std::min(std::max<size_t>(middle, 1), depth - 2);
+		Task first{ std::vector<label>(), false }, second{ std::vector<label>(), false }, separator{ std::vector<label>(), true };
+		for (label l : queue)
+		{
+			if (level[l] < middle) first.nodes.push_back(l);
+			else if (level[l] > middle) second.nodes.push_back(l);
+			else
+			{
+				bool separates = false;
+				for (label ll : g.getNeighbour(l)) separates = separates || (stamp[ll] == set && level[ll] > middle);
+				(separates ? separator : first).nodes.push_back(l);
+			}
+		}
+		tasks.push_back(std::move(separator));
+		tasks.push_back(std::move(second));
+		tasks.push_back(std::move(first));
+	}
+	return order;
+}
+
+/**
+ * Moves nodes without connections to the beginning of the order list,
+ * so the last label of a renumbered graph always has neighbours
+ */
+template<typename label>
+void isolatedNodesFirst(std::vector<label>& order, const adjacency<label>& g)
+{
+	std::stable_partition(order.begin(), order.end(),
+		[&](label l)->bool { return g.getNeighbour(l).empty(); });
+}
+
+#endif // !_NODE_ORDERING_H_
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <algorithm>
+#include <functional>
+
+//Parallel loops over index ranges
+
+//body(chunkBegin, chunkEnd) processes a chunk of indices
+using RangeBody = std::function<void(size_t, size_t)>;
+
+/**
+ * Runner of parallel loops supplied by the caller, run(begin, end, grain, body) calls body for chunks covering [begin, end)
+ * and returns when all of them are done, rethrowing an exception of the body. grain is the preferred chunk size,
+ * 0 leaves it to the runner. An empty runner makes the loops serial
+ */
+using ParallelRunner = std::function<void(size_t, size_t, size_t, const RangeBody&)>;
+
+/**
+ * Calls body(chunkBegin, chunkEnd) for chunks of [begin, end) using the runner, the chunks can be processed
+ * from different threads and in any order
+ */
+template<typename body>
+void parallelFor(const ParallelRunner& run, size_t begin, size_t end, body B, size_t grain = 0)
+{
+	if (begin >= end) return;
+	if (!run) B(begin, end);
+	else run(begin, end, grain, RangeBody(B));
+}
+
+/**
+ * Calls body(block) for blocks [block * blockSize, (block + 1) * blockSize) of [0, n) which do not depend on the runner.
+ * It is used where results should not depend on the chunks chosen by the runner
+ */
+template<typename body>
+void parallelBlocks(const ParallelRunner& run, size_t n, size_t blockSize, body B)
+{
+	const size_t nBlocks = (n + blockSize - 1) / blockSize;
+	parallelFor(run, 0, nBlocks, [&](size_t begin, size_t end)
+	{
+		for (size_t block = begin; block < end; ++block) B(block);
+	}, 1);
+}
+
+#endif // !_PARALLEL_H_
@@ -0,0 +1,247 @@
+#pragma once
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+//Solver instrumentation. Scoped timers and counters are compiled only if LS_PROFILING is defined,
+//otherwise the macros below expand to nothing
+
+#define LS_PROFILE_CONCAT_(a, b) a##b
+#define LS_PROFILE_CONCAT(a, b) LS_PROFILE_CONCAT_(a, b)
+
+#ifdef LS_PROFILING
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <functional>
+
+/**
+ * Collects phase timings, counters and optional trace events
+ */
+class profiler
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	//Timing statistics of one instrumented phase
+	struct phase
+	{
+		std::string name;
+		std::atomic<unsigned long long> calls, totalNs, minNs, maxNs;
+
+		phase(const std::string& sName) : name(sName), calls(0), totalNs(0), minNs(~0ULL), maxNs(0) {}
+
+		void add(unsigned long long ns)
+		{
+			++calls;
+			totalNs += ns;
+			unsigned long long cur = minNs.load(std::memory_order_relaxed);
+			while (ns < cur && !minNs.compare_exchange_weak(cur, ns));
+			cur = maxNs.load(std::memory_order_relaxed);
+			while (ns > cur && !maxNs.compare_exchange_weak(cur, ns));
+		}
+	};
+
+	//Accumulated value of one counter
+	struct counter
+	{
+		std::string name;
+		std::atomic<unsigned long long> value;
+
+		counter(const std::string& sName) : name(sName), value(0) {}
+	};
+
+	//Complete event of a chrome trace
+	struct trace_event
+	{
+		const phase* pPhase;
+		size_t threadId;
+		unsigned long long startNs, durationNs;
+	};
+
+private:
+	//Deques keep element addresses on growth, instrumented sites hold references to their entries
+	std::deque<phase> m_phases;
+	std::deque<counter> m_counters;
+	std::vector<trace_event> m_trace;
+	std::atomic<bool> m_bTrace;
+	clock::time_point m_start;
+	mutable std::mutex m_mutex;
+
+	//Trace size limit, later events are dropped
+	static const size_t s_maxTraceEvents = 1 << 22;
+
+	profiler() : m_bTrace(false), m_start(clock::now()) {}
+
+	//Visits names and values of registered counters and of the allocation counters, the lock must be held
+	template<typename counter_visitor>
+	void visitCounters(counter_visitor CV) const
+	{
+		for (const counter& c : m_counters) CV(c.name, c.value.load());
+		CV("allocations", allocationCount().load());
+		CV("allocated_bytes", allocatedBytes().load());
+	}
+
+public:
+	static profiler& instance()
+	{
+		static profiler p;
+		return p;
+	}
+
+	//Buffers allocated at the instrumented allocation points of the library
+	static std::atomic<unsigned long long>& allocationCount()
+	{
+		static std::atomic<unsigned long long> n(0);
+		return n;
+	}
+
+	static std::atomic<unsigned long long>& allocatedBytes()
+	{
+		static std::atomic<unsigned long long> n(0);
+		return n;
+	}
+
+	static void countAllocation(size_t nBytes)
+	{
+		allocationCount().fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes().fetch_add(nBytes, std::memory_order_relaxed);
+	}
+
+	//Registers new phase or returns the existing one with the same name
+	phase& getPhase(const std::string& sName)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (phase& p : m_phases) if (p.name == sName) return p;
+		m_phases.emplace_back(sName);
+		return m_phases.back();
+	}
+
+	//Registers new counter or returns the existing one with the same name
+	counter& getCounter(const std::string& sName)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (counter& c : m_counters) if (c.name == sName) return c;
+		m_counters.emplace_back(sName);
+		return m_counters.back();
+	}
+
+	//Switches recording of trace events
+	void trace(bool bTrace) { m_bTrace = bTrace; }
+	bool trace() const { return m_bTrace; }
+
+	//Nanoseconds since profiler creation
+	unsigned long long now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_start).count();
+	}
+
+	void addEvent(const phase& p, unsigned long long startNs, unsigned long long durationNs)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_trace.size() >= s_maxTraceEvents) return;
+		m_trace.push_back(trace_event{ &p, std::hash<std::thread::id>()(std::this_thread::get_id()), startNs, durationNs });
+	}
+
+	//Sets all statistics to zero and clears the trace
+	void reset()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (phase& p : m_phases)
+		{
+			p.calls = 0; p.totalNs = 0; p.minNs = ~0ULL; p.maxNs = 0;
+		}
+		for (counter& c : m_counters) c.value = 0;
+		allocationCount() = 0;
+		allocatedBytes() = 0;
+		m_trace.clear();
+	}
+
+	//Visits all phases and names with values of all counters
+	template<typename phase_visitor, typename counter_visitor>
+	void visit(phase_visitor PV, counter_visitor CV) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const phase& p : m_phases) PV(p);
+		visitCounters(CV);
+	}
+
+	//Writes trace events and final counter values in chrome://tracing JSON format
+	bool exportChromeTrace(const std::string& sFileName) const
+	{
+		std::ofstream out(sFileName);
+		if (!out) return false;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<size_t> threads;
+		out << std::fixed;
+		out.precision(3);
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		for (const trace_event& e : m_trace)
+		{
+			size_t tid = std::find(threads.begin(), threads.end(), e.threadId) - threads.begin();
+			if (tid == threads.size()) threads.push_back(e.threadId);
+			out << (first ? "\n" : ",\n")
+				<< "{\"name\":\"" << e.pPhase->name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+				<< ",\"ts\":" << e.startNs / 1000.0 << ",\"dur\":" << e.durationNs / 1000.0 << "}";
+			first = false;
+		}
+		const unsigned long long ts = now();
+		visitCounters([&](const std::string& sName, unsigned long long value)
+		{
+			out << (first ? "\n" : ",\n")
+				<< "{\"name\":\"" << sName << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << ts / 1000.0
+				<< ",\"args\":{\"value\":" << value << "}}";
+			first = false;
+		});
+		out << "\n]}\n";
+		return static_cast<bool>(out);
+	}
+
+	/**
+	 * Measures time of the scope where it was created
+	 */
+	class scoped_timer
+	{
+		phase& m_phase;
+		unsigned long long m_start;
+	public:
+		scoped_timer(phase& p) : m_phase(p), m_start(profiler::instance().now()) {}
+		~scoped_timer()
+		{
+			profiler& prof = profiler::instance();
+			unsigned long long duration = prof.now() - m_start;
+			m_phase.add(duration);
+			if (prof.trace()) prof.addEvent(m_phase, m_start, duration);
+		}
+	};
+};
+
+#define LS_PROFILE_SCOPE(sName) \
+	static profiler::phase& LS_PROFILE_CONCAT(_ls_phase_, __LINE__) = profiler::instance().getPhase(sName); \
+	profiler::scoped_timer LS_PROFILE_CONCAT(_ls_timer_, __LINE__)(LS_PROFILE_CONCAT(_ls_phase_, __LINE__))
+
+#define LS_PROFILE_COUNT(sName, n) \
+	do { \
+		static profiler::counter& _ls_counter = profiler::instance().getCounter(sName); \
+		_ls_counter.value.fetch_add(static_cast<unsigned long long>(n), std::memory_order_relaxed); \
+	} while (false)
+
+//Counts one allocation of nBytes made by the library for matrices and work vectors
+#define LS_PROFILE_ALLOC(nBytes) profiler::countAllocation(nBytes)
+
+#else
+
+#define LS_PROFILE_SCOPE(sName)
+#define LS_PROFILE_COUNT(sName, n) do {} while (false)
+#define LS_PROFILE_ALLOC(nBytes) do {} while (false)
+
+#endif // LS_PROFILING
+
+#endif // !_PROFILER_H_
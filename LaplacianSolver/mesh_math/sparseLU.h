@@ -0,0 +1,273 @@
+#pragma once
+#ifndef _SPARSE_LU_H_
+#define _SPARSE_LU_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "adjacency.h"
+#include "nodeOrdering.h"
+#include "profiler.h"
+
+/**
+ * LU factorization of a sparse matrix without pivoting, it suits diagonally dominant matrices as I - A
+ * of the laplacian solver. Rows are numbered by nested dissection of the symmetrized matrix structure,
+ * the fill is found from the elimination tree before the numeric factorization. Chains of the tree whose rows
+ * share the structure below them form supernodes, the factor of a supernode is kept dense and the factorization
+ * is left-looking: every supernode gathers the updates of the supernodes below it as dense products, then factors
+ * its diagonal block, in one thread. A pivot which is not larger than the relative tolerance times the largest element
+ * of its row means a singular or nearly singular matrix, e.g. a part of the mesh without fixed values, and is rejected
+ */
+class SparseLU
+{
+	size_t m_n;
+	std::vector<uint32_t> m_order; //Factor row k is the matrix row m_order[k]
+
+	//Supernode J has the factor rows m_superStart[J] ... m_superStart[J + 1] - 1
+	std::vector<uint32_t> m_superStart;
+
+	//Factor rows below every supernode in ascending order, they are the structure of its columns of L and rows of U
+	std::vector<size_t> m_belowStart;
+	std::vector<uint32_t> m_below;
+
+	//Dense factor of every supernode of s rows with b rows below it: s x s diagonal block with L under the diagonal
+	//and U on and above it, b x s of L below it, then U right of it by columns, b x s, all row-major
+	std::vector<size_t> m_blockStart;
+	std::vector<double> m_vals;
+
+	size_t superSize(size_t J) const { return m_superStart[J + 1] - m_superStart[J]; }
+	size_t belowSize(size_t J) const { return m_belowStart[J + 1] - m_belowStart[J]; }
+
+	//Rows of L of the supernode starting from its diagonal block
+	const double* lower(size_t J) const { return m_vals.data() + m_blockStart[J]; }
+	double* lower(size_t J) { return m_vals.data() + m_blockStart[J]; }
+
+	//Columns of U right of the diagonal block of the supernode
+	const double* upper(size_t J) const { return lower(J) + (superSize(J) + belowSize(J)) * superSize(J); }
+	double* upper(size_t J) { return lower(J) + (superSize(J) + belowSize(J)) * superSize(J); }
+
+	static double dot(const double* a, const double* b, size_t n)
+	{
+		double result = 0.0;
+		for (size_t t = 0; t < n; ++t) result += a[t] * b[t];
+		return result;
+	}
+
+public:
+	//Factorizes the square matrix M, it should provide size() and visitRow(i, V) calling V(col, coef)
+	template<typename matrix>
+	explicit SparseLU(const matrix& M, double pivotTolerance = 1e-12)
+		:
+		m_n(M.size())
+	{
+		LS_PROFILE_SCOPE("SparseLU::factorize");
+		using graph = adjacency<uint32_t>;
+		const uint32_t none = static_cast<uint32_t>(-1);
+
+		//Fill reducing order of the symmetrized structure
+		std::vector<graph::edge_key> edges;
+		for (uint32_t i = 0; i < m_n; ++i) M.visitRow(i, [&](uint32_t col, double) { edges.push_back(graph::key(i, col)); });
+		graph structure = graph::fromEdges(edges, m_n);
+		m_order = nestedDissection(structure, 64);
+		std::vector<uint32_t> position(m_n);
+		for (uint32_t k = 0; k < m_n; ++k) position[m_order[k]] = k;
+		edges.clear();
+		for (uint32_t k = 0; k < m_n; ++k)
+			for (uint32_t l : structure.getNeighbour(m_order[k])) if (position[l] < k) edges.push_back(graph::key(k, position[l]));
+		structure = graph::fromEdges(edges, m_n);
+		std::vector<graph::edge_key>().swap(edges);
+
+		//Elimination tree
+		std::vector<uint32_t> parent(m_n, none), ancestor(m_n, none);
+		for (uint32_t k = 0; k < m_n; ++k)
+			for (uint32_t i : structure.getNeighbour(k))
+				for (uint32_t next; i < k; i = next)
+				{
+					next = ancestor[i];
+					ancestor[i] = k;
+					if (next == none)
+					{
+						parent[i] = k;
+						break;
+					}
+				}
+		std::vector<uint32_t>().swap(ancestor);
+
+		//Row k of L has the nodes of the tree on the paths from the neighbours of k up to k,
+		//the columns are listed by two passes over the paths, the first one counts them
+		std::vector<uint32_t> mark(m_n, none);
+		std::vector<size_t> colStart(m_n + 1, 0);
+		std::vector<uint32_t> colRows;
+		auto visitPaths = [&](auto V)
+		{
+			std::fill(mark.begin(), mark.end(), none);
+			for (uint32_t k = 0; k < m_n; ++k)
+			{
+				mark[k] = k;
+				for (uint32_t i : structure.getNeighbour(k))
+					for (; i < k && mark[i] != k; i = parent[i])
+					{
+						mark[i] = k;
+						V(i, k);
+					}
+			}
+		};
+		visitPaths([&](uint32_t i, uint32_t) { ++colStart[i + 1]; });
+		for (size_t i = 0; i < m_n; ++i) colStart[i + 1] += colStart[i];
+		colRows.resize(colStart[m_n]);
+		std::vector<size_t> pos(colStart.begin(), colStart.end() - 1);
+		visitPaths([&](uint32_t i, uint32_t k) { colRows[pos[i]++] = k; });
+		std::vector<uint32_t>().swap(mark);
+
+		//Column k joins the supernode of column k - 1 if it is its parent and has its structure without k
+		std::vector<uint32_t> superOf(m_n);
+		for (uint32_t k = 0; k < m_n; ++k)
+		{
+			if (k == 0 || parent[k - 1] != k || colStart[k] - colStart[k - 1] != colStart[k + 1] - colStart[k] + 1)
+				m_superStart.push_back(k);
+			superOf[k] = static_cast<uint32_t>(m_superStart.size() - 1);
+		}
+		const size_t nSuper = m_superStart.size();
+		m_superStart.push_back(static_cast<uint32_t>(m_n));
+		m_belowStart.assign(1, 0);
+		m_blockStart.assign(1, 0);
+		for (size_t J = 0; J < nSuper; ++J)
+		{
+			const uint32_t first = m_superStart[J], last = m_superStart[J + 1] - 1;
+			for (size_t m = colStart[first]; m < colStart[first + 1]; ++m) if (colRows[m] > last) m_below.push_back(colRows[m]);
+			m_belowStart.push_back(m_below.size());
+			m_blockStart.push_back(m_blockStart.back() + superSize(J) * (superSize(J) + 2 * belowSize(J)));
+		}
+		std::vector<size_t>().swap(colStart);
+		std::vector<uint32_t>().swap(colRows);
+		m_vals.assign(m_blockStart.back(), 0.0);
+		LS_PROFILE_ALLOC(m_vals.size() * sizeof(double));
+
+		//Supernodes updating every supernode with the first of their rows below it, in ascending order
+		std::vector<size_t> updateStart(nSuper + 1, 0);
+		std::vector<std::pair<uint32_t, size_t>> updates;
+		auto visitUpdates = [&](auto V)
+		{
+			for (uint32_t K = 0; K < nSuper; ++K)
+				for (size_t m = m_belowStart[K]; m < m_belowStart[K + 1]; ++m)
+					if (m == m_belowStart[K] || superOf[m_below[m]] != superOf[m_below[m - 1]]) V(superOf[m_below[m]], K, m - m_belowStart[K]);
+		};
+		visitUpdates([&](uint32_t J, uint32_t, size_t) { ++updateStart[J + 1]; });
+		for (size_t J = 0; J < nSuper; ++J) updateStart[J + 1] += updateStart[J];
+		updates.resize(updateStart[nSuper]);
+		std::vector<size_t> next(updateStart.begin(), updateStart.end() - 1);
+		visitUpdates([&](uint32_t J, uint32_t K, size_t p) { updates[next[J]++] = std::make_pair(K, p); });
+		std::vector<size_t>().swap(next);
+
+		//Matrix elements go to the supernode of the smaller of their row and column
+		auto belowIndex = [&](size_t J, uint32_t row)->size_t
+		{
+			return std::lower_bound(m_below.begin() + m_belowStart[J], m_below.begin() + m_belowStart[J + 1], row)
+				- (m_below.begin() + m_belowStart[J]);
+		};
+		std::vector<double> rowScale(m_n, 0.0);
+		for (uint32_t k = 0; k < m_n; ++k)
+			M.visitRow(m_order[k], [&](uint32_t col, double coef)
+			{
+				const uint32_t c = position[col];
+				rowScale[k] = std::max(rowScale[k], std::fabs(coef));
+				const size_t J = superOf[std::min(k, c)], s = superSize(J);
+				const uint32_t first = m_superStart[J];
+				if (superOf[k] == superOf[c]) lower(J)[(k - first) * s + c - first] += coef;
+				else if (c < k) lower(J)[(s + belowIndex(J, k)) * s + c - first] += coef;
+				else upper(J)[belowIndex(J, c) * s + k - first] += coef;
+			});
+
+		std::vector<uint32_t> relative(m_n); //Index of a row below the current supernode in its rows
+		for (size_t J = 0; J < nSuper; ++J)
+		{
+			const uint32_t first = m_superStart[J], last = m_superStart[J + 1] - 1;
+			const size_t s = superSize(J), b = belowSize(J);
+			const uint32_t* below = m_below.data() + m_belowStart[J];
+			for (size_t i = 0; i < b; ++i) relative[below[i]] = static_cast<uint32_t>(s + i);
+			double* L = lower(J), *U = upper(J);
+			auto rowIndex = [&](uint32_t row)->size_t { return row <= last ? row - first : relative[row]; };
+
+			//Rows p ... of K lie in the rows of J, rows p ... p + q - 1 of them in J itself
+			for (size_t u = updateStart[J]; u < updateStart[J + 1]; ++u)
+			{
+				const uint32_t K = updates[u].first;
+				const size_t p = updates[u].second, sK = superSize(K), bK = belowSize(K);
+				const uint32_t* rowsK = m_below.data() + m_belowStart[K];
+				const double* LK = lower(K) + sK * sK, *UK = upper(K);
+				size_t q = 0;
+				while (p + q < bK && rowsK[p + q] <= last) ++q;
+				for (size_t i = p; i < bK; ++i)
+				{
+					double* target = L + rowIndex(rowsK[i]) * s;
+					for (size_t j = p; j < p + q; ++j) target[rowsK[j] - first] -= dot(LK + i * sK, UK + j * sK, sK);
+				}
+				for (size_t j = p + q; j < bK; ++j)
+				{
+					double* target = U + (relative[rowsK[j]] - s) * s;
+					for (size_t i = p; i < p + q; ++i) target[rowsK[i] - first] -= dot(LK + i * sK, UK + j * sK, sK);
+				}
+			}
+
+			//Dense elimination of the diagonal block, rows below and columns right of it follow
+			for (size_t t = 0; t < s; ++t)
+			{
+				const double pivot = L[t * s + t];
+				if (!(std::fabs(pivot) > pivotTolerance * rowScale[first + t]))
+					throw std::runtime_error("SparseLU::SparseLU: Pivot below the relative tolerance, the matrix is singular or nearly singular.");
+				for (size_t r = t + 1; r < s + b; ++r)
+				{
+					double* row = L + r * s;
+					const double l = row[t] /= pivot;
+					for (size_t c = t + 1; c < s; ++c) row[c] -= l * L[t * s + c];
+					if (r < s) for (size_t j = 0; j < b; ++j) U[j * s + r] -= l * U[j * s + t];
+				}
+			}
+		}
+	}
+
+	//Gets the size of the matrix
+	size_t size() const { return m_n; }
+
+	//Gets the number of stored elements of L and U
+	size_t nonZeros() const { return m_vals.size(); }
+
+	//Replaces b by the solution of M x = b
+	void solve(std::vector<double>& b) const
+	{
+		LS_PROFILE_SCOPE("SparseLU::solve");
+		if (b.size() != m_n) throw std::runtime_error("SparseLU::solve: Matrix and vector sizes mismatch.");
+		std::vector<double> y(m_n);
+		for (size_t k = 0; k < m_n; ++k) y[k] = b[m_order[k]];
+		const size_t nSuper = m_superStart.size() - 1;
+		for (size_t J = 0; J < nSuper; ++J)
+		{
+			const size_t s = superSize(J), nBelow = belowSize(J);
+			const uint32_t* below = m_below.data() + m_belowStart[J];
+			const double* L = lower(J);
+			double* x = y.data() + m_superStart[J];
+			for (size_t t = 0; t < s; ++t) x[t] -= dot(L + t * s, x, t);
+			for (size_t i = 0; i < nBelow; ++i) y[below[i]] -= dot(L + (s + i) * s, x, s);
+		}
+		for (size_t J = nSuper; J-- > 0;)
+		{
+			const size_t s = superSize(J), nBelow = belowSize(J);
+			const uint32_t* below = m_below.data() + m_belowStart[J];
+			const double* L = lower(J), *U = upper(J);
+			double* x = y.data() + m_superStart[J];
+			for (size_t j = 0; j < nBelow; ++j)
+			{
+				const double val = y[below[j]];
+				for (size_t t = 0; t < s; ++t) x[t] -= U[j * s + t] * val;
+			}
+			for (size_t t = s; t-- > 0;)
+				x[t] = (x[t] - dot(L + t * s + t + 1, x + t + 1, s - t - 1)) / L[t * s + t];
+		}
+		for (size_t k = 0; k < m_n; ++k) b[m_order[k]] = y[k];
+	}
+};
+
+#endif // !_SPARSE_LU_H_
@@ -0,0 +1,88 @@
+// Batch laplacian solver: solves a list of jobs and prints a summary report of their timing and memory.
+//
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "batchPipeline.h"
+
+namespace
+{
+	void writeReport(std::ostream& out, const std::vector<JobReport>& reports, double totalMs, char separator)
+	{
+		const bool table = separator == ' ';
+		auto column = [&](int width) -> std::ostream& { if (table) out << std::setw(width); return out; };
+		const char* header[] = { "job", "mesh", "operator", "load_ms", "setup_ms", "solve_ms", "write_ms", "memory_mb", "peak_mb" };
+		const int widths[] = { 16, 8, 9, 10, 10, 10, 10, 10, 10 };
+		for (size_t k = 0; k < 9; ++k) column(widths[k]) << header[k] << (k < 8 ? std::string(1, separator) : "");
+		out << (table ? "\n" : std::string(1, separator) + "error\n");
+		out << std::fixed << std::setprecision(1);
+		double stagesMs = 0;
+		for (const JobReport& r : reports)
+		{
+			column(widths[0]) << r.name << separator;
+			column(widths[1]) << (r.meshLoaded ? "loaded" : "cached") << separator;
+			column(widths[2]) << (r.operatorBuilt ? "built" : "cached") << separator;
+			column(widths[3]) << r.loadMs << separator;
+			column(widths[4]) << r.setupMs << separator;
+			column(widths[5]) << r.solveMs << separator;
+			column(widths[6]) << r.writeMs << separator;
+			column(widths[7]) << r.memoryMb << separator;
+			column(widths[8]) << r.peakMb;
+			if (!table) out << separator << r.error;
+			else if (!r.error.empty()) out << "  failed: " << r.error;
+			out << "\n";
+			stagesMs += r.loadMs + r.setupMs + r.solveMs + r.writeMs;
+		}
+		if (table) out << "total " << totalMs << " ms, sum of stages " << stagesMs << " ms\n";
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: batch <job list> [-report <file.csv>] [-cache <number of meshes>]\n";
+		return 1;
+	}
+	std::string reportFile;
+	size_t cacheSize = 4;
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "-report") reportFile = argv[i + 1];
+		else if (option == "-cache") cacheSize = std::stoul(argv[i + 1]);
+		else
+		{
+			std::cout << "Unknown option " << option << "\n";
+			return 1;
+		}
+	}
+
+	try
+	{
+		const std::vector<Job> jobs = readJobList(argv[1]);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const std::vector<JobReport> reports = runJobs(jobs, cacheSize);
+		const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		writeReport(std::cout, reports, totalMs, ' ');
+		if (!reportFile.empty())
+		{
+			std::ofstream out(reportFile);
+			if (!out) throw std::runtime_error("Cannot open report file " + reportFile + ".");
+			writeReport(out, reports, totalMs, ',');
+		}
+		for (const JobReport& r : reports) if (!r.error.empty()) return 2;
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+}
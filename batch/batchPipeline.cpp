@@ -0,0 +1,191 @@
+#define _USE_LS_DLL_
+#include "batchPipeline.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#include "meshCache.h"
+#include "stageQueue.h"
+
+//windows.h is included by the library headers
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	//Current and peak memory of the process in megabytes
+	void processMemory(double& current, double& peak)
+	{
+		const double mb = 1024.0 * 1024.0;
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		current = counters.WorkingSetSize / mb;
+		peak = counters.PeakWorkingSetSize / mb;
+#else
+		long pages = 0, resident = 0;
+		std::ifstream("/proc/self/statm") >> pages >> resident;
+		current = resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / mb;
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		peak = usage.ru_maxrss / 1024.0;
+#endif // _WIN32
+	}
+
+	struct LoadedJob
+	{
+		size_t index;
+		std::shared_ptr<MeshEntry> pEntry;
+		JobReport report;
+	};
+
+	struct SolvedJob
+	{
+		size_t index;
+		std::shared_ptr<MeshEntry> pEntry; //The mesh lives until its output is written
+		FieldWriter* pWriter;
+		Clock::time_point writeStart;
+		JobReport report;
+	};
+
+	//Stage 1: reads meshes and boundaries, cached meshes are taken at once
+	void loadJobs(const std::vector<Job>& jobs, MeshCache& cache, StageQueue<LoadedJob>& out)
+	{
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			LoadedJob loaded;
+			loaded.index = i;
+			loaded.report.name = jobs[i].name;
+			const Clock::time_point start = Clock::now();
+			try
+			{
+				loaded.pEntry = cache.get(jobs[i], loaded.report.meshLoaded);
+			}
+			catch (const std::exception& e)
+			{
+				loaded.report.error = e.what();
+			}
+			loaded.report.loadMs = millisecondsSince(start);
+			out.push(std::move(loaded));
+		}
+		out.close();
+	}
+
+	//Stage 2: sets boundary conditions, solves and starts writing of the output
+	void solveJob(const Job& job, LoadedJob& loaded, SolvedJob& solved)
+	{
+		JobReport& report = solved.report;
+		Clock::time_point start = Clock::now();
+		PotentialField* f = loaded.pEntry->createField(job);
+		ScalarFieldOperator* op = NULL;
+		try
+		{
+			const DirectSolver* solver = NULL;
+			if (job.method == DIRECT) solver = loaded.pEntry->directSolver(job, f, report.operatorBuilt);
+			else op = loaded.pEntry->solverOperator(f, report.operatorBuilt);
+			report.setupMs = millisecondsSince(start);
+
+			start = Clock::now();
+			switch (job.method)
+			{
+			case JACOBI: op->applyTiled(f, job.nIterations); break;
+			case CHEBYSHEV: op->applyChebyshev(f, job.nIterations); break;
+			case DIRECT: solver->solve(f); break;
+			}
+			report.solveMs = millisecondsSince(start);
+
+			const bool vtk = job.output.size() > 4 && job.output.compare(job.output.size() - 4, 4, ".vtu") == 0;
+			solved.pWriter = FieldWriter::create(loaded.pEntry->mesh(), job.output, vtk ? FieldWriter::VTK : FieldWriter::RAW);
+			solved.pWriter->addField("potential", f);
+			solved.writeStart = Clock::now();
+			solved.pWriter->write();
+		}
+		catch (...)
+		{
+			if (op) ScalarFieldOperator::free(op);
+			PotentialField::free(f);
+			throw;
+		}
+		//The writer keeps a snapshot of the values
+		if (op) ScalarFieldOperator::free(op);
+		PotentialField::free(f);
+	}
+
+	//Stage 2 for all jobs
+	void solveJobs(const std::vector<Job>& jobs, StageQueue<LoadedJob>& in, StageQueue<SolvedJob>& out)
+	{
+		for (LoadedJob loaded; in.pop(loaded);)
+		{
+			SolvedJob solved;
+			solved.index = loaded.index;
+			solved.pWriter = NULL;
+			solved.report = loaded.report;
+			if (loaded.pEntry)
+			{
+				try
+				{
+					solveJob(jobs[loaded.index], loaded, solved);
+				}
+				catch (const std::exception& e)
+				{
+					solved.report.error = e.what();
+				}
+				processMemory(solved.report.memoryMb, solved.report.peakMb);
+			}
+			solved.pEntry = std::move(loaded.pEntry);
+			out.push(std::move(solved));
+		}
+		out.close();
+	}
+
+	//Stage 3: waits for the outputs and collects reports
+	void writeJobs(StageQueue<SolvedJob>& in, std::vector<JobReport>& reports)
+	{
+		for (SolvedJob solved; in.pop(solved);)
+		{
+			if (solved.pWriter)
+			{
+				try
+				{
+					solved.pWriter->wait();
+				}
+				catch (const std::exception& e)
+				{
+					solved.report.error = e.what();
+				}
+				solved.report.writeMs = millisecondsSince(solved.writeStart);
+				FieldWriter::free(solved.pWriter);
+			}
+			solved.pEntry.reset();
+			reports[solved.index] = solved.report;
+		}
+	}
+}
+
+std::vector<JobReport> runJobs(const std::vector<Job>& jobs, size_t cacheSize)
+{
+	MeshCache cache(cacheSize);
+	StageQueue<LoadedJob> loaded(1);
+	StageQueue<SolvedJob> solved(2);
+	std::vector<JobReport> reports(jobs.size());
+
+	std::thread loader(loadJobs, std::cref(jobs), std::ref(cache), std::ref(loaded));
+	std::thread writer(writeJobs, std::ref(solved), std::ref(reports));
+	solveJobs(jobs, loaded, solved);
+	loader.join();
+	writer.join();
+	return reports;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef _BATCH_PIPELINE_H_
+#define _BATCH_PIPELINE_H_
+
+#include <string>
+#include <vector>
+
+#include "jobList.h"
+
+//Timing and memory of a job in the summary report
+struct JobReport
+{
+	std::string name;
+	bool meshLoaded;    //Mesh was read, otherwise it was taken from the cache
+	bool operatorBuilt; //Operator or factorization was built, otherwise it was taken from the cache
+	double loadMs, setupMs, solveMs, writeMs;
+	double memoryMb, peakMb; //Memory of the process after the solve
+	std::string error;
+
+	JobReport() : meshLoaded(false), operatorBuilt(false), loadMs(0), setupMs(0), solveMs(0), writeMs(0), memoryMb(0), peakMb(0) {}
+};
+
+/**
+ * Solves jobs in a pipeline of three stages. The loading stage reads meshes of the next jobs while the current job
+ * is solved and the writing stage finishes the outputs of the previous jobs. At most cacheSize meshes are kept
+ * between jobs. A failed job gets its error in the report, the other jobs still run. Reports follow the order of jobs
+ */
+std::vector<JobReport> runJobs(const std::vector<Job>& jobs, size_t cacheSize);
+
+#endif // !_BATCH_PIPELINE_H_
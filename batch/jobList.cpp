@@ -0,0 +1,105 @@
+#include "jobList.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+	std::string directoryOf(const std::string& fileName)
+	{
+		const size_t pos = fileName.find_last_of("\\/");
+		return pos == std::string::npos ? std::string() : fileName.substr(0, pos + 1);
+	}
+
+	std::string pathFrom(const std::string& dir, const std::string& path)
+	{
+		const bool absolute = !path.empty() && (path[0] == '\\' || path[0] == '/' || (path.size() > 1 && path[1] == ':'));
+		return absolute ? path : dir + path;
+	}
+
+	std::runtime_error jobError(const std::string& fileName, size_t line, const std::string& message)
+	{
+		return std::runtime_error("readJobList: " + fileName + ":" + std::to_string(line) + ": " + message);
+	}
+}
+
+std::string Job::meshKey() const
+{
+	return meshFile + '|' + regionsFile + '|' + ordering;
+}
+
+std::string Job::operatorKey() const
+{
+	std::vector<std::string> sorted(zeroGrad);
+	std::sort(sorted.begin(), sorted.end());
+	std::string key = method == DIRECT ? "direct" : "operator";
+	for (const std::string& name : sorted) key += '|' + name;
+	return key;
+}
+
+std::vector<Job> readJobList(const std::string& fileName)
+{
+	std::ifstream in(fileName);
+	if (!in) throw std::runtime_error("readJobList: Cannot open job list " + fileName + ".");
+	const std::string dir = directoryOf(fileName);
+
+	std::vector<Job> jobs;
+	bool inJob = false;
+	std::string line;
+	for (size_t nLine = 1; std::getline(in, line); ++nLine)
+	{
+		std::istringstream words(line);
+		std::string key;
+		if (!(words >> key) || key[0] == '#') continue;
+		if (key == "job")
+		{
+			if (inJob) throw jobError(fileName, nLine, "Previous job has no end.");
+			inJob = true;
+			jobs.push_back(Job());
+			jobs.back().line = nLine;
+			if (!(words >> jobs.back().name)) jobs.back().name = "job" + std::to_string(jobs.size());
+			continue;
+		}
+		if (!inJob) throw jobError(fileName, nLine, "Line out of a job.");
+		Job& job = jobs.back();
+		if (key == "end")
+		{
+			if (job.meshFile.empty() || job.regionsFile.empty() || job.output.empty())
+				throw jobError(fileName, nLine, "Job should have mesh, regions and output.");
+			inJob = false;
+		}
+		else if (key == "mesh" && words >> job.meshFile) job.meshFile = pathFrom(dir, job.meshFile);
+		else if (key == "regions" && words >> job.regionsFile) job.regionsFile = pathFrom(dir, job.regionsFile);
+		else if (key == "output" && words >> job.output) job.output = pathFrom(dir, job.output);
+		else if (key == "ordering" && words >> job.ordering)
+		{
+			if (job.ordering != "natural" && job.ordering != "rcm" && job.ordering != "morton")
+				throw jobError(fileName, nLine, "Unknown ordering " + job.ordering + ".");
+		}
+		else if (key == "zero_grad")
+		{
+			for (std::string name; words >> name;) job.zeroGrad.push_back(name);
+		}
+		else if (key == "voltage")
+		{
+			std::pair<std::string, double> voltage;
+			if (!(words >> voltage.first >> voltage.second)) throw jobError(fileName, nLine, "Voltage needs a boundary and a value.");
+			job.voltages.push_back(voltage);
+		}
+		else if (key == "method")
+		{
+			std::string method;
+			words >> method;
+			if (method == "jacobi") job.method = JACOBI;
+			else if (method == "chebyshev") job.method = CHEBYSHEV;
+			else if (method == "direct") job.method = DIRECT;
+			else throw jobError(fileName, nLine, "Unknown method " + method + ".");
+			words >> job.nIterations;
+		}
+		else throw jobError(fileName, nLine, "Cannot parse " + line + ".");
+	}
+	if (inJob) throw jobError(fileName, jobs.back().line, "Job has no end.");
+	return jobs;
+}
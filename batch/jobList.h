@@ -0,0 +1,55 @@
+#pragma once
+#ifndef _JOB_LIST_H_
+#define _JOB_LIST_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+//Solution method of a job
+enum SolveMethod
+{
+	JACOBI,    //nIterations of the laplacian solver operator
+	CHEBYSHEV, //nIterations of the operator with Chebyshev acceleration
+	DIRECT     //sparse LU factorization, it is reused by jobs with the same mesh and boundary types
+};
+
+//One geometry and set of voltages to solve
+struct Job
+{
+	std::string name;
+	std::string meshFile;    //.geom file with node positions and volume elements
+	std::string regionsFile; //.rgn file with boundary faces
+	std::string ordering;    //Node ordering of the mesh: natural, rcm or morton
+	std::vector<std::string> zeroGrad; //Boundaries with zero gradient, the other ones have fixed values
+	std::vector<std::pair<std::string, double>> voltages;
+	SolveMethod method;
+	size_t nIterations;
+	std::string output;      //Output file, its format is taken from the extension: .vtu or raw
+	size_t line;             //Line of the job in the job list
+
+	Job() : ordering("rcm"), method(CHEBYSHEV), nIterations(1000), line(0) {}
+
+	//Key of the mesh in the cache, jobs with equal keys share the mesh
+	std::string meshKey() const;
+
+	//Key of the operator of the mesh, jobs with equal keys share it, voltages do not matter
+	std::string operatorKey() const;
+};
+
+/**
+ * Reads a job list. Every job is a block of lines:
+ *   job <name>
+ *   mesh <file.geom>
+ *   regions <file.rgn>
+ *   ordering natural | rcm | morton
+ *   zero_grad <boundary> ...
+ *   voltage <boundary> <value>
+ *   method jacobi | chebyshev | direct [<iterations>]
+ *   output <file.vtu | file.raw>
+ *   end
+ * Empty lines and lines starting with # are skipped, relative paths are taken from the directory of the list
+ */
+std::vector<Job> readJobList(const std::string& fileName);
+
+#endif // !_JOB_LIST_H_
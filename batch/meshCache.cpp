@@ -0,0 +1,199 @@
+#define _USE_LS_DLL_
+#include "meshCache.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	Mesh::NodeOrdering orderingOf(const std::string& name)
+	{
+		if (name == "natural") return Mesh::NATURAL;
+		if (name == "morton") return Mesh::MORTON;
+		return Mesh::RCM;
+	}
+
+	/**
+	 * Reads node positions and volume elements of a .geom file, labels of the file start at 1.
+	 * Quadrangles of hexahedra and pyramid bases are in the tensor product order there, they are turned to go around
+	 */
+	Mesh* readGeometry(const std::string& fileName, Mesh::NodeOrdering ordering)
+	{
+		std::ifstream in(fileName);
+		if (!in) throw std::runtime_error("readGeometry: Cannot open mesh file " + fileName + ".");
+
+		std::string section;
+		size_t nNodes;
+		in >> section >> nNodes;
+		std::vector<V3D> positions(nNodes);
+		for (V3D& x : positions)
+		{
+			size_t label;
+			in >> label >> x.x >> x.y >> x.z;
+		}
+
+		struct Section { const char* name; Graph::ElementType type; size_t nNodes; };
+		const Section sections[] =
+		{
+			{ "Tetra4", Graph::TET, 4 }, { "Pyramid5", Graph::PYR, 5 }, { "Wedge6", Graph::WEDGE, 6 }, { "Hexa8", Graph::HEXA, 8 }
+		};
+		Graph* g = Graph::create();
+		std::vector<UINT> nodes;
+		for (const Section& s : sections)
+		{
+			size_t nElements;
+			if (!(in >> section >> nElements) || section != s.name)
+			{
+				Graph::free(g);
+				throw std::runtime_error("readGeometry: Section " + std::string(s.name) + " is expected in " + fileName + ".");
+			}
+			nodes.resize(nElements * s.nNodes);
+			for (UINT& l : nodes)
+			{
+				in >> l;
+				--l;
+			}
+			if (s.type == Graph::HEXA || s.type == Graph::PYR)
+				for (size_t e = 0; e < nElements; ++e)
+				{
+					UINT* element = nodes.data() + e * s.nNodes;
+					std::swap(element[2], element[3]);
+					if (s.type == Graph::HEXA) std::swap(element[6], element[7]);
+				}
+			if (nElements) g->addElements(s.type, nodes.data(), nElements);
+		}
+		if (!in)
+		{
+			Graph::free(g);
+			throw std::runtime_error("readGeometry: Cannot read mesh file " + fileName + ".");
+		}
+
+		Mesh* m = Mesh::createByMove(g, std::move(positions), ordering);
+		Graph::free(g);
+		return m;
+	}
+
+	//Adds boundaries of a .rgn file: names followed by lists of triangles and quadrangles
+	void readRegions(PotentialField* f, const std::string& fileName)
+	{
+		std::ifstream in(fileName);
+		if (!in) throw std::runtime_error("readRegions: Cannot open regions file " + fileName + ".");
+		size_t nRegions;
+		in >> nRegions;
+		std::vector<UINT> labels;
+		for (size_t i = 0; i < nRegions; ++i)
+		{
+			std::string name;
+			size_t nTriangles, nQuads;
+			in >> name >> nTriangles;
+			labels.resize(3 * nTriangles);
+			for (UINT& l : labels) in >> l;
+			in >> nQuads;
+			labels.resize(3 * nTriangles + 4 * nQuads);
+			for (size_t k = 3 * nTriangles; k < labels.size(); ++k) in >> labels[k];
+			if (!in) throw std::runtime_error("readRegions: Cannot read regions file " + fileName + ".");
+			for (UINT& l : labels) --l;
+			f->addBoundary(name, labels);
+		}
+	}
+}
+
+MeshEntry::MeshEntry(const Job& job)
+	:
+	m_pMesh(readGeometry(job.meshFile, orderingOf(job.ordering))),
+	m_pBoundaries(NULL)
+{
+	try
+	{
+		m_pBoundaries = PotentialField::createZeros(m_pMesh);
+		readRegions(m_pBoundaries, job.regionsFile);
+	}
+	catch (...)
+	{
+		if (m_pBoundaries) PotentialField::free(m_pBoundaries);
+		Mesh::free(m_pMesh);
+		throw;
+	}
+}
+
+MeshEntry::~MeshEntry()
+{
+	for (ScalarFieldOperator* op : m_operators) ScalarFieldOperator::free(op);
+	for (auto& solver : m_solvers) DirectSolver::free(solver.second);
+	PotentialField::free(m_pBoundaries);
+	Mesh::free(m_pMesh);
+}
+
+PotentialField * MeshEntry::createField(const Job & job) const
+{
+	PotentialField* f = PotentialField::createCopy(m_pBoundaries);
+	std::string name;
+	try
+	{
+		for (const std::string& zeroGrad : job.zeroGrad) f->setBoundaryType(name = zeroGrad, PotentialField::ZERO_GRAD);
+		for (const std::pair<std::string, double>& voltage : job.voltages) f->setBoundaryVal(name = voltage.first, voltage.second);
+		f->applyBoundaryConditions();
+	}
+	catch (const std::out_of_range&)
+	{
+		PotentialField::free(f);
+		throw std::runtime_error("MeshEntry::createField: Unknown boundary " + name + ".");
+	}
+	catch (...)
+	{
+		PotentialField::free(f);
+		throw;
+	}
+	return f;
+}
+
+ScalarFieldOperator * MeshEntry::solverOperator(const PotentialField * f, bool & built)
+{
+	ScalarFieldOperator* op = ScalarFieldOperator::createShared(f, ScalarFieldOperator::LaplacianSolver, NULL, &built);
+	if (!built) return op;
+	//The mesh keeps its own handle, the returned one is freed by the job
+	try
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_operators.push_back(ScalarFieldOperator::createShared(f));
+	}
+	catch (...)
+	{
+		ScalarFieldOperator::free(op);
+		throw;
+	}
+	return op;
+}
+
+const DirectSolver * MeshEntry::directSolver(const Job & job, const PotentialField * f, bool & built)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	DirectSolver*& solver = m_solvers[job.operatorKey()];
+	built = !solver;
+	if (built) solver = DirectSolver::create(f);
+	return solver;
+}
+
+MeshCache::entry_ptr MeshCache::get(const Job & job, bool & loaded)
+{
+	const std::string key = job.meshKey();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+			if (it->first == key)
+			{
+				m_entries.splice(m_entries.begin(), m_entries, it);
+				loaded = false;
+				return it->second;
+			}
+	}
+
+	//Only the loading stage adds meshes, so the mesh is read without the lock
+	entry_ptr pEntry = std::make_shared<MeshEntry>(job);
+	loaded = true;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.emplace_front(key, pEntry);
+	if (m_entries.size() > m_capacity) m_entries.pop_back();
+	return pEntry;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <LSExport.h>
+
+#include "jobList.h"
+
+/**
+ * Mesh of a job with its boundaries and the operators built for it. Jobs with the same mesh files
+ * take copies of the field with boundaries and share operators and factorizations by boundary types.
+ * Operators are shared by ScalarFieldOperator::createShared, the mesh keeps handles of the operators built for it
+ */
+class MeshEntry
+{
+	Mesh* m_pMesh;
+	PotentialField* m_pBoundaries; //Zero field with all boundaries of the regions file
+	std::mutex m_mutex;
+	std::vector<ScalarFieldOperator*> m_operators; //Keep the shared operators while the mesh is cached
+	std::map<std::string, DirectSolver*> m_solvers;
+
+public:
+	//Reads the mesh and regions files of the job
+	explicit MeshEntry(const Job& job);
+	~MeshEntry();
+
+	MeshEntry(const MeshEntry&) = delete;
+	MeshEntry& operator=(const MeshEntry&) = delete;
+
+	const Mesh* mesh() const { return m_pMesh; }
+
+	//Creates a field with boundary types and voltages of the job, it should be freed by PotentialField::free
+	PotentialField* createField(const Job& job) const;
+
+	/**
+	 * Creates a handle of the shared operator for the field created by createField, it should be freed
+	 * by ScalarFieldOperator::free. built is set if the operator was not cached
+	 */
+	ScalarFieldOperator* solverOperator(const PotentialField* f, bool& built);
+
+	//Gets the factorization of the job for the field created by createField, built is set if it was not cached
+	const DirectSolver* directSolver(const Job& job, const PotentialField* f, bool& built);
+};
+
+//Meshes of the last jobs, the least recently used mesh is dropped when the cache is full
+class MeshCache
+{
+	using entry_ptr = std::shared_ptr<MeshEntry>;
+
+	size_t m_capacity;
+	std::mutex m_mutex;
+	std::list<std::pair<std::string, entry_ptr>> m_entries; //The most recently used goes first
+
+public:
+	explicit MeshCache(size_t capacity) : m_capacity(capacity) {}
+
+	//Gets the mesh of the job reading it if it is not cached, loaded is set then. Dropped meshes live while they are used
+	entry_ptr get(const Job& job, bool& loaded);
+};
+
+#endif // !_MESH_CACHE_H_
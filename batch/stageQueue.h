@@ -0,0 +1,53 @@
+#pragma once
+#ifndef _STAGE_QUEUE_H_
+#define _STAGE_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * Bounded queue between two stages of the pipeline. push waits while the queue is full, so a fast stage
+ * runs at most capacity items ahead of the next one. pop returns false when the queue is closed and empty
+ */
+template<typename item>
+class StageQueue
+{
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::deque<item> m_items;
+	size_t m_capacity;
+	bool m_bClosed;
+
+public:
+	explicit StageQueue(size_t capacity = 1) : m_capacity(capacity), m_bClosed(false) {}
+
+	void push(item x)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this] { return m_items.size() < m_capacity; });
+		m_items.push_back(std::move(x));
+		m_changed.notify_all();
+	}
+
+	bool pop(item& x)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this] { return !m_items.empty() || m_bClosed; });
+		if (m_items.empty()) return false;
+		x = std::move(m_items.front());
+		m_items.pop_front();
+		m_changed.notify_all();
+		return true;
+	}
+
+	//No more items will be pushed
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bClosed = true;
+		m_changed.notify_all();
+	}
+};
+
+#endif // !_STAGE_QUEUE_H_
@@ -8,10 +8,22 @@
 #include <iterator>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
+#include <thread>
+#include <cmath>
+#include <cstdio>
 
-Mesh* readConnectivity(std::ostream& readLog, const char* filename)
+#include "..\batch\batchPipeline.h"
+
+/**
+ * Reads the mesh of a .geom file, node positions are put to pPositions if it is given.
+ * Node positions of the mesh are kept in the mapped file <fileBase>.nodes if fileBase is given.
+ * Volume elements give the mesh its exterior surface, the hexahedra are added by Graph::addElements then
+ */
+Mesh* readConnectivity(std::ostream& readLog, const char* filename, std::vector<V3D>* pPositions = NULL,
+	const char* fileBase = NULL, bool volumeElements = false)
 {
 	Graph* g = Graph::create();
 	std::ifstream in;
@@ -50,10 +62,17 @@ Mesh* readConnectivity(std::ostream& readLog, const char* filename)
 		//Note, element indexing is strickly starting at 0.
 		//I am not sured, but this can be important
 		--n0; --n1; --n2; --n3; --n4; --n5; --n6; --n7;
-		g->addHexa(n0, n1, n2, n3, n4, n5, n6, n7);
+		if (volumeElements)
+		{
+			//Nodes of the file are in the tensor product order, faces of the elements go around
+			const UINT nodes[] = { n0, n1, n3, n2, n4, n5, n7, n6 };
+			g->addElements(Graph::HEXA, nodes, 1);
+		}
+		else g->addHexa(n0, n1, n2, n3, n4, n5, n6, n7);
 	}
 
-	Mesh* m = Mesh::create(g, ndPositions);
+	if (pPositions) *pPositions = ndPositions;
+	Mesh* m = fileBase ? Mesh::createOutOfCore(g, std::move(ndPositions), fileBase) : Mesh::createByMove(g, std::move(ndPositions));
 
 	in.close();
 	Graph::free(g);
@@ -124,6 +143,871 @@ double field_diff(const std::vector<double>& v1, const std::vector<double>& v2)
 		max(), diff());
 }
 
+//Throws if a check of a test fails
+void check(bool condition, const std::string& what)
+{
+	if (!condition) throw std::runtime_error("Check failed: " + what);
+}
+
+//Reads node positions and the field "potential" of a raw file written by FieldWriter
+void readRaw(const std::string& fileName, std::vector<double>& positions, std::vector<double>& potential)
+{
+	std::ifstream json(fileName + ".json");
+	const std::string description((std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+	auto numberAfter = [&](size_t from, const char* key)->size_t
+	{
+		const size_t pos = description.find(key, from);
+		check(pos != std::string::npos, std::string("key ") + key + " in " + fileName + ".json");
+		return std::stoul(description.substr(description.find(':', pos) + 1));
+	};
+	const size_t nNodes = numberAfter(0, "\"nodes\"");
+	const size_t potentialEntry = description.find("\"potential\"");
+	check(potentialEntry != std::string::npos, "potential in " + fileName + ".json");
+
+	std::ifstream in(fileName, std::ios::binary);
+	positions.resize(3 * nNodes);
+	potential.resize(nNodes);
+	in.read(reinterpret_cast<char*>(positions.data()), positions.size() * sizeof(double));
+	in.seekg(numberAfter(potentialEntry, "\"offset\""));
+	in.read(reinterpret_cast<char*>(potential.data()), potential.size() * sizeof(double));
+	check(static_cast<bool>(in), "data of " + fileName);
+}
+
+/**
+ * Runs the jobs of test_files/batch_jobs.txt through the batch pipeline and compares
+ * the written potential with the linear solution
+ */
+void testBatch()
+{
+	const std::vector<Job> jobs = readJobList("test_files/batch_jobs.txt");
+	check(jobs.size() == 4, "number of batch jobs");
+	const std::vector<JobReport> reports = runJobs(jobs, 2);
+
+	check(reports[0].error.empty() && reports[1].error.empty() && reports[2].error.empty(), "batch jobs succeed");
+	check(!reports[3].error.empty(), "unknown boundary fails");
+	check(reports[0].meshLoaded && !reports[1].meshLoaded && !reports[2].meshLoaded, "meshes are cached");
+	check(reports[0].operatorBuilt && reports[1].operatorBuilt && !reports[2].operatorBuilt, "operators are cached");
+
+	const char* outputs[] = { "test_files/batch_chebyshev.raw", "test_files/batch_half.raw" };
+	const double voltages[] = { 1.0, 0.5 };
+	for (size_t i = 0; i < 2; ++i)
+	{
+		std::vector<double> positions, potential;
+		readRaw(outputs[i], positions, potential);
+		double maxError = 0.0;
+		for (size_t k = 0; k < potential.size(); ++k)
+			maxError = std::max(maxError, std::fabs(potential[k] - voltages[i] * (1.0 - positions[3 * k] / 0.01)));
+		check(maxError < 1e-6, std::string("linear potential in ") + outputs[i]);
+	}
+	std::ifstream vtk("test_files/batch_direct.vtu", std::ios::binary);
+	check(vtk && vtk.peek() != EOF, "direct solution is written");
+	std::cout << "Batch pipeline test passed\n";
+}
+
+//Creates the cube field with the potential 1 on F20.16
+PotentialField* createCubeField()
+{
+	std::ostringstream log;
+	Mesh* m = readConnectivity(log, "test_files/cube.geom");
+	PotentialField* f = PotentialField::createZeros(m);
+	Mesh::free(m);
+	readBoundaries(f, log, "test_files/cube.rgn");
+	f->setBoundaryVal("F20.16", 1.0);
+	f->applyBoundaryConditions();
+	return f;
+}
+
+/**
+ * Shrinks the patch F20.16 to half of its nodes and compares the updated operator with the one built anew,
+ * the nodes which left the patch should get their rows rebuilt
+ */
+void testUpdate()
+{
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+
+	std::vector<UINT> labels;
+	const std::vector<double>& values = f->getPotentialVals();
+	for (UINT l = 0; l < values.size(); ++l)
+		if (values[l] == 1.0) labels.push_back(l);
+	const size_t nLeft = labels.size() - labels.size() / 2;
+	labels.resize(labels.size() / 2);
+	f->addBoundary("F20.16", labels, std::vector<V3D>(labels.size(), { 1, 0, 0 }));
+	f->setBoundaryVal("F20.16", 1.0);
+	f->applyBoundaryConditions();
+	check(op->update(f) >= nLeft, "nodes leaving the patch are rebuilt");
+
+	ScalarFieldOperator* fresh = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	PotentialField* updated = PotentialField::createCopy(f), *rebuilt = PotentialField::createCopy(f);
+	for (int i = 0; i < 20; ++i)
+	{
+		op->applyToField(updated);
+		fresh->applyToField(rebuilt);
+	}
+	check(field_diff(updated->getPotentialVals(), rebuilt->getPotentialVals()) == 0.0, "updated operator matches a new one");
+
+	PotentialField::free(rebuilt);
+	PotentialField::free(updated);
+	ScalarFieldOperator::free(fresh);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Operator update test passed\n";
+}
+
+//Tiled application should give the same values bit to bit as separate applications
+void testTiled()
+{
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	PotentialField* tiled = PotentialField::createCopy(f);
+	for (int i = 0; i < 25; ++i) op->applyToField(f);
+	op->applyTiled(tiled, 25, 8, 1 << 16);
+	check(field_diff(f->getPotentialVals(), tiled->getPotentialVals()) == 0.0, "tiled application matches separate ones");
+
+	PotentialField::free(tiled);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Tiled application test passed\n";
+}
+
+/**
+ * The condensed operator keeps the unknowns between calls and writes the field only by flush,
+ * a boundary value changed in between should give the same values as the plain operator
+ */
+void testCondensed()
+{
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	ScalarFieldOperator* condensed = ScalarFieldOperator::createCondensed(f);
+	PotentialField* plain = PotentialField::createCopy(f);
+	const std::vector<double> initial = f->getPotentialVals();
+	for (int i = 0; i < 20; ++i)
+	{
+		op->applyToField(plain);
+		condensed->applyToField(f);
+	}
+	check(f->getPotentialVals() == initial, "condensed operator does not write the field before flush");
+
+	plain->setBoundaryVal("F20.16", 0.5);
+	plain->applyBoundaryConditions();
+	f->setBoundaryVal("F20.16", 0.5);
+	f->applyBoundaryConditions();
+	for (int i = 0; i < 20; ++i)
+	{
+		op->applyToField(plain);
+		condensed->applyToField(f);
+	}
+	condensed->flush(f);
+	check(field_diff(f->getPotentialVals(), plain->getPotentialVals()) < 1e-20, "condensed operator follows changed boundary values");
+
+	//Values written by another operator drop the unflushed values
+	condensed->applyToField(f);
+	for (int i = 0; i < 2; ++i) op->applyToField(f);
+	condensed->applyToField(f);
+	condensed->flush(f);
+	for (int i = 0; i < 3; ++i) op->applyToField(plain);
+	check(field_diff(f->getPotentialVals(), plain->getPotentialVals()) < 1e-20, "condensed operator sees values written by other operators");
+
+	//A field freed without flush leaves nothing for the next field
+	PotentialField* freed = PotentialField::createCopy(f);
+	condensed->applyToField(freed);
+	PotentialField::free(freed);
+	PotentialField* next = PotentialField::createCopy(f);
+	condensed->applyToField(next);
+	condensed->flush(next);
+	op->applyToField(plain);
+	check(field_diff(next->getPotentialVals(), plain->getPotentialVals()) < 1e-20, "condensed operator forgets freed fields");
+	PotentialField::free(next);
+
+	bool rejected = false;
+	try { condensed->applyTiled(f, 1); }
+	catch (const std::runtime_error&) { rejected = true; }
+	check(rejected, "condensed operator rejects tiling");
+
+	PotentialField::free(plain);
+	ScalarFieldOperator::free(condensed);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Condensed operator test passed\n";
+}
+
+/**
+ * The cube of 10 x 10 x 10 hexahedra has 600 exterior quadrangles on its sides. Normals of the side nodes point inside
+ * along the axes of the sides they lie on, e.g. the diagonal at corners, inner nodes get zero normals
+ */
+void testExteriorSurface()
+{
+	std::ostringstream log;
+	std::vector<V3D> positions;
+	Mesh* m = readConnectivity(log, "test_files/cube.geom", &positions, NULL, true);
+	const std::pair<V3D, V3D> box = m->getBox();
+	const double tolerance = 1e-9;
+	auto onSides = [&](const V3D& p, double* inside)->bool
+	{
+		const double r[3] = { p.x, p.y, p.z }, lo[3] = { box.first.x, box.first.y, box.first.z },
+			hi[3] = { box.second.x, box.second.y, box.second.z };
+		bool side = false;
+		for (int k = 0; k < 3; ++k)
+		{
+			inside[k] = std::fabs(r[k] - lo[k]) < tolerance ? 1.0 : std::fabs(r[k] - hi[k]) < tolerance ? -1.0 : 0.0;
+			side = side || inside[k] != 0.0;
+		}
+		return side;
+	};
+
+	std::vector<UINT> faces;
+	m->getExteriorFaces(faces);
+	check(faces.size() == 4 * 600, "number of exterior faces");
+	double inside[3];
+	for (size_t i = 0; i < faces.size(); i += 4)
+	{
+		for (size_t k = 0; k < 4; ++k) check(onSides(positions[faces[i + k]], inside), "exterior face nodes lie on the sides");
+		check(faces[i + 2] != faces[i + 3], "exterior faces are quadrangles");
+	}
+
+	std::vector<V3D> normals;
+	m->getExteriorNormals(normals);
+	check(normals.size() == positions.size(), "number of normals");
+	for (size_t l = 0; l < positions.size(); ++l)
+	{
+		onSides(positions[l], inside);
+		const double norm = std::sqrt(inside[0] * inside[0] + inside[1] * inside[1] + inside[2] * inside[2]);
+		const double expected[3] = { norm > 0.0 ? inside[0] / norm : 0.0, norm > 0.0 ? inside[1] / norm : 0.0,
+			norm > 0.0 ? inside[2] / norm : 0.0 };
+		check(std::fabs(normals[l].x - expected[0]) < 1e-12 && std::fabs(normals[l].y - expected[1]) < 1e-12 &&
+			std::fabs(normals[l].z - expected[2]) < 1e-12, "normals point inside along the sides of the nodes");
+	}
+
+	Mesh::free(m);
+	std::cout << "Exterior surface test passed\n";
+}
+
+/**
+ * Probe points behind a symmetry plane should give the values at their mirror images as interpolate does,
+ * an antisymmetric plane changes the sign
+ */
+void testProbe()
+{
+	std::ostringstream log;
+	Mesh* m = readConnectivity(log, "test_files/cube.geom");
+	PotentialField* symmetric = PotentialField::createZeros(m);
+	readBoundaries(symmetric, log, "test_files/cube.rgn");
+	symmetric->setBoundaryVal("F20.16", 1.0);
+	symmetric->applyBoundaryConditions();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(symmetric, ScalarFieldOperator::LaplacianSolver);
+	for (int i = 0; i < 30; ++i) op->applyToField(symmetric);
+	PotentialField* antisymmetric = PotentialField::createCopy(symmetric);
+	symmetric->addSymmetryPlane(0, 0.0, PotentialField::SYMMETRIC);
+	antisymmetric->addSymmetryPlane(0, 0.0, PotentialField::ANTISYMMETRIC);
+
+	const std::vector<V3D> inside = { { 0.0023, 0.0041, 0.0057 }, { 0.0071, 0.0012, 0.0033 }, { 0.0005, 0.0095, 0.005 } };
+	std::vector<V3D> mirrored(inside);
+	for (V3D& p : mirrored) p.x = -p.x;
+	Probe* insideProbe = Probe::create(m, inside), *mirroredProbe = Probe::create(m, mirrored);
+	std::vector<double> direct(inside.size()), even(inside.size()), odd(inside.size());
+	insideProbe->sample(symmetric, direct.data());
+	mirroredProbe->sample(symmetric, even.data());
+	mirroredProbe->sample(antisymmetric, odd.data());
+	for (size_t i = 0; i < inside.size(); ++i)
+	{
+		check(even[i] == direct[i], "probe reflects points about a symmetric plane");
+		check(odd[i] == -direct[i], "probe changes the sign about an antisymmetric plane");
+		check(std::fabs(even[i] - symmetric->interpolate(mirrored[i].x, mirrored[i].y, mirrored[i].z)) < 1e-12,
+			"probe matches interpolation");
+	}
+
+	Probe::free(mirroredProbe);
+	Probe::free(insideProbe);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(antisymmetric);
+	PotentialField::free(symmetric);
+	Mesh::free(m);
+	std::cout << "Probe test passed\n";
+}
+
+/**
+ * Solves the cube by processes emulated with threads, every process builds its part from its own nodes.
+ * The gathered fields of plain and Chebyshev steps are compared with the steps of one operator on the whole mesh
+ */
+void testDistributed()
+{
+	const size_t nIterations = 50;
+	const int nRanks = 3;
+	PotentialField* f = createCubeField();
+	PotentialField* single = PotentialField::createCopy(f), *singleChebyshev = PotentialField::createCopy(f);
+	ScalarFieldOperator* op = ScalarFieldOperator::create(single, ScalarFieldOperator::LaplacianSolver);
+	for (size_t i = 0; i < nIterations; ++i) op->applyToField(single);
+	op->applyChebyshev(singleChebyshev, nIterations);
+	const double rho = op->spectralRadius();
+	ScalarFieldOperator::free(op);
+
+	std::vector<Transport*> transports = Transport::createLocal(nRanks);
+	bool rejected = false;
+	try { DistributedField::create(f, transports[0], 0); }
+	catch (const std::runtime_error&) { rejected = true; }
+	check(rejected, "zero ghost layers are rejected");
+
+	PotentialField* gathered = PotentialField::createCopy(f), *gatheredChebyshev = PotentialField::createCopy(f);
+	std::vector<std::string> errors(nRanks);
+	std::vector<std::thread> ranks;
+	for (int r = 0; r < nRanks; ++r)
+		ranks.emplace_back([&, r]()
+		{
+			try
+			{
+				DistributedField* part = DistributedField::create(f, transports[r], 2);
+				part->iterate(nIterations);
+				part->gather(gathered);
+				DistributedField::free(part);
+				part = DistributedField::create(f, transports[r], 2);
+				part->iterateChebyshev(nIterations, rho);
+				part->gather(gatheredChebyshev);
+				DistributedField::free(part);
+			}
+			catch (const std::exception& e)
+			{
+				errors[r] = e.what();
+			}
+		});
+	for (std::thread& rank : ranks) rank.join();
+	for (int r = 0; r < nRanks; ++r)
+	{
+		check(errors[r].empty(), "distributed process: " + errors[r]);
+		Transport::free(transports[r]);
+	}
+	check(field_diff(single->getPotentialVals(), gathered->getPotentialVals()) < 1e-20, "distributed steps match one operator");
+	check(field_diff(singleChebyshev->getPotentialVals(), gatheredChebyshev->getPotentialVals()) < 1e-20,
+		"distributed Chebyshev steps match one operator");
+
+	//Invalid data of one process make all processes throw instead of waiting for it
+	transports = Transport::createLocal(nRanks);
+	std::vector<int> failed(nRanks, 0);
+	ranks.clear();
+	for (int r = 0; r < nRanks; ++r)
+		ranks.emplace_back([&, r]()
+		{
+			try
+			{
+				DistributedField::Part invalid;
+				invalid.labels.push_back(0);
+				invalid.positions.push_back(V3D{ 0.0, 0.0, 0.0 });
+				invalid.neighbourStart.assign(2, 0);
+				DistributedField::free(r == 1 ? DistributedField::createFromPart(invalid, transports[r]) :
+					DistributedField::create(f, transports[r]));
+			}
+			catch (const std::runtime_error&)
+			{
+				failed[r] = 1;
+			}
+		});
+	for (std::thread& rank : ranks) rank.join();
+	for (int r = 0; r < nRanks; ++r)
+	{
+		check(failed[r] == 1, "error of one process is raised on all processes");
+		Transport::free(transports[r]);
+	}
+
+	PotentialField::free(gatheredChebyshev);
+	PotentialField::free(gathered);
+	PotentialField::free(singleChebyshev);
+	PotentialField::free(single);
+	PotentialField::free(f);
+	std::cout << "Distributed field test passed\n";
+}
+
+/**
+ * Queries the statistics of an operator application and exports them as a chrome trace,
+ * a library built without LS_PROFILING should report nothing and refuse the export
+ */
+void testProfiler()
+{
+	const char* traceFile = "test_files/profile_trace.json";
+	Profiler::reset();
+	Profiler::enableTrace(true);
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	for (int i = 0; i < 3; ++i) op->applyToField(f);
+	Profiler::enableTrace(false);
+	const std::vector<Profiler::PhaseStats> phases = Profiler::phases();
+	const std::vector<Profiler::CounterStats> counters = Profiler::counters();
+	const bool exported = Profiler::exportChromeTrace(traceFile);
+
+	if (Profiler::enabled())
+	{
+		const Profiler::PhaseStats* pApply = NULL;
+		for (const Profiler::PhaseStats& p : phases)
+		{
+			if (p.name == "FieldLinearOp::applyToField") pApply = &p;
+			check(p.minMs <= p.maxMs, "phase minimum does not exceed maximum");
+		}
+		check(pApply != NULL && pApply->calls == 3, "operator applications are timed");
+		unsigned long long allocations = 0, allocatedBytes = 0;
+		for (const Profiler::CounterStats& c : counters)
+		{
+			if (c.name == "allocations") allocations = c.value;
+			if (c.name == "allocated_bytes") allocatedBytes = c.value;
+		}
+		//The matrix takes three buffers and every application one result vector
+		check(allocations >= 6 && allocatedBytes >= 3 * f->getPotentialVals().size() * sizeof(double),
+			"solver allocations are counted");
+
+		check(exported, "trace is exported");
+		std::ifstream in(traceFile);
+		const std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		check(trace.compare(0, 15, "{\"traceEvents\":") == 0, "trace is a chrome trace");
+		check(trace.find("\"name\":\"FieldLinearOp::applyToField\",\"ph\":\"X\"") != std::string::npos,
+			"trace has the operator applications");
+		check(trace.find("\"name\":\"allocations\",\"ph\":\"C\"") != std::string::npos,
+			"trace has the allocation counter");
+		in.close();
+		std::remove(traceFile);
+
+		Profiler::reset();
+		for (const Profiler::PhaseStats& p : Profiler::phases()) check(p.calls == 0, "reset clears phases");
+		for (const Profiler::CounterStats& c : Profiler::counters()) check(c.value == 0, "reset clears counters");
+	}
+	else
+	{
+		check(phases.empty() && counters.empty(), "no statistics without profiling");
+		check(!exported, "no trace without profiling");
+	}
+
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Profiler test passed\n";
+}
+
+/**
+ * Runs background solves with a plain, a shared and a condensed operator, the values after wait should equal
+ * the same number of iterations made in place and the last snapshot should equal the field
+ */
+void testAsync()
+{
+	const size_t nIterations = 200;
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* ops[3] = {
+		ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver),
+		ScalarFieldOperator::createShared(f),
+		ScalarFieldOperator::createCondensed(f) };
+	for (ScalarFieldOperator* op : ops)
+	{
+		PotentialField* background = PotentialField::createCopy(f), *inPlace = PotentialField::createCopy(f);
+		SolveHandle* h = background->solveAsync(op, nIterations, 7);
+		bool rejected = false;
+		try { SolveHandle::free(background->solveAsync(op, nIterations)); }
+		catch (const std::runtime_error&) { rejected = true; }
+		check(rejected || h->finished(), "second solve of a running field is rejected");
+		while (!h->finished())
+			check(background->getPotentialSnapshot()->size() == f->getPotentialVals().size(), "snapshot has all values");
+		h->wait();
+		check(h->progress() == nIterations && h->total() == nIterations, "background solve makes all iterations");
+		for (size_t i = 0; i < nIterations; ++i) op->applyToField(inPlace);
+		op->flush(inPlace);
+		check(*background->getPotentialSnapshot() == background->getPotentialVals(), "snapshot equals the field after wait");
+		check(field_diff(background->getPotentialVals(), inPlace->getPotentialVals()) == 0.0,
+			"background solve equals iterations in place");
+		SolveHandle::free(h);
+
+		//Cancelled solve stops after some iterations, the field has the values of the iterations done
+		PotentialField::free(inPlace);
+		inPlace = PotentialField::createCopy(background);
+		h = background->solveAsync(op, 1000000, 5);
+		while (h->progress() < 20) std::this_thread::yield();
+		h->cancel();
+		h->wait();
+		const size_t nDone = h->progress();
+		check(nDone >= 20 && nDone < h->total() && h->finished(), "cancelled solve stops midway");
+		for (size_t i = 0; i < nDone; ++i) op->applyToField(inPlace);
+		op->flush(inPlace);
+		check(*background->getPotentialSnapshot() == background->getPotentialVals(), "snapshot equals the field after cancel");
+		check(field_diff(background->getPotentialVals(), inPlace->getPotentialVals()) == 0.0,
+			"cancelled solve keeps the iterations done");
+		SolveHandle::free(h);
+		PotentialField::free(inPlace);
+		PotentialField::free(background);
+	}
+
+	for (ScalarFieldOperator* op : ops) ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Background solve test passed\n";
+}
+
+/**
+ * Changes a boundary value of a converged field and relaxes only the affected nodes,
+ * the result should match full sweeps and no changed nodes should be left for the next relaxation
+ */
+void testRelax()
+{
+	const double tolerance = 1e-13;
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	op->applyChebyshev(f, 2000);
+	PotentialField* relaxed = PotentialField::createCopy(f), *swept = PotentialField::createCopy(f);
+	relaxed->setBoundaryVal("F20.16", 1.5);
+	relaxed->applyBoundaryConditions();
+	swept->setBoundaryVal("F20.16", 1.5);
+	swept->applyBoundaryConditions();
+	const size_t nUpdates = op->relax(relaxed, tolerance);
+	op->applyChebyshev(swept, 2000);
+	check(nUpdates > 0, "relaxation updates the affected nodes");
+	check(field_diff(relaxed->getPotentialVals(), swept->getPotentialVals()) < 1e-20, "relaxation matches full sweeps");
+	check(op->relax(relaxed, tolerance) == 0, "relaxation leaves no changed nodes");
+
+	//Changes are taken by a full application, relaxation continues from the values it leaves
+	relaxed->setBoundaryVal("F20.16", 1.0);
+	relaxed->applyBoundaryConditions();
+	op->applyToField(relaxed);
+	check(op->relax(relaxed, tolerance) == 0, "application takes the changed nodes");
+
+	PotentialField::free(swept);
+	PotentialField::free(relaxed);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Relaxation test passed\n";
+}
+
+/**
+ * Max difference between a resampled lattice and interpolation at its points, pBox is passed to resample.
+ * Points equally far from two nodes are avoided, their stencils depend on the node the search starts from
+ */
+double resampleError(const PotentialField* f, const std::pair<V3D, V3D>& box, const std::pair<V3D, V3D>* pBox)
+{
+	const UINT n[3] = { 6, 4, 3 };
+	std::vector<double> values(n[0] * n[1] * n[2]);
+	f->resample(values.data(), n[0], n[1], n[2], pBox);
+	auto coord = [&](double lo, double hi, UINT i, UINT nPoints) { return lo + (hi - lo) * i / (nPoints - 1); };
+	double error = 0.0;
+	for (UINT k = 0; k < n[2]; ++k)
+		for (UINT j = 0; j < n[1]; ++j)
+			for (UINT i = 0; i < n[0]; ++i)
+			{
+				const double val = f->interpolate(coord(box.first.x, box.second.x, i, n[0]),
+					coord(box.first.y, box.second.y, j, n[1]), coord(box.first.z, box.second.z, k, n[2]));
+				error = std::max(error, std::fabs(values[i + n[0] * (j + n[1] * k)] - val));
+			}
+	return error;
+}
+
+//Compares resampled lattices with interpolation at every point, in the mesh box, in a smaller box and about a symmetry plane
+void testResample()
+{
+	std::ostringstream log;
+	Mesh* m = readConnectivity(log, "test_files/cube.geom");
+	PotentialField* f = PotentialField::createZeros(m);
+	readBoundaries(f, log, "test_files/cube.rgn");
+	f->setBoundaryVal("F20.16", 1.0);
+	f->applyBoundaryConditions();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	for (int i = 0; i < 30; ++i) op->applyToField(f);
+
+	const std::pair<V3D, V3D> meshBox = m->getBox();
+	check(resampleError(f, meshBox, NULL) < 1e-12, "lattice of the mesh box matches interpolation");
+	std::pair<V3D, V3D> box = meshBox;
+	box.first.x += 0.21 * (meshBox.second.x - meshBox.first.x);
+	box.second.y -= 0.33 * (meshBox.second.y - meshBox.first.y);
+	box.first.z += 0.4 * (meshBox.second.z - meshBox.first.z);
+	check(resampleError(f, box, &box) < 1e-12, "lattice of a box matches interpolation");
+
+	//The box spans both sides of the plane, points on the other side are reflected
+	f->addSymmetryPlane(0, meshBox.first.x, PotentialField::ANTISYMMETRIC);
+	box.first.x = 2.0 * meshBox.first.x - meshBox.second.x;
+	check(resampleError(f, box, &box) < 1e-12, "lattice about a symmetry plane matches interpolation");
+
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	Mesh::free(m);
+	std::cout << "Resample test passed\n";
+}
+
+//Checks if a file can be opened
+bool fileExists(const std::string& fileName)
+{
+	return std::ifstream(fileName).good();
+}
+
+/**
+ * Compares the out of core operator on a mesh with mapped node positions with the operator built in memory,
+ * the results should be the same bit to bit and the files should be removed with the operator and the mesh
+ */
+void testOutOfCore()
+{
+	const std::string fileBase = "test_files/out_of_core";
+	const char* matrixFiles[] = { ".rows", ".cols", ".coefs" };
+	std::ostringstream log;
+	Mesh* m = readConnectivity(log, "test_files/cube.geom", NULL, fileBase.c_str());
+	check(fileExists(fileBase + ".nodes"), "node positions are mapped");
+	PotentialField* mapped = PotentialField::createZeros(m);
+	Mesh::free(m);
+	readBoundaries(mapped, log, "test_files/cube.rgn");
+	mapped->setBoundaryVal("F20.16", 1.0);
+	mapped->applyBoundaryConditions();
+	PotentialField* f = createCubeField();
+	check(field_diff(mapped->getPotentialVals(), f->getPotentialVals()) == 0.0, "mapped mesh gets the same conditions");
+
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	ScalarFieldOperator* outOfCore = ScalarFieldOperator::createOutOfCore(mapped, fileBase);
+	for (const char* ext : matrixFiles) check(fileExists(fileBase + ext), "matrix file is created");
+	for (int i = 0; i < 20; ++i)
+	{
+		op->applyToField(f);
+		outOfCore->applyToField(mapped);
+	}
+	check(field_diff(mapped->getPotentialVals(), f->getPotentialVals()) == 0.0, "out of core steps are exact");
+	op->applyChebyshev(f, 50);
+	outOfCore->applyChebyshev(mapped, 50);
+	check(field_diff(mapped->getPotentialVals(), f->getPotentialVals()) == 0.0, "out of core Chebyshev steps are exact");
+	check(mapped->interpolate(0.0023, 0.0041, 0.0057) == f->interpolate(0.0023, 0.0041, 0.0057),
+		"interpolation on mapped positions is exact");
+
+	ScalarFieldOperator::free(outOfCore);
+	for (const char* ext : matrixFiles) check(!fileExists(fileBase + ext), "matrix file is removed with the operator");
+	check(fileExists(fileBase + ".nodes"), "node positions are kept while the field uses them");
+	PotentialField::free(mapped);
+	check(!fileExists(fileBase + ".nodes"), "node positions file is removed with the last user");
+
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Out of core test passed\n";
+}
+
+/**
+ * Compares NUMA operators with the operator built in memory bit to bit, applied serially
+ * and from several threads sharing the node pool and one operator
+ */
+void testNuma()
+{
+	const int nIterations = 20, nThreads = 4;
+	PotentialField* f = createCubeField();
+	PotentialField* reference = PotentialField::createCopy(f), *referenceChebyshev = PotentialField::createCopy(f);
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	for (int i = 0; i < nIterations; ++i) op->applyToField(reference);
+	op->applyChebyshev(referenceChebyshev, nIterations);
+
+	ScalarFieldOperator* numa = ScalarFieldOperator::createNuma(f);
+	PotentialField* serial = PotentialField::createCopy(f), *serialChebyshev = PotentialField::createCopy(f);
+	for (int i = 0; i < nIterations; ++i) numa->applyToField(serial);
+	numa->applyChebyshev(serialChebyshev, nIterations);
+	check(field_diff(serial->getPotentialVals(), reference->getPotentialVals()) == 0.0, "NUMA steps are exact");
+	check(field_diff(serialChebyshev->getPotentialVals(), referenceChebyshev->getPotentialVals()) == 0.0,
+		"NUMA Chebyshev steps are exact");
+
+	//Even threads share the first operator, odd ones have their own operators
+	std::vector<ScalarFieldOperator*> ops(nThreads, numa);
+	std::vector<PotentialField*> fields(nThreads);
+	for (int t = 0; t < nThreads; ++t)
+	{
+		if (t % 2) ops[t] = ScalarFieldOperator::createNuma(f);
+		fields[t] = PotentialField::createCopy(f);
+	}
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; ++t)
+		threads.emplace_back([&, t]() { for (int i = 0; i < nIterations; ++i) ops[t]->applyToField(fields[t]); });
+	for (std::thread& t : threads) t.join();
+	for (int t = 0; t < nThreads; ++t)
+	{
+		check(field_diff(fields[t]->getPotentialVals(), reference->getPotentialVals()) == 0.0, "concurrent NUMA steps are exact");
+		if (t % 2) ScalarFieldOperator::free(ops[t]);
+		PotentialField::free(fields[t]);
+	}
+
+	PotentialField::free(serialChebyshev);
+	PotentialField::free(serial);
+	ScalarFieldOperator::free(numa);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(referenceChebyshev);
+	PotentialField::free(reference);
+	PotentialField::free(f);
+	std::cout << "NUMA operator test passed\n";
+}
+
+/**
+ * Compares compressed operators with the operator built in memory, double coefficients should give
+ * the same values bit to bit and float ones should move them by the float rounding only
+ */
+void testCompressed()
+{
+	const int nIterations = 50;
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	ScalarFieldOperator* compressed = ScalarFieldOperator::createCompressed(f);
+	ScalarFieldOperator* floatCompressed = ScalarFieldOperator::createCompressed(f, ScalarFieldOperator::LaplacianSolver, true);
+	check(compressed->spectralRadius() == op->spectralRadius(), "compressed operator finds the same fixed rows");
+
+	PotentialField* reference = PotentialField::createCopy(f), *doubles = PotentialField::createCopy(f),
+		*floats = PotentialField::createCopy(f);
+	for (int i = 0; i < nIterations; ++i)
+	{
+		op->applyToField(reference);
+		compressed->applyToField(doubles);
+		floatCompressed->applyToField(floats);
+	}
+	check(field_diff(doubles->getPotentialVals(), reference->getPotentialVals()) == 0.0, "compressed steps are exact");
+	check(field_diff(floats->getPotentialVals(), reference->getPotentialVals()) < 1e-12, "float coefficients round the steps only");
+
+	op->applyChebyshev(reference, nIterations);
+	compressed->applyChebyshev(doubles, nIterations);
+	floatCompressed->applyChebyshev(floats, nIterations);
+	check(field_diff(doubles->getPotentialVals(), reference->getPotentialVals()) == 0.0, "compressed Chebyshev steps are exact");
+	check(field_diff(floats->getPotentialVals(), reference->getPotentialVals()) < 1e-12,
+		"float coefficients round the Chebyshev steps only");
+
+	PotentialField::free(floats);
+	PotentialField::free(doubles);
+	PotentialField::free(reference);
+	ScalarFieldOperator::free(floatCompressed);
+	ScalarFieldOperator::free(compressed);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Compressed operator test passed\n";
+}
+
+//Copy of the field with a one node patch of the type and the normal
+PotentialField* createPatchedCopy(const PotentialField* f, PotentialField::BOUNDARY_TYPE type, const V3D& normal)
+{
+	PotentialField* copy = PotentialField::createCopy(f);
+	copy->addBoundary("patch", std::vector<UINT>(1, 600), std::vector<V3D>(1, normal));
+	copy->setBoundaryType("patch", type);
+	copy->applyBoundaryConditions();
+	return copy;
+}
+
+/**
+ * Fields with the same boundary nodes, types and normals should get one shared operator, fields differing
+ * in a patch type or a normal their own ones. Operators should be released with their last handles
+ */
+void testShared()
+{
+	const size_t nBefore = ScalarFieldOperator::sharedOperators();
+	PotentialField* f = createCubeField();
+	PotentialField* otherValues = PotentialField::createCopy(f);
+	otherValues->setBoundaryVal("F20.16", 2.0);
+	otherValues->applyBoundaryConditions();
+	bool assembled[2];
+	ScalarFieldOperator* shared = ScalarFieldOperator::createShared(f, ScalarFieldOperator::LaplacianSolver, NULL, &assembled[0]);
+	ScalarFieldOperator* sameConditions = ScalarFieldOperator::createShared(otherValues, ScalarFieldOperator::LaplacianSolver,
+		NULL, &assembled[1]);
+	check(ScalarFieldOperator::sharedOperators() == nBefore + 1, "fields differing in values share the operator");
+	check(assembled[0] && !assembled[1], "only the first request assembles the operator");
+
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	PotentialField* reference = PotentialField::createCopy(otherValues);
+	for (int i = 0; i < 20; ++i)
+	{
+		op->applyToField(reference);
+		sameConditions->applyToField(otherValues);
+	}
+	check(field_diff(otherValues->getPotentialVals(), reference->getPotentialVals()) == 0.0, "shared operator steps are exact");
+
+	const V3D normal{ 1.0, 0.0, 0.0 }, turned{ 0.0, 1.0, 0.0 };
+	PotentialField* patched[4] = {
+		createPatchedCopy(f, PotentialField::ZERO_GRAD, normal),
+		createPatchedCopy(f, PotentialField::ZERO_GRAD, normal),
+		createPatchedCopy(f, PotentialField::FIXED_VAL, normal),
+		createPatchedCopy(f, PotentialField::ZERO_GRAD, turned) };
+	const size_t nExpected[4] = { nBefore + 2, nBefore + 2, nBefore + 3, nBefore + 4 };
+	ScalarFieldOperator* patchedOps[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		patchedOps[i] = ScalarFieldOperator::createShared(patched[i]);
+		check(ScalarFieldOperator::sharedOperators() == nExpected[i], "operators are shared for the same patch types and normals");
+	}
+
+	ScalarFieldOperator::free(shared);
+	check(ScalarFieldOperator::sharedOperators() == nBefore + 4, "operator is kept while a handle uses it");
+	ScalarFieldOperator::free(sameConditions);
+	check(ScalarFieldOperator::sharedOperators() == nBefore + 3, "operator is released after the last handle");
+	for (int i = 0; i < 4; ++i)
+	{
+		ScalarFieldOperator::free(patchedOps[i]);
+		PotentialField::free(patched[i]);
+	}
+	check(ScalarFieldOperator::sharedOperators() == nBefore, "all shared operators are released");
+
+	PotentialField::free(reference);
+	ScalarFieldOperator::free(op);
+	PotentialField::free(otherValues);
+	PotentialField::free(f);
+	std::cout << "Shared operator test passed\n";
+}
+
+/**
+ * Solves the cube field directly for two sets of boundary values with one factorization, both solutions
+ * should match converged iterations. A field without fixed values has no unique solution and is rejected
+ */
+void testDirect()
+{
+	PotentialField* f = createCubeField();
+	DirectSolver* solver = DirectSolver::create(f);
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	PotentialField* iterated = PotentialField::createCopy(f);
+	const double values[2][2] = { { 1.0, 0.0 }, { -0.5, 2.0 } };
+	for (int i = 0; i < 2; ++i)
+	{
+		for (PotentialField* g : { f, iterated })
+		{
+			g->setBoundaryVal("F20.16", values[i][0]);
+			g->setBoundaryVal("F17.16", values[i][1]);
+			g->applyBoundaryConditions();
+		}
+		solver->solve(f);
+		op->applyChebyshev(iterated, 2000);
+		check(field_diff(f->getPotentialVals(), iterated->getPotentialVals()) < 1e-20, "direct solution matches iterations");
+	}
+
+	std::ostringstream log;
+	Mesh* m = readConnectivity(log, "test_files/cube.geom");
+	PotentialField* unfixed = PotentialField::createZeros(m);
+	Mesh::free(m);
+	bool rejected = false;
+	try { DirectSolver::free(DirectSolver::create(unfixed)); }
+	catch (const std::runtime_error&) { rejected = true; }
+	check(rejected, "direct solver rejects a field without fixed values");
+
+	PotentialField::free(unfixed);
+	PotentialField::free(iterated);
+	ScalarFieldOperator::free(op);
+	DirectSolver::free(solver);
+	PotentialField::free(f);
+	std::cout << "Direct solver test passed\n";
+}
+
+/**
+ * Applies the operator to 1, 5 and 9 fields with different boundary values at once, fields are summed in groups of
+ * up to 8, so 9 fields leave a group of one. Every field should get exactly the result of separate applications
+ */
+void testMultipleFields()
+{
+	const size_t nIterations = 3;
+	PotentialField* f = createCubeField();
+	ScalarFieldOperator* op = ScalarFieldOperator::create(f, ScalarFieldOperator::LaplacianSolver);
+	for (size_t nFields : { 1, 5, 9 })
+	{
+		std::vector<PotentialField*> fields, separate;
+		for (size_t k = 0; k < nFields; ++k)
+		{
+			PotentialField* g = PotentialField::createCopy(f);
+			g->setBoundaryVal("F20.16", 1.0 + 0.25 * k);
+			g->setBoundaryVal("F17.16", -0.1 * k);
+			g->applyBoundaryConditions();
+			fields.push_back(g);
+			separate.push_back(PotentialField::createCopy(g));
+		}
+		op->applyToFields(fields.data(), nFields, nIterations);
+		for (size_t k = 0; k < nFields; ++k)
+		{
+			for (size_t it = 0; it < nIterations; ++it) op->applyToField(separate[k]);
+			check(field_diff(fields[k]->getPotentialVals(), separate[k]->getPotentialVals()) == 0.0,
+				"fields applied at once match separate applications");
+			PotentialField::free(separate[k]);
+			PotentialField::free(fields[k]);
+		}
+	}
+
+	ScalarFieldOperator::free(op);
+	PotentialField::free(f);
+	std::cout << "Multiple fields test passed\n";
+}
+
 int main()
 {
 	try 
@@ -160,6 +1044,24 @@ int main()
 
 		PotentialField::free(f);
 		ScalarFieldOperator::free(op);
+
+		testBatch();
+		testUpdate();
+		testTiled();
+		testCondensed();
+		testProbe();
+		testExteriorSurface();
+		testDistributed();
+		testProfiler();
+		testAsync();
+		testRelax();
+		testResample();
+		testOutOfCore();
+		testNuma();
+		testCompressed();
+		testShared();
+		testDirect();
+		testMultipleFields();
 		return 0;
 	}
 	catch (const std::exception& e)